@@ -577,12 +577,13 @@ public class ZygoteInit {
 
             // 绑定套接字，接收新Android应用程序运行请求
             registerZygoteSocket();
-            EventLog.writeEvent(LOG_BOOT_PROGRESS_PRELOAD_START,
-                SystemClock.uptimeMillis());
+            long preloadStart = SystemClock.uptimeMillis();
+            EventLog.writeEvent(LOG_BOOT_PROGRESS_PRELOAD_START, preloadStart);
             // 加载Android Application Framework 使用的类与资源、OpenGL
             preload();
-            EventLog.writeEvent(LOG_BOOT_PROGRESS_PRELOAD_END,
-                SystemClock.uptimeMillis());
+            long preloadEnd = SystemClock.uptimeMillis();
+            EventLog.writeEvent(LOG_BOOT_PROGRESS_PRELOAD_END, preloadEnd);
+            Log.i(TAG, "preload took " + (preloadEnd - preloadStart) + "ms");
 
             // Finish profiling the zygote initialization.
             SamplingProfilerIntegration.writeZygoteSnapshot();
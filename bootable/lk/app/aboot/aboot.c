@@ -54,6 +54,7 @@
 #include "bootimg.h"
 #include "fastboot.h"
 #include "sparse_format.h"
+#include "sparse_stream.h"
 #include "mmc.h"
 #include "devinfo.h"
 
@@ -387,6 +388,44 @@ unsigned page_mask = 0;
 
 static unsigned char buf[4096]; //Equal to max-supported pagesize
 
+/* Signed boot images are read and hashed this much at a time */
+#define BOOT_READ_CHUNK (1024 * 1024)
+
+static struct {
+	time_t read;
+	time_t hash;
+} boot_timing;
+
+/*
+ * Read len bytes from the card straight to dest, feeding each chunk to
+ * the hash while it is still warm in the cache. 'last' closes the hash
+ * with the final chunk.
+ */
+static int mmc_read_and_hash(unsigned long long addr, unsigned char *dest,
+			     unsigned len, hash_ctx *ctx, bool last)
+{
+	unsigned n;
+	time_t t;
+
+	while (len) {
+		n = (len < BOOT_READ_CHUNK) ? len : BOOT_READ_CHUNK;
+
+		t = current_time();
+		if (mmc_read(addr, (unsigned int *)dest, n))
+			return -1;
+		boot_timing.read += current_time() - t;
+
+		t = current_time();
+		hash_update(ctx, dest, n, last && n == len);
+		boot_timing.hash += current_time() - t;
+
+		addr += n;
+		dest += n;
+		len -= n;
+	}
+	return 0;
+}
+
 int boot_linux_from_mmc(void)
 {
 	struct boot_img_hdr *hdr = (void*) buf;
@@ -401,6 +440,9 @@ int boot_linux_from_mmc(void)
 	unsigned kernel_actual;
 	unsigned ramdisk_actual;
 	unsigned imagesize_actual;
+	unsigned int digest[8];
+	hash_ctx ctx;
+	time_t start, t;
 
 	uhdr = (struct boot_img_hdr *)EMMC_BOOT_IMG_HEADER_ADDR;
 	if (!memcmp(uhdr->magic, BOOT_MAGIC, BOOT_MAGIC_SIZE)) {
@@ -443,6 +485,16 @@ int boot_linux_from_mmc(void)
 	if (hdr->page_size && (hdr->page_size != page_size)) {
 		page_size = hdr->page_size;
 		page_mask = page_size - 1;
+		if (page_size > sizeof(buf)) {
+			dprintf(CRITICAL, "ERROR: Unsupported page size %u\n", page_size);
+			return -1;
+		}
+		/* the whole header page is hashed, so read it again at the
+		 * image's page size */
+		if (mmc_read(ptn + offset, (unsigned int *) buf, page_size)) {
+			dprintf(CRITICAL, "ERROR: Cannot read boot image header\n");
+			return -1;
+		}
 	}
 
 	/* Authenticate Kernel */
@@ -459,27 +511,46 @@ int boot_linux_from_mmc(void)
 		/* Assuming device rooted at this time */
 		device.is_tampered = 1;
 
-		/* Read image without signature */
+		/* Read image without signature. Kernel and ramdisk go straight
+		 * to their load addresses and are hashed chunk by chunk on the
+		 * way in; the header page is already in buf.
+		 */
 		/* 从 EMMC 读取除了签名之外的boot/fastboot部分(kernel+ramdisk) */
-		if (mmc_read(ptn + offset, (void *)image_addr, imagesize_actual))
+		start = current_time();
+		memset(&boot_timing, 0, sizeof(boot_timing));
+		hash_init(&ctx, CRYPTO_AUTH_ALG_SHA256);
+		hash_update(&ctx, buf, page_size, FALSE);
+		offset = page_size;
+
+		if (mmc_read_and_hash(ptn + offset, (unsigned char *)hdr->kernel_addr,
+				      kernel_actual, &ctx, ramdisk_actual == 0))
 		{
-			dprintf(CRITICAL, "ERROR: Cannot read boot image\n");
+			dprintf(CRITICAL, "ERROR: Cannot read kernel image\n");
 				return -1;
 		}
+		offset += kernel_actual;
+
+		if (mmc_read_and_hash(ptn + offset, (unsigned char *)hdr->ramdisk_addr,
+				      ramdisk_actual, &ctx, TRUE))
+		{
+			dprintf(CRITICAL, "ERROR: Cannot read ramdisk image\n");
+				return -1;
+		}
+		offset += ramdisk_actual;
+		hash_final(&ctx, (unsigned char *)digest);
 
-		offset = imagesize_actual;
 		/* Read signature */
 		/* 从 EMMC 读取内核的签名信息 */
-		if(mmc_read(ptn + offset, (void *)(image_addr + offset), page_size))
+		t = current_time();
+		if(mmc_read(ptn + offset, (void *)image_addr, page_size))
 		{
 			dprintf(CRITICAL, "ERROR: Cannot read boot image signature\n");
 		}
 		else
 		{
 			/* 对 boot.img 鉴权 */
-			auth_kernel_img = image_verify((unsigned char *)image_addr,
-					(unsigned char *)(image_addr + imagesize_actual),
-					imagesize_actual,
+			auth_kernel_img = image_verify_digest((unsigned char *)digest,
+					(unsigned char *)image_addr,
 					CRYPTO_AUTH_ALG_SHA256);
 
 			if(auth_kernel_img)
@@ -489,10 +560,10 @@ int boot_linux_from_mmc(void)
 			}
 		}
 
-		/* Move kernel and ramdisk to correct address */ 
-		/* 将 kernel 和 ramdisk 移到正确的地址处(一般加载到 0x00008000 物理地址)  */
-		memmove((void*) hdr->kernel_addr, (char *)(image_addr + page_size), hdr->kernel_size);
-		memmove((void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual), hdr->ramdisk_size);
+		dprintf(INFO, "boot image: %u bytes, read %lu ms, hash %lu ms, "
+			"verify %lu ms, total %lu ms\n", imagesize_actual,
+			boot_timing.read, boot_timing.hash, current_time() - t,
+			current_time() - start);
 
 		/* Make sure everything from scratch address is read before next step!*/
 		if(device.is_tampered)
@@ -1013,16 +1084,142 @@ void cmd_flash_mmc_img(const char *arg, void *data, unsigned sz)
 	return;
 }
 
+/* Largest transfer mmc_write() issues as a single multi-block write */
+#define FLASH_MAX_WRITE		((0xFFFFFF / 512) * 512)
+#define FLASH_FILL_BUF_SIZE	(256 * 1024)
+
+static unsigned int fill_buf[FLASH_FILL_BUF_SIZE / sizeof(unsigned int)];
+static uint32_t fill_buf_pattern;
+static int fill_buf_valid;
+
+static struct {
+	unsigned long long written;
+	unsigned long long erased;
+	unsigned long long skipped;
+	unsigned writes;
+	time_t start;
+} flash_stats;
+
+static void flash_stats_start(void)
+{
+	memset(&flash_stats, 0, sizeof(flash_stats));
+	flash_stats.start = current_time();
+}
+
+static void flash_stats_report(void)
+{
+	char response[64];
+	time_t ms = current_time() - flash_stats.start;
+	unsigned rate;
+
+	if (ms == 0)
+		ms = 1;
+	/* bytes per ms / 100 is tenths of a MB/s */
+	rate = (unsigned) (flash_stats.written / ms / 100);
+
+	snprintf(response, sizeof(response), "wrote %llu bytes in %u writes",
+		 flash_stats.written, flash_stats.writes);
+	fastboot_info(response);
+	snprintf(response, sizeof(response), "erased %llu, skipped %llu bytes",
+		 flash_stats.erased, flash_stats.skipped);
+	fastboot_info(response);
+	snprintf(response, sizeof(response), "%lu ms, %u.%u MB/s",
+		 ms, rate / 10, rate % 10);
+	fastboot_info(response);
+}
+
+static int emmc_write(unsigned long long addr, unsigned len, void *data)
+{
+	flash_stats.writes++;
+	flash_stats.written += len;
+	return mmc_write(addr, len, data) ? -1 : 0;
+}
+
+/*
+ * Erase the whole erase groups inside [addr, addr + len) and return the
+ * erased range in *start and *end (empty if no group fits). Partial
+ * groups at either end are left alone, erasing them would clobber the
+ * neighbouring data.
+ */
+static int emmc_erase_groups(unsigned long long addr, unsigned long long len,
+			     unsigned long long *start, unsigned long long *end)
+{
+	unsigned long long grp = mmc_get_erase_group_size();
+
+	*start = *end = addr;
+	if (grp == 0)
+		return 0;
+
+	*end = (addr + len) / grp * grp;
+	*start = (addr + grp - 1) / grp * grp;
+	if (*end <= *start) {
+		*start = *end = addr;
+		return 0;
+	}
+
+	flash_stats.erased += *end - *start;
+	return mmc_erase_card(*start, *end - *start) ? -1 : 0;
+}
+
+static int emmc_fill_write(unsigned long long addr, unsigned long long len,
+			   uint32_t pattern)
+{
+	unsigned i, n;
+
+	if (!fill_buf_valid || fill_buf_pattern != pattern) {
+		for (i = 0; i < sizeof(fill_buf) / sizeof(fill_buf[0]); i++)
+			fill_buf[i] = pattern;
+		fill_buf_pattern = pattern;
+		fill_buf_valid = 1;
+	}
+
+	while (len) {
+		n = (len < sizeof(fill_buf)) ? len : sizeof(fill_buf);
+		if (emmc_write(addr, n, fill_buf))
+			return -1;
+		addr += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Repeat a 32 bit pattern over [addr, addr + len) */
+static int emmc_fill(unsigned long long addr, unsigned long long len,
+		     uint32_t pattern)
+{
+	unsigned long long start, end;
+
+	if (pattern != 0 || !mmc_erase_reads_zero())
+		return emmc_fill_write(addr, len, pattern);
+
+	/* zeroes: erase what we can and write only the unaligned edges */
+	if (emmc_erase_groups(addr, len, &start, &end))
+		return -1;
+	if (start == end)
+		return emmc_fill_write(addr, len, 0);
+
+	if (emmc_fill_write(addr, start - addr, 0))
+		return -1;
+	return emmc_fill_write(end, addr + len - end, 0);
+}
+
 void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 {
 	unsigned int chunk;
-	unsigned int chunk_data_sz;
+	uint64_t chunk_data_sz;
 	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
+	chunk_header_t chunk_header;
 	uint32_t total_blocks = 0;
 	unsigned long long ptn = 0;
 	unsigned long long size = 0;
+	unsigned long long addr;
+	uint64_t offset;
 	int index = INVALID_PTN;
+	/* pending run of RAW data, compacted in place so that back to back
+	 * chunks go out as one multi-block write */
+	void *run = NULL;
+	unsigned run_len = 0;
+	unsigned long long run_addr = 0;
 
 	index = partition_get_index(arg);
 	ptn = partition_get_offset(index);
@@ -1058,17 +1255,27 @@ void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 	dprintf (SPEW, "total_blks: %d\n", sparse_header->total_blks);
 	dprintf (SPEW, "total_chunks: %d\n", sparse_header->total_chunks);
 
+	if ((uint64_t)sparse_header->total_blks * sparse_header->blk_sz > size)
+	{
+		fastboot_fail("size too large");
+		return;
+	}
+
+	flash_stats_start();
+
 	/* Start processing chunks */
 	for (chunk=0; chunk<sparse_header->total_chunks; chunk++)
 	{
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *) data;
+		/* Read and skip over chunk header. Take a copy, the header
+		 * may be overwritten when RAW data is compacted below.
+		 */
+		memcpy(&chunk_header, data, sizeof(chunk_header_t));
 		data += sizeof(chunk_header_t);
 
 		dprintf (SPEW, "=== Chunk Header ===\n");
-		dprintf (SPEW, "chunk_type: 0x%x\n", chunk_header->chunk_type);
-		dprintf (SPEW, "chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-		dprintf (SPEW, "total_size: 0x%x\n", chunk_header->total_sz);
+		dprintf (SPEW, "chunk_type: 0x%x\n", chunk_header.chunk_type);
+		dprintf (SPEW, "chunk_data_sz: 0x%x\n", chunk_header.chunk_sz);
+		dprintf (SPEW, "total_size: 0x%x\n", chunk_header.total_sz);
 
 		if(sparse_header->chunk_hdr_sz > sizeof(chunk_header_t))
 		{
@@ -1078,39 +1285,78 @@ void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 			data += (sparse_header->chunk_hdr_sz - sizeof(chunk_header_t));
 		}
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		switch (chunk_header->chunk_type)
+		chunk_data_sz = (uint64_t)sparse_header->blk_sz * chunk_header.chunk_sz;
+		offset = (uint64_t)total_blocks * sparse_header->blk_sz;
+		/* total_blks is not trusted, every chunk must stay inside the partition */
+		if (offset + chunk_data_sz > size)
+		{
+			fastboot_fail("size too large");
+			return;
+		}
+		addr = ptn + offset;
+		switch (chunk_header.chunk_type)
 		{
 			case CHUNK_TYPE_RAW:
-			if(chunk_header->total_sz != (sparse_header->chunk_hdr_sz +
+			if(chunk_header.total_sz != (sparse_header->chunk_hdr_sz +
 											chunk_data_sz))
 			{
 				fastboot_fail("Bogus chunk size for chunk type Raw");
 				return;
 			}
 
-			if(mmc_write(ptn + ((uint64_t)total_blocks*sparse_header->blk_sz),
-						chunk_data_sz,
-						(unsigned int*)data))
+			if(run_len && (run_addr + run_len != addr ||
+				       run_len + chunk_data_sz > FLASH_MAX_WRITE))
+			{
+				if(emmc_write(run_addr, run_len, run))
+				{
+					fastboot_fail("flash write failure");
+					return;
+				}
+				run_len = 0;
+			}
+
+			if(run_len == 0)
+			{
+				run = data;
+				run_addr = addr;
+			}
+			else
+				memmove(run + run_len, data, chunk_data_sz);
+			run_len += chunk_data_sz;
+
+			total_blocks += chunk_header.chunk_sz;
+			data += chunk_data_sz;
+			break;
+
+			case CHUNK_TYPE_FILL:
+			if(chunk_header.total_sz != (sparse_header->chunk_hdr_sz +
+											sizeof(uint32_t)))
+			{
+				fastboot_fail("Bogus chunk size for chunk type Fill");
+				return;
+			}
+
+			if(emmc_fill(addr, chunk_data_sz, *(uint32_t *)data))
 			{
 				fastboot_fail("flash write failure");
 				return;
 			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
+			total_blocks += chunk_header.chunk_sz;
+			data += sizeof(uint32_t);
 			break;
 
 			case CHUNK_TYPE_DONT_CARE:
-			total_blocks += chunk_header->chunk_sz;
+			flash_stats.skipped += chunk_data_sz;
+			total_blocks += chunk_header.chunk_sz;
 			break;
 
 			case CHUNK_TYPE_CRC:
-			if(chunk_header->total_sz != sparse_header->chunk_hdr_sz)
+			if(chunk_header.total_sz != sparse_header->chunk_hdr_sz)
 			{
 				fastboot_fail("Bogus chunk size for chunk type Dont Care");
 				return;
 			}
-			total_blocks += chunk_header->chunk_sz;
+			total_blocks += chunk_header.chunk_sz;
 			data += chunk_data_sz;
 			break;
 
@@ -1120,6 +1366,12 @@ void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 		}
 	}
 
+	if(run_len && emmc_write(run_addr, run_len, run))
+	{
+		fastboot_fail("flash write failure");
+		return;
+	}
+
 	dprintf(INFO, "Wrote %d blocks, expected to write %d blocks\n",
 					total_blocks, sparse_header->total_blks);
 
@@ -1128,10 +1380,144 @@ void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 		fastboot_fail("sparse image write failure");
 	}
 
+	flash_stats_report();
 	fastboot_okay("");
 	return;
 }
 
+/*
+ * Streaming flash: "oem stream-flash <partition> [erase]" arms the next
+ * download to be parsed and written to <partition> while it is still
+ * coming in over USB, so it is no longer limited by the download buffer.
+ * With "erase", DONT_CARE regions are erased rather than left alone. The
+ * flash:<partition> that follows the download reports the outcome; a
+ * streamed download leaves no data behind, so a flash: after a regular
+ * download is handled as usual.
+ */
+#define STREAM_FLASH_IDLE	0
+#define STREAM_FLASH_ARMED	1
+#define STREAM_FLASH_DONE	2
+
+static struct {
+	int state;
+	int status;
+	char name[MAX_GPT_NAME_SIZE];
+	unsigned long long ptn;
+	struct sparse_stream parser;
+	struct fastboot_stream sink;
+} stream_flash;
+
+static int stream_flash_write(void *cookie, uint64_t offset, unsigned len,
+			      void *data)
+{
+	return emmc_write(stream_flash.ptn + offset, len, data);
+}
+
+static int stream_flash_erase(void *cookie, uint64_t offset, uint64_t len)
+{
+	unsigned long long start, end;
+
+	return emmc_erase_groups(stream_flash.ptn + offset, len, &start, &end);
+}
+
+static int stream_flash_fill(void *cookie, uint64_t offset, uint64_t len,
+			     uint32_t pattern)
+{
+	return emmc_fill(stream_flash.ptn + offset, len, pattern);
+}
+
+static const struct sparse_stream_ops stream_flash_ops = {
+	.write = stream_flash_write,
+	.erase = stream_flash_erase,
+	.fill = stream_flash_fill,
+};
+
+static int stream_flash_data(void *cookie, void *data, unsigned len)
+{
+	return sparse_stream_feed(&stream_flash.parser, data, len);
+}
+
+static void stream_flash_finish(void *cookie, int status)
+{
+	if (status == 0)
+		status = sparse_stream_finish(&stream_flash.parser);
+	else if (!stream_flash.parser.error)
+		stream_flash.parser.error = "download failure";
+
+	stream_flash.status = status;
+	stream_flash.state = STREAM_FLASH_DONE;
+}
+
+void cmd_oem_stream_flash(const char *arg, void *data, unsigned sz)
+{
+	char name[MAX_GPT_NAME_SIZE];
+	unsigned long long ptn;
+	unsigned flags = 0;
+	unsigned n;
+	int index;
+
+	while (*arg == ' ')
+		arg++;
+	for (n = 0; arg[n] && arg[n] != ' ' && n < sizeof(name) - 1; n++)
+		name[n] = arg[n];
+	name[n] = 0;
+	arg += n;
+	while (*arg == ' ')
+		arg++;
+
+	if (!strcmp(arg, "erase"))
+		flags |= SPARSE_STREAM_ERASE_DONT_CARE;
+	else if (*arg || !n) {
+		fastboot_fail("usage: oem stream-flash <partition> [erase]");
+		return;
+	}
+
+	index = partition_get_index(name);
+	ptn = partition_get_offset(index);
+	if(ptn == 0) {
+		fastboot_fail("partition table doesn't exist");
+		return;
+	}
+
+	strcpy(stream_flash.name, name);
+	stream_flash.ptn = ptn;
+	stream_flash.status = 0;
+	sparse_stream_init(&stream_flash.parser, &stream_flash_ops, NULL,
+			   partition_get_size(index), flags);
+	stream_flash.sink.write = stream_flash_data;
+	stream_flash.sink.finish = stream_flash_finish;
+	stream_flash.state = STREAM_FLASH_ARMED;
+	if (fastboot_stream_arm(&stream_flash.sink)) {
+		stream_flash.state = STREAM_FLASH_IDLE;
+		fastboot_fail("can't stream the download");
+		return;
+	}
+	flash_stats_start();
+	fastboot_okay("");
+}
+
+static void cmd_flash_mmc_stream(const char *arg)
+{
+	stream_flash.state = STREAM_FLASH_IDLE;
+
+	if (strcmp(arg, stream_flash.name)) {
+		fastboot_fail("streamed image was for another partition");
+		return;
+	}
+
+	if (stream_flash.status) {
+		fastboot_fail(stream_flash.parser.error);
+		return;
+	}
+
+	dprintf(INFO, "Streamed %llu bytes, skipped %llu bytes\n",
+		stream_flash.parser.bytes_written,
+		stream_flash.parser.bytes_skipped);
+	flash_stats.skipped = stream_flash.parser.bytes_skipped;
+	flash_stats_report();
+	fastboot_okay("");
+}
+
 void cmd_flash_mmc(const char *arg, void *data, unsigned sz)
 {
 	sparse_header_t *sparse_header;
@@ -1139,6 +1525,15 @@ void cmd_flash_mmc(const char *arg, void *data, unsigned sz)
 	unsigned int *magic_number = (unsigned int *) data;
 	int ret=0;
 
+	if (stream_flash.state == STREAM_FLASH_DONE) {
+		/* only if the streamed download was the last one */
+		if (!sz) {
+			cmd_flash_mmc_stream(arg);
+			return;
+		}
+		stream_flash.state = STREAM_FLASH_IDLE;
+	}
+
 	if (magic_number[0] == DECRYPT_MAGIC_0 &&
 		magic_number[1] == DECRYPT_MAGIC_1)
 	{
@@ -1435,6 +1830,7 @@ fastboot:
 	{
 		fastboot_register("flash:", cmd_flash_mmc);
 		fastboot_register("erase:", cmd_erase_mmc);
+		fastboot_register("oem stream-flash", cmd_oem_stream_flash);
 	}
 	else
 	{
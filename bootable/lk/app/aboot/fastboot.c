@@ -32,10 +32,22 @@
 #include <kernel/thread.h>
 #include <kernel/event.h>
 #include <dev/udc.h>
+#include <platform.h>
+
+#include "fastboot.h"
 
 #define MAX_RSP_SIZE 64
 #define MAX_USBFS_BULK_SIZE (16 * 1024)
 
+/* reads are split into requests of up to USB_READ_CHUNK bytes, with
+ * USB_READ_DEPTH of them queued so the controller never waits for us
+ */
+#define USB_READ_DEPTH 4
+#define USB_READ_CHUNK (4 * MAX_USBFS_BULK_SIZE)
+
+#define STREAM_SLOTS 3
+#define STREAM_SLOT_SIZE (1024 * 1024)
+
 void boot_linux(void *bootimg, unsigned sz);
 
 /* todo: give lk strtoul and nuke this */
@@ -117,6 +129,11 @@ static struct udc_endpoint *in, *out;
 static struct udc_request *req;
 int txn_status;
 
+static event_t rx_done;
+static struct udc_request *rx_req[USB_READ_DEPTH];
+static volatile int rx_status[USB_READ_DEPTH];
+static volatile int rx_busy[USB_READ_DEPTH];
+
 static void *download_base;
 static unsigned download_max;
 static unsigned download_size;
@@ -128,6 +145,21 @@ static unsigned download_size;
 
 static unsigned fastboot_state = STATE_OFFLINE;
 
+/* Streaming download: the download buffer is carved into STREAM_SLOTS
+ * slots; the fastboot thread fills them from USB while stream_thread
+ * hands full ones to the sink, so USB and flash writes overlap.
+ */
+static struct fastboot_stream *stream;
+static thread_t *stream_thread;
+static event_t stream_filled;
+static event_t stream_drained;
+static void *stream_buf[STREAM_SLOTS];
+static unsigned stream_len[STREAM_SLOTS];
+static unsigned stream_slot_size;
+static unsigned stream_head, stream_tail;
+static volatile unsigned stream_count;
+static volatile int stream_status;
+
 static void req_complete(struct udc_request *req, unsigned actual, int status)
 {
 	txn_status = status;
@@ -135,43 +167,82 @@ static void req_complete(struct udc_request *req, unsigned actual, int status)
 	event_signal(&txn_done, 0);
 }
 
+static void rx_complete(struct udc_request *req, unsigned actual, int status)
+{
+	unsigned slot = (unsigned) req->context;
+
+	rx_status[slot] = status;
+	req->length = actual;
+	rx_busy[slot] = 0;
+	event_signal(&rx_done, 0);
+}
+
+/* drop whatever is still queued, oldest first */
+static void rx_cancel(unsigned head, unsigned queued)
+{
+	while (queued--) {
+		if (rx_busy[head]) {
+			udc_request_cancel(out, rx_req[head]);
+			return;
+		}
+		head = (head + 1) % USB_READ_DEPTH;
+	}
+}
+
 static int usb_read(void *_buf, unsigned len)
 {
 	int r;
-	unsigned xfer;
-	unsigned char *buf = _buf;
+	unsigned char *next = _buf;
+	unsigned xfer[USB_READ_DEPTH];
+	unsigned head = 0, tail = 0, queued = 0;
 	int count = 0;
 
 	if (fastboot_state == STATE_ERROR)
 		goto oops;
 
-	while (len > 0) {
-		xfer = (len > MAX_USBFS_BULK_SIZE) ? MAX_USBFS_BULK_SIZE : len;
-		req->buf = buf;
-		req->length = xfer;
-		req->complete = req_complete;
-		r = udc_request_queue(out, req);
-		if (r < 0) {
-			dprintf(INFO, "usb_read() queue failed\n");
-			goto oops;
+	while (len > 0 || queued) {
+		/* keep the pipe full */
+		while (len > 0 && queued < USB_READ_DEPTH) {
+			xfer[tail] = (len > USB_READ_CHUNK) ? USB_READ_CHUNK : len;
+			rx_req[tail]->buf = next;
+			rx_req[tail]->length = xfer[tail];
+			rx_req[tail]->complete = rx_complete;
+			rx_busy[tail] = 1;
+			r = udc_request_queue(out, rx_req[tail]);
+			if (r < 0) {
+				rx_busy[tail] = 0;
+				dprintf(INFO, "usb_read() queue failed\n");
+				goto cancel;
+			}
+			next += xfer[tail];
+			len -= xfer[tail];
+			tail = (tail + 1) % USB_READ_DEPTH;
+			queued++;
 		}
-		event_wait(&txn_done);
 
-		if (txn_status < 0) {
+		while (rx_busy[head])
+			event_wait(&rx_done);
+		queued--;
+
+		if (rx_status[head] < 0) {
 			dprintf(INFO, "usb_read() transaction failed\n");
-			goto oops;
+			goto cancel;
 		}
 
-		count += req->length;
-		buf += req->length;
-		len -= req->length;
+		count += rx_req[head]->length;
 
 		/* short transfer? */
-		if (req->length != xfer) break;
+		if (rx_req[head]->length != xfer[head]) {
+			rx_cancel((head + 1) % USB_READ_DEPTH, queued);
+			break;
+		}
+		head = (head + 1) % USB_READ_DEPTH;
 	}
 
 	return count;
 
+cancel:
+	rx_cancel(head, queued);
 oops:
 	fastboot_state = STATE_ERROR;
 	return -1;
@@ -259,14 +330,112 @@ static void cmd_getvar(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 
+static int stream_handler(void *arg)
+{
+	unsigned tail;
+
+	for (;;) {
+		while (stream_count == 0)
+			event_wait(&stream_filled);
+
+		tail = stream_tail;
+		if (stream_status == 0)
+			stream_status = stream->write(stream->cookie,
+						      stream_buf[tail],
+						      stream_len[tail]);
+		stream_tail = (tail + 1) % STREAM_SLOTS;
+
+		enter_critical_section();
+		stream_count--;
+		exit_critical_section();
+		event_signal(&stream_drained, true);
+	}
+	return 0;
+}
+
+int fastboot_stream_arm(struct fastboot_stream *s)
+{
+	unsigned i;
+
+	if (s && !stream_thread) {
+		stream_slot_size = download_max / STREAM_SLOTS;
+		if (stream_slot_size > STREAM_SLOT_SIZE)
+			stream_slot_size = STREAM_SLOT_SIZE;
+		stream_slot_size &= ~(MAX_USBFS_BULK_SIZE - 1);
+		for (i = 0; i < STREAM_SLOTS; i++)
+			stream_buf[i] = download_base + i * stream_slot_size;
+
+		stream_thread = thread_create("fastboot_stream", stream_handler,
+					      0, DEFAULT_PRIORITY, 4096);
+		if (!stream_thread) {
+			dprintf(CRITICAL, "fastboot: no stream thread\n");
+			return -1;
+		}
+		thread_resume(stream_thread);
+	}
+	stream = s;
+	return 0;
+}
+
+static void fastboot_report_rate(const char *what, unsigned bytes, time_t ms)
+{
+	dprintf(INFO, "fastboot: %s %u bytes in %lu ms (%u KB/s)\n", what,
+		bytes, ms, ms ? (unsigned) ((unsigned long long) bytes * 1000 / 1024 / ms) : 0);
+}
+
+static void cmd_download_stream(unsigned len)
+{
+	unsigned n, total = len;
+	time_t start = current_time();
+	int r = 0;
+
+	stream_status = 0;
+	while (len) {
+		n = (len < stream_slot_size) ? len : stream_slot_size;
+
+		while (stream_count == STREAM_SLOTS)
+			event_wait(&stream_drained);
+
+		r = usb_read(stream_buf[stream_head], n);
+		if ((r < 0) || ((unsigned) r != n)) {
+			r = -1;
+			break;
+		}
+		stream_len[stream_head] = n;
+		stream_head = (stream_head + 1) % STREAM_SLOTS;
+
+		enter_critical_section();
+		stream_count++;
+		exit_critical_section();
+		event_signal(&stream_filled, true);
+		len -= n;
+	}
+
+	/* let the writer catch up before telling the sink we're done */
+	while (stream_count)
+		event_wait(&stream_drained);
+
+	stream->finish(stream->cookie, r < 0 ? r : stream_status);
+	stream = NULL;
+
+	if (r < 0) {
+		fastboot_state = STATE_ERROR;
+		return;
+	}
+
+	fastboot_report_rate("streamed", total, current_time() - start);
+	fastboot_okay("");
+}
+
 static void cmd_download(const char *arg, void *data, unsigned sz)
 {
 	char response[MAX_RSP_SIZE];
 	unsigned len = hex2unsigned(arg);
+	time_t start;
 	int r;
 
 	download_size = 0;
-	if (len > download_max) {
+	if (len > download_max && !stream) {
 		fastboot_fail("data too large");
 		return;
 	}
@@ -275,12 +444,19 @@ static void cmd_download(const char *arg, void *data, unsigned sz)
 	if (usb_write(response, strlen(response)) < 0)
 		return;
 
+	if (stream) {
+		cmd_download_stream(len);
+		return;
+	}
+
+	start = current_time();
 	r = usb_read(download_base, len);
 	if ((r < 0) || ((unsigned) r != len)) {
 		fastboot_state = STATE_ERROR;
 		return;
 	}
 	download_size = len;
+	fastboot_report_rate("downloaded", len, current_time() - start);
 	fastboot_okay("");
 }
 
@@ -346,6 +522,7 @@ static struct udc_gadget fastboot_gadget = {
 int fastboot_init(void *base, unsigned size)
 {
 	thread_t *thr;
+	unsigned i;
 	dprintf(INFO, "fastboot_init()\n");
 
 	download_base = base;
@@ -353,6 +530,9 @@ int fastboot_init(void *base, unsigned size)
 
 	event_init(&usb_online, 0, EVENT_FLAG_AUTOUNSIGNAL);
 	event_init(&txn_done, 0, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&rx_done, 0, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&stream_filled, 0, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&stream_drained, 0, EVENT_FLAG_AUTOUNSIGNAL);
 
 	in = udc_endpoint_alloc(UDC_TYPE_BULK_IN, 512);
 	if (!in)
@@ -367,6 +547,12 @@ int fastboot_init(void *base, unsigned size)
 	req = udc_request_alloc();
 	if (!req)
 		goto fail_alloc_req;
+	for (i = 0; i < USB_READ_DEPTH; i++) {
+		rx_req[i] = udc_request_alloc();
+		if (!rx_req[i])
+			goto fail_alloc_rx;
+		rx_req[i]->context = (void *) i;
+	}
 
 	if (udc_register_gadget(&fastboot_gadget))
 		goto fail_udc_register;
@@ -386,6 +572,9 @@ int fastboot_init(void *base, unsigned size)
 	return 0;
 
 fail_udc_register:
+fail_alloc_rx:
+	for (i = 0; i < USB_READ_DEPTH && rx_req[i]; i++)
+		udc_request_free(rx_req[i]);
 	udc_request_free(req);
 fail_alloc_req:
 	udc_endpoint_free(out);	
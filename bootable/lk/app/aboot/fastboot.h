@@ -47,5 +47,24 @@ void fastboot_okay(const char *result);
 void fastboot_fail(const char *reason);
 void fastboot_info(const char *reason);
 
+/* streaming download sink
+ * - armed from a command handler, it takes over the next download:
+ *   which is then not limited by the download buffer size
+ * - write() is called from a separate thread on each piece of the
+ *   download as it arrives; once it returns non-zero no more pieces
+ *   are passed on, but the rest of the transfer is still received
+ * - finish() is called once the transfer is over, with the first
+ *   write() error, or a negative value if the transfer broke off
+ * - the sink is disarmed after one download
+ * - arming returns non-zero if streaming can't be set up
+ */
+struct fastboot_stream {
+	int (*write)(void *cookie, void *data, unsigned len);
+	void (*finish)(void *cookie, int status);
+	void *cookie;
+};
+
+int fastboot_stream_arm(struct fastboot_stream *stream);
+
 
 #endif
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HOST_DEBUG_H
+#define __HOST_DEBUG_H
+
+/*
+ * Stand-in for the LK debug.h when target-independent aboot code is
+ * built into a host test program.
+ */
+
+#include <stdio.h>
+
+#define ALWAYS 0
+#define CRITICAL 0
+#define INFO 1
+#define SPEW 2
+
+#ifndef DEBUGLEVEL
+#define DEBUGLEVEL CRITICAL
+#endif
+
+#define dprintf(level, x...) do { if ((level) <= DEBUGLEVEL) { fprintf(stderr, x); } } while (0)
+
+#endif
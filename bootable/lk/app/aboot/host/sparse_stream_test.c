@@ -0,0 +1,475 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Host test for the streaming sparse image parser. Random sparse images
+ * are written into a pipe standing in for the USB host, read back in
+ * arbitrary pieces into a ring of slots the way the fastboot download
+ * fills them, and fed to the parser from a second thread, which writes
+ * into a temporary file standing in for the partition. The file must end
+ * up matching the unsparsed image, with every write block aligned.
+ * Plain, oversized and truncated images are checked as well.
+ *
+ * Built from the lk top directory with
+ *
+ *   gcc -Iapp/aboot/host -Iapp/aboot -o sparse_stream_test \
+ *       app/aboot/host/sparse_stream_test.c app/aboot/sparse_stream.c -lpthread
+ *
+ *   sparse_stream_test [-n images] [-s seed]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sparse_stream.h"
+
+#define SLOTS		3
+#define SLOT_SIZE	(64 * 1024)
+#define DEV_BLOCKS	400
+#define ERASED		0xEE
+#define UNWRITTEN	0xAA
+
+struct image {
+	unsigned char *data;
+	size_t len;
+	unsigned char *expect;	/* the partition after flashing */
+	size_t size;		/* of the partition */
+};
+
+static unsigned rand_state;
+static int failed;
+
+static unsigned next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 8) & 0xffffff;
+}
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size ? size : 1);
+
+	if (!p) {
+		perror("malloc");
+		exit(1);
+	}
+	return p;
+}
+
+static void put(struct image *img, const void *data, size_t len)
+{
+	img->data = realloc(img->data, img->len + len);
+	if (!img->data) {
+		perror("realloc");
+		exit(1);
+	}
+	memcpy(img->data + img->len, data, len);
+	img->len += len;
+}
+
+static void put_chunk(struct image *img, unsigned hdr_sz, uint16_t type,
+		      uint32_t blocks, uint32_t total_sz)
+{
+	unsigned char hdr[32] = { 0 };
+	chunk_header_t chunk = { type, 0, blocks, total_sz };
+
+	memcpy(hdr, &chunk, sizeof(chunk));
+	put(img, hdr, hdr_sz);
+}
+
+/* a sparse image with random chunks that leaves some room on the partition */
+static void make_sparse(struct image *img)
+{
+	unsigned blk_sz = (next_rand() & 1) ? 4096 : 512;
+	unsigned file_hdr_sz = (next_rand() & 1) ? 32 : 28;
+	unsigned chunk_hdr_sz = (next_rand() & 1) ? 16 : 12;
+	unsigned char hdr[32] = { 0 }, *body, *p;
+	sparse_header_t header = { SPARSE_HEADER_MAGIC, 1, 0, file_hdr_sz,
+				   chunk_hdr_sz, blk_sz, 0, 0, 0 };
+	size_t off = 0, hdr_at, len, i;
+	uint32_t nblk, pattern;
+
+	img->size = (size_t) blk_sz * DEV_BLOCKS;
+	img->expect = xmalloc(img->size);
+	memset(img->expect, UNWRITTEN, img->size);
+
+	/* the header goes in last, once the counts are known */
+	hdr_at = img->len;
+	put(img, hdr, file_hdr_sz);
+
+	for (;;) {
+		unsigned type = next_rand() % 5;
+
+		nblk = (type == 4) ? 0 : next_rand() % 21;
+		if (off + (size_t) nblk * blk_sz > img->size - 25 * blk_sz)
+			break;
+		len = (size_t) nblk * blk_sz;
+		p = img->expect + off;
+
+		switch (type) {
+		case 0:
+		case 1:
+			put_chunk(img, chunk_hdr_sz, CHUNK_TYPE_RAW, nblk,
+				  chunk_hdr_sz + len);
+			for (i = 0; i < len; i++)
+				p[i] = next_rand();
+			put(img, p, len);
+			break;
+		case 2:
+			put_chunk(img, chunk_hdr_sz, CHUNK_TYPE_DONT_CARE, nblk,
+				  chunk_hdr_sz);
+			memset(p, ERASED, len);
+			break;
+		case 3:
+			pattern = next_rand() ^ (next_rand() << 16);
+			put_chunk(img, chunk_hdr_sz, CHUNK_TYPE_FILL, nblk,
+				  chunk_hdr_sz + 4);
+			put(img, &pattern, 4);
+			for (i = 0; i < len; i += 4)
+				memcpy(p + i, &pattern, 4);
+			break;
+		case 4:
+			put_chunk(img, chunk_hdr_sz, CHUNK_TYPE_CRC, 0,
+				  chunk_hdr_sz + 4);
+			put(img, "1234", 4);
+			break;
+		}
+		off += len;
+		header.total_chunks++;
+	}
+
+	header.total_blks = off / blk_sz;
+	body = img->data + hdr_at;
+	memcpy(body, &header, sizeof(header));
+}
+
+/* a raw image of odd length, padded with zeroes to the last block */
+static void make_plain(struct image *img)
+{
+	size_t i, len = 100000 + next_rand() % 1000;
+
+	img->size = 256 * 1024;
+	img->expect = xmalloc(img->size);
+	memset(img->expect, UNWRITTEN, img->size);
+	for (i = 0; i < len; i++)
+		img->expect[i] = next_rand();
+	if (img->expect[0] == 0x3a)
+		img->expect[0] = 0;	/* not the sparse magic */
+	put(img, img->expect, len);
+	memset(img->expect + len, 0,
+	       SPARSE_STREAM_BLOCK - len % SPARSE_STREAM_BLOCK);
+}
+
+static void free_image(struct image *img)
+{
+	free(img->data);
+	free(img->expect);
+	memset(img, 0, sizeof(*img));
+}
+
+/* the partition, a file written with pwrite() */
+
+struct partition {
+	int fd;
+	unsigned writes, erases, fills;
+	int misaligned;
+};
+
+static int dev_fill_bytes(int fd, uint64_t offset, uint64_t len,
+			  const unsigned char *pattern, unsigned pattern_len)
+{
+	unsigned char buf[4096];
+	unsigned i, n;
+
+	for (i = 0; i < sizeof(buf); i += pattern_len)
+		memcpy(buf + i, pattern, pattern_len);
+	while (len) {
+		n = (len < sizeof(buf)) ? len : sizeof(buf);
+		if (pwrite(fd, buf, n, offset) != (ssize_t) n)
+			return -1;
+		offset += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int dev_write(void *cookie, uint64_t offset, unsigned len, void *data)
+{
+	struct partition *dev = cookie;
+
+	dev->writes++;
+	if (offset % SPARSE_STREAM_BLOCK || len % SPARSE_STREAM_BLOCK ||
+	    ((unsigned long) data & 3))
+		dev->misaligned++;
+	return pwrite(dev->fd, data, len, offset) == (ssize_t) len ? 0 : -1;
+}
+
+static int dev_erase(void *cookie, uint64_t offset, uint64_t len)
+{
+	struct partition *dev = cookie;
+	unsigned char erased = ERASED;
+
+	dev->erases++;
+	if (offset % SPARSE_STREAM_BLOCK || len % SPARSE_STREAM_BLOCK)
+		dev->misaligned++;
+	return dev_fill_bytes(dev->fd, offset, len, &erased, 1);
+}
+
+static int dev_fill(void *cookie, uint64_t offset, uint64_t len, uint32_t pattern)
+{
+	struct partition *dev = cookie;
+
+	dev->fills++;
+	if (offset % SPARSE_STREAM_BLOCK || len % SPARSE_STREAM_BLOCK)
+		dev->misaligned++;
+	return dev_fill_bytes(dev->fd, offset, len, (unsigned char *) &pattern, 4);
+}
+
+static const struct sparse_stream_ops dev_ops = {
+	dev_write, dev_erase, dev_fill,
+};
+
+/*
+ * The download: a host thread writes the image into a pipe in random
+ * sized pieces, the "USB" side reads it into the slots and the flash
+ * thread feeds each filled slot to the parser.
+ */
+
+struct download {
+	int pipe[2];
+	const unsigned char *data;
+	size_t len;
+
+	pthread_mutex_t lock;
+	pthread_cond_t filled, drained;
+	unsigned char *slot[SLOTS];
+	unsigned slot_len[SLOTS];
+	unsigned head, tail, count;
+	int done;
+
+	struct sparse_stream stream;
+	int status;
+};
+
+static void *host_thread(void *arg)
+{
+	struct download *dl = arg;
+	unsigned seed = dl->len;	/* next_rand() belongs to the other side */
+	size_t off = 0, n;
+
+	while (off < dl->len) {
+		n = 1 + rand_r(&seed) % ((rand_r(&seed) & 1) ? 70000 : 3000);
+		if (n > dl->len - off)
+			n = dl->len - off;
+		if (write(dl->pipe[1], dl->data + off, n) != (ssize_t) n)
+			break;
+		off += n;
+	}
+	close(dl->pipe[1]);
+	return NULL;
+}
+
+static void *flash_thread(void *arg)
+{
+	struct download *dl = arg;
+	unsigned tail;
+
+	pthread_mutex_lock(&dl->lock);
+	for (;;) {
+		while (!dl->count && !dl->done)
+			pthread_cond_wait(&dl->filled, &dl->lock);
+		if (!dl->count)
+			break;
+		tail = dl->tail;
+		pthread_mutex_unlock(&dl->lock);
+
+		if (dl->status == 0)
+			dl->status = sparse_stream_feed(&dl->stream, dl->slot[tail],
+							dl->slot_len[tail]);
+
+		pthread_mutex_lock(&dl->lock);
+		dl->tail = (tail + 1) % SLOTS;
+		dl->count--;
+		pthread_cond_signal(&dl->drained);
+	}
+	pthread_mutex_unlock(&dl->lock);
+	return NULL;
+}
+
+/* flashes an image, returns the parser status and the partition fd */
+static int flash(struct image *img, struct partition *dev, const char **error)
+{
+	struct download dl;
+	pthread_t host, flasher;
+	unsigned char *slots;
+	unsigned i, want;
+	ssize_t n;
+
+	memset(&dl, 0, sizeof(dl));
+	memset(dev, 0, sizeof(*dev));
+
+	dev->fd = fileno(tmpfile());
+	if (dev->fd < 0 || ftruncate(dev->fd, img->size) ||
+	    dev_fill_bytes(dev->fd, 0, img->size,
+			   (const unsigned char []) { UNWRITTEN }, 1)) {
+		perror("partition");
+		exit(1);
+	}
+	if (pipe(dl.pipe)) {
+		perror("pipe");
+		exit(1);
+	}
+
+	/* every other slot is unaligned, to exercise the copying path */
+	slots = xmalloc(SLOTS * (SLOT_SIZE + 4));
+	for (i = 0; i < SLOTS; i++)
+		dl.slot[i] = slots + i * (SLOT_SIZE + 4) + (i & 1);
+
+	dl.data = img->data;
+	dl.len = img->len;
+	pthread_mutex_init(&dl.lock, NULL);
+	pthread_cond_init(&dl.filled, NULL);
+	pthread_cond_init(&dl.drained, NULL);
+	sparse_stream_init(&dl.stream, &dev_ops, dev, img->size,
+			   SPARSE_STREAM_ERASE_DONT_CARE);
+
+	pthread_create(&host, NULL, host_thread, &dl);
+	pthread_create(&flasher, NULL, flash_thread, &dl);
+
+	for (;;) {
+		pthread_mutex_lock(&dl.lock);
+		while (dl.count == SLOTS)
+			pthread_cond_wait(&dl.drained, &dl.lock);
+		pthread_mutex_unlock(&dl.lock);
+
+		/* like usb_read(), short reads end a slot early */
+		want = 1 + next_rand() % SLOT_SIZE;
+		n = read(dl.pipe[0], dl.slot[dl.head], want);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+
+		pthread_mutex_lock(&dl.lock);
+		dl.slot_len[dl.head] = n;
+		dl.head = (dl.head + 1) % SLOTS;
+		dl.count++;
+		pthread_cond_signal(&dl.filled);
+		pthread_mutex_unlock(&dl.lock);
+	}
+
+	pthread_mutex_lock(&dl.lock);
+	dl.done = 1;
+	pthread_cond_signal(&dl.filled);
+	pthread_mutex_unlock(&dl.lock);
+	pthread_join(flasher, NULL);
+	pthread_join(host, NULL);
+	close(dl.pipe[0]);
+	free(slots);
+
+	if (dl.status == 0)
+		dl.status = sparse_stream_finish(&dl.stream);
+	*error = dl.stream.error;
+	return dl.status;
+}
+
+static int partition_matches(struct partition *dev, struct image *img)
+{
+	unsigned char *buf = xmalloc(img->size);
+	int ret;
+
+	ret = pread(dev->fd, buf, img->size, 0) == (ssize_t) img->size &&
+	      !memcmp(buf, img->expect, img->size);
+	free(buf);
+	return ret;
+}
+
+#define CHECK(cond, fmt, args...)					\
+	do {								\
+		if (!(cond)) {						\
+			printf("FAIL " fmt " (line %d)\n", ##args, __LINE__); \
+			failed = 1;					\
+		}							\
+	} while (0)
+
+int main(int argc, char **argv)
+{
+	struct image img = { 0 };
+	struct partition dev;
+	const char *error;
+	unsigned images = 50, seed = 1, i;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n': images = atoi(optarg); break;
+		case 's': seed = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n images] [-s seed]\n", argv[0]);
+			return 1;
+		}
+	}
+	rand_state = seed;
+
+	for (i = 0; i < images; i++) {
+		make_sparse(&img);
+		ret = flash(&img, &dev, &error);
+		CHECK(ret == 0, "image %u: %s", i, error);
+		CHECK(partition_matches(&dev, &img), "image %u: partition differs", i);
+		CHECK(!dev.misaligned, "image %u: %d misaligned calls", i, dev.misaligned);
+		close(dev.fd);
+		free_image(&img);
+	}
+	printf("%u sparse images flashed\n", images);
+
+	make_plain(&img);
+	ret = flash(&img, &dev, &error);
+	CHECK(ret == 0 && partition_matches(&dev, &img), "plain image: %s",
+	      error ? error : "partition differs");
+	close(dev.fd);
+	free_image(&img);
+
+	/* a header that claims more than the partition holds writes nothing */
+	make_sparse(&img);
+	img.size /= 2;
+	ret = flash(&img, &dev, &error);
+	CHECK(ret < 0 && error && !strcmp(error, "size too large") &&
+	      !dev.writes && !dev.erases && !dev.fills,
+	      "oversized image: %s, %u writes", error ? error : "accepted", dev.writes);
+	close(dev.fd);
+	free_image(&img);
+
+	make_sparse(&img);
+	img.len -= 1 + next_rand() % 100;
+	ret = flash(&img, &dev, &error);
+	CHECK(ret < 0, "truncated image accepted");
+	close(dev.fd);
+	free_image(&img);
+
+	printf("%s\n", failed ? "FAILED" : "PASS");
+	return failed;
+}
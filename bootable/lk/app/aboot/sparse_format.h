@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#ifndef __APP_SPARSE_FORMAT_H
+#define __APP_SPARSE_FORMAT_H
+
 typedef struct sparse_header {
   uint32_t  magic;		/* 0xed26ff3a */
   uint16_t	major_version;	/* (0x1) - reject images with higher major versions */
@@ -46,3 +49,4 @@ typedef struct chunk_header {
  *  For a Fill chunk, it's 4 bytes of the fill data.
  */
 
+#endif
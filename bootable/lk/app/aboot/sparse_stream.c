@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <debug.h>
+#include <string.h>
+#include "sparse_stream.h"
+
+#define SS_FILE_HDR	0
+#define SS_PLAIN	1
+#define SS_CHUNK_HDR	2
+#define SS_CHUNK_DATA	3
+#define SS_FILL_DATA	4
+#define SS_DONE		5
+#define SS_ERROR	6
+
+static int stream_fail(struct sparse_stream *s, const char *error)
+{
+	s->state = SS_ERROR;
+	s->error = error;
+	return -1;
+}
+
+static int stream_write(struct sparse_stream *s, void *data, unsigned len)
+{
+	if (s->offset + len > s->size)
+		return stream_fail(s, "size too large");
+
+	if (s->ops->write(s->cookie, s->offset, len, data))
+		return stream_fail(s, "flash write failure");
+
+	s->offset += len;
+	s->bytes_written += len;
+	return 0;
+}
+
+/* Queue image data for the current output offset, a block at a time */
+static int stream_emit(struct sparse_stream *s, const unsigned char *data,
+		       unsigned len)
+{
+	unsigned n;
+
+	if (s->block_len) {
+		n = SPARSE_STREAM_BLOCK - s->block_len;
+		if (n > len)
+			n = len;
+		memcpy(s->block + s->block_len, data, n);
+		s->block_len += n;
+		data += n;
+		len -= n;
+
+		if (s->block_len < SPARSE_STREAM_BLOCK)
+			return 0;
+		s->block_len = 0;
+		if (stream_write(s, s->block, SPARSE_STREAM_BLOCK))
+			return -1;
+	}
+
+	n = len & ~(SPARSE_STREAM_BLOCK - 1);
+	if (n && ((unsigned long) data & 3)) {
+		/* the controller wants word aligned buffers */
+		while (len >= SPARSE_STREAM_BLOCK) {
+			memcpy(s->block, data, SPARSE_STREAM_BLOCK);
+			if (stream_write(s, s->block, SPARSE_STREAM_BLOCK))
+				return -1;
+			data += SPARSE_STREAM_BLOCK;
+			len -= SPARSE_STREAM_BLOCK;
+		}
+	} else if (n) {
+		if (stream_write(s, (void *) data, n))
+			return -1;
+		data += n;
+		len -= n;
+	}
+
+	memcpy(s->block, data, len);
+	s->block_len = len;
+	return 0;
+}
+
+/* Collect up to 'want' header bytes; returns how many were consumed */
+static unsigned stream_gather(struct sparse_stream *s, const unsigned char *data,
+			      unsigned len, unsigned want)
+{
+	unsigned n = want - s->hdr_len;
+
+	if (n > len)
+		n = len;
+	memcpy(s->hdr_buf + s->hdr_len, data, n);
+	s->hdr_len += n;
+	return n;
+}
+
+static void stream_next_chunk(struct sparse_stream *s)
+{
+	s->hdr_len = 0;
+	if (++s->chunk_index == s->header.total_chunks)
+		s->state = SS_DONE;
+	else
+		s->state = SS_CHUNK_HDR;
+}
+
+static int stream_file_header(struct sparse_stream *s)
+{
+	sparse_header_t *hdr = &s->header;
+
+	memcpy(hdr, s->hdr_buf, sizeof(sparse_header_t));
+
+	dprintf (SPEW, "=== Sparse Image Header ===\n");
+	dprintf (SPEW, "magic: 0x%x\n", hdr->magic);
+	dprintf (SPEW, "major_version: 0x%x\n", hdr->major_version);
+	dprintf (SPEW, "minor_version: 0x%x\n", hdr->minor_version);
+	dprintf (SPEW, "file_hdr_sz: %d\n", hdr->file_hdr_sz);
+	dprintf (SPEW, "chunk_hdr_sz: %d\n", hdr->chunk_hdr_sz);
+	dprintf (SPEW, "blk_sz: %d\n", hdr->blk_sz);
+	dprintf (SPEW, "total_blks: %d\n", hdr->total_blks);
+	dprintf (SPEW, "total_chunks: %d\n", hdr->total_chunks);
+
+	if (hdr->major_version != 1 ||
+	    hdr->file_hdr_sz < sizeof(sparse_header_t) ||
+	    hdr->chunk_hdr_sz < sizeof(chunk_header_t))
+		return stream_fail(s, "unsupported sparse image");
+
+	if (hdr->blk_sz == 0 || (hdr->blk_sz & (SPARSE_STREAM_BLOCK - 1)))
+		return stream_fail(s, "unsupported sparse block size");
+
+	if ((uint64_t) hdr->total_blks * hdr->blk_sz > s->size)
+		return stream_fail(s, "size too large");
+
+	s->skip = hdr->file_hdr_sz - sizeof(sparse_header_t);
+	s->chunk_index = 0;
+	s->hdr_len = 0;
+	s->state = hdr->total_chunks ? SS_CHUNK_HDR : SS_DONE;
+	return 0;
+}
+
+static int stream_chunk_header(struct sparse_stream *s)
+{
+	chunk_header_t *chunk = &s->chunk;
+	uint64_t chunk_data_sz;
+
+	memcpy(chunk, s->hdr_buf, sizeof(chunk_header_t));
+	s->skip = s->header.chunk_hdr_sz - sizeof(chunk_header_t);
+
+	chunk_data_sz = (uint64_t) s->header.blk_sz * chunk->chunk_sz;
+	if (s->offset + chunk_data_sz > s->size)
+		return stream_fail(s, "size too large");
+
+	switch (chunk->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk->total_sz != s->header.chunk_hdr_sz + chunk_data_sz)
+			return stream_fail(s, "Bogus chunk size for chunk type Raw");
+		s->remain = chunk_data_sz;
+		s->state = SS_CHUNK_DATA;
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk->total_sz != s->header.chunk_hdr_sz + sizeof(uint32_t))
+			return stream_fail(s, "Bogus chunk size for chunk type Fill");
+		s->remain = chunk_data_sz;
+		s->hdr_len = 0;
+		s->state = SS_FILL_DATA;
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		if (chunk->total_sz != s->header.chunk_hdr_sz)
+			return stream_fail(s, "Bogus chunk size for chunk type Dont Care");
+		if ((s->flags & SPARSE_STREAM_ERASE_DONT_CARE) && s->ops->erase &&
+		    chunk_data_sz) {
+			if (s->ops->erase(s->cookie, s->offset, chunk_data_sz))
+				return stream_fail(s, "flash erase failure");
+		} else
+			s->bytes_skipped += chunk_data_sz;
+		s->offset += chunk_data_sz;
+		stream_next_chunk(s);
+		break;
+
+	case CHUNK_TYPE_CRC:
+		/* the checksum itself is not verified, only skipped */
+		if (chunk->total_sz < s->header.chunk_hdr_sz)
+			return stream_fail(s, "Bogus chunk size for chunk type Crc");
+		s->offset += chunk_data_sz;
+		s->remain = chunk->total_sz - s->header.chunk_hdr_sz;
+		s->state = SS_CHUNK_DATA;
+		break;
+
+	default:
+		return stream_fail(s, "Unknown chunk type");
+	}
+	return 0;
+}
+
+void sparse_stream_init(struct sparse_stream *s,
+			const struct sparse_stream_ops *ops, void *cookie,
+			uint64_t size, unsigned flags)
+{
+	memset(s, 0, sizeof(*s));
+	s->ops = ops;
+	s->cookie = cookie;
+	s->size = size;
+	s->flags = flags;
+	s->state = SS_FILE_HDR;
+}
+
+int sparse_stream_feed(struct sparse_stream *s, const void *_data, unsigned len)
+{
+	const unsigned char *data = _data;
+	unsigned n;
+
+	while (len) {
+		if (s->state == SS_ERROR)
+			return -1;
+
+		if (s->skip) {
+			n = (s->skip < len) ? s->skip : len;
+			s->skip -= n;
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		switch (s->state) {
+		case SS_FILE_HDR:
+			n = stream_gather(s, data, len, sizeof(sparse_header_t));
+			data += n;
+			len -= n;
+
+			if (s->hdr_len >= sizeof(uint32_t) &&
+			    ((sparse_header_t *) s->hdr_buf)->magic != SPARSE_HEADER_MAGIC) {
+				/* not sparse: pass the image through untouched */
+				s->state = SS_PLAIN;
+				if (stream_emit(s, s->hdr_buf, s->hdr_len))
+					return -1;
+			} else if (s->hdr_len == sizeof(sparse_header_t)) {
+				if (stream_file_header(s))
+					return -1;
+			}
+			break;
+
+		case SS_PLAIN:
+			if (stream_emit(s, data, len))
+				return -1;
+			len = 0;
+			break;
+
+		case SS_CHUNK_HDR:
+			n = stream_gather(s, data, len, sizeof(chunk_header_t));
+			data += n;
+			len -= n;
+
+			if (s->hdr_len == sizeof(chunk_header_t) &&
+			    stream_chunk_header(s))
+				return -1;
+			break;
+
+		case SS_CHUNK_DATA:
+			n = (s->remain < len) ? s->remain : len;
+			if (s->chunk.chunk_type == CHUNK_TYPE_RAW &&
+			    stream_emit(s, data, n))
+				return -1;
+			s->remain -= n;
+			data += n;
+			len -= n;
+
+			if (s->remain == 0)
+				stream_next_chunk(s);
+			break;
+
+		case SS_FILL_DATA:
+			n = stream_gather(s, data, len, sizeof(uint32_t));
+			data += n;
+			len -= n;
+
+			if (s->hdr_len == sizeof(uint32_t)) {
+				if (s->remain && s->ops->fill(s->cookie, s->offset,
+							      s->remain,
+							      *(uint32_t *) s->hdr_buf))
+					return stream_fail(s, "flash write failure");
+				s->offset += s->remain;
+				s->bytes_written += s->remain;
+				stream_next_chunk(s);
+			}
+			break;
+
+		case SS_DONE:
+			/* trailing bytes past the last chunk are ignored */
+			len = 0;
+			break;
+		}
+	}
+
+	/* a chunk with no payload can complete without consuming input */
+	if (s->state == SS_CHUNK_DATA && s->remain == 0 && !s->skip)
+		stream_next_chunk(s);
+
+	return (s->state == SS_ERROR) ? -1 : 0;
+}
+
+int sparse_stream_finish(struct sparse_stream *s)
+{
+	switch (s->state) {
+	case SS_ERROR:
+		return -1;
+
+	case SS_FILE_HDR:
+		if (s->hdr_len == 0)
+			return stream_fail(s, "empty image");
+		if (s->hdr_len >= sizeof(uint32_t))
+			return stream_fail(s, "sparse image truncated");
+		/* too short to carry a sparse header: treat as a plain image */
+		s->state = SS_PLAIN;
+		if (stream_emit(s, s->hdr_buf, s->hdr_len))
+			return -1;
+		/* fall through */
+
+	case SS_PLAIN:
+		if (s->block_len) {
+			memset(s->block + s->block_len, 0,
+			       SPARSE_STREAM_BLOCK - s->block_len);
+			s->block_len = 0;
+			if (stream_write(s, s->block, SPARSE_STREAM_BLOCK))
+				return -1;
+		}
+		return 0;
+
+	case SS_DONE:
+		if (s->skip)
+			return stream_fail(s, "sparse image truncated");
+		if (s->offset != (uint64_t) s->header.total_blks * s->header.blk_sz)
+			return stream_fail(s, "sparse image write failure");
+		return 0;
+
+	default:
+		return stream_fail(s, "sparse image truncated");
+	}
+}
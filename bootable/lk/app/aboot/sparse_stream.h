@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __APP_SPARSE_STREAM_H
+#define __APP_SPARSE_STREAM_H
+
+#include <stdint.h>
+#include "sparse_format.h"
+
+/*
+ * Incremental sparse image parser.
+ *
+ * The image is fed in arbitrarily sized pieces as it comes off the wire;
+ * the parser keeps just enough state to resume in the middle of a header
+ * or a chunk and turns the image into block aligned write and erase calls
+ * on the backing device. Images without the sparse magic are written out
+ * as-is. Offsets passed to the ops are relative to the start of the
+ * partition, lengths are multiples of SPARSE_STREAM_BLOCK.
+ *
+ * Nothing in here depends on the target, so the parser can be driven from
+ * a host program with a file standing in for the partition.
+ */
+
+#define SPARSE_STREAM_BLOCK		512
+
+/* turn DONT_CARE chunks into erase calls instead of skipping them */
+#define SPARSE_STREAM_ERASE_DONT_CARE	0x1
+
+struct sparse_stream_ops {
+	int (*write)(void *cookie, uint64_t offset, unsigned len, void *data);
+	int (*erase)(void *cookie, uint64_t offset, uint64_t len);
+	/* repeat a 32 bit pattern over the range, for FILL chunks */
+	int (*fill)(void *cookie, uint64_t offset, uint64_t len, uint32_t pattern);
+};
+
+struct sparse_stream {
+	const struct sparse_stream_ops *ops;
+	void *cookie;
+	uint64_t size;
+	unsigned flags;
+
+	int state;
+	const char *error;
+
+	sparse_header_t header;
+	chunk_header_t chunk;
+	unsigned chunk_index;
+
+	/* header bytes collected so far, and bytes left to throw away */
+	unsigned char hdr_buf[sizeof(sparse_header_t)] __attribute__((aligned(4)));
+	unsigned hdr_len;
+	unsigned skip;
+
+	/* payload bytes left in the current chunk */
+	uint64_t remain;
+
+	/* output position and the partial block waiting to be written */
+	uint64_t offset;
+	unsigned char block[SPARSE_STREAM_BLOCK] __attribute__((aligned(4)));
+	unsigned block_len;
+
+	uint64_t bytes_written;
+	uint64_t bytes_skipped;
+};
+
+void sparse_stream_init(struct sparse_stream *s,
+			const struct sparse_stream_ops *ops, void *cookie,
+			uint64_t size, unsigned flags);
+
+/* returns 0, or -1 with s->error set; once failed every call fails */
+int sparse_stream_feed(struct sparse_stream *s, const void *data, unsigned len);
+int sparse_stream_finish(struct sparse_stream *s);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <app/tests.h>
+#include <arch/ops.h>
+#include <kernel/thread.h>
+#include <platform.h>
+#include <target.h>
+
+/*
+ * Memory throughput with the current translation table and cache setup.
+ * Working sets go from one that fits the L1 to one that only DRAM holds,
+ * so running it before and after a change to the memory attributes shows
+ * what the boot paths (memmove of kernel and ramdisk, hashing the image,
+ * copying sparse chunks) gain from it. The last column is the cost of the
+ * cache maintenance a DMA transfer of that size needs.
+ *
+ * The buffers live in the scratch region, which the fastboot download
+ * also uses; anything downloaded is lost.
+ */
+
+#define CACHE_BENCH_MAX   (8 * 1024 * 1024)
+#define CACHE_BENCH_BYTES (64 * 1024 * 1024)	/* moved per measurement */
+
+/* MB/s, taking a MB as 10^6 bytes to keep it in 32 bits */
+static uint bench_rate(size_t bytes, bigtime_t us)
+{
+	if (us == 0)
+		us = 1;
+	return (uint)(bytes / us);
+}
+
+static uint bench_move(unsigned char *buf, size_t size)
+{
+	bigtime_t t = current_time_hires();
+	size_t done;
+
+	for (done = 0; done < CACHE_BENCH_BYTES; done += size)
+		memmove(buf + size, buf, size);
+
+	return bench_rate(done, current_time_hires() - t);
+}
+
+static uint bench_set(unsigned char *buf, size_t size)
+{
+	bigtime_t t = current_time_hires();
+	size_t done;
+
+	for (done = 0; done < CACHE_BENCH_BYTES; done += size)
+		memset(buf, done, size);
+
+	return bench_rate(done, current_time_hires() - t);
+}
+
+/* a word by word sum stands in for hashing the data */
+static uint bench_read(unsigned char *buf, size_t size, uint32_t *sum)
+{
+	bigtime_t t = current_time_hires();
+	uint32_t *p, *end = (uint32_t *)(buf + size);
+	size_t done;
+
+	for (done = 0; done < CACHE_BENCH_BYTES; done += size) {
+		for (p = (uint32_t *)buf; p < end; p++)
+			*sum += *p;
+	}
+
+	return bench_rate(done, current_time_hires() - t);
+}
+
+static uint bench_clean(unsigned char *buf, size_t size)
+{
+	bigtime_t t;
+
+	memset(buf, 0x5a, size);
+	t = current_time_hires();
+	arch_clean_invalidate_cache_range((addr_t)buf, size);
+
+	return (uint)(current_time_hires() - t);
+}
+
+int cache_tests(void)
+{
+	unsigned char *buf = target_get_scratch_address();
+	uint32_t sum = 0;
+	size_t size;
+
+	printf("memory throughput, scratch at %p\n", buf);
+	printf("%8s %10s %10s %10s %10s\n", "size", "memmove", "memset",
+	       "read", "clean+inv");
+	thread_sleep(200); // let the debug string clear the serial port
+
+	for (size = 16 * 1024; size <= CACHE_BENCH_MAX; size *= 4) {
+		uint move = bench_move(buf, size);
+		uint set = bench_set(buf, size);
+		uint read = bench_read(buf, size, &sum);
+		uint clean = bench_clean(buf, size);
+
+		printf("%7uK %5u MB/s %5u MB/s %5u MB/s %7u us\n",
+		       (uint)(size / 1024), move, set, read, clean);
+	}
+
+	/* keep the read loop from being optimized away */
+	dprintf(SPEW, "sum %x\n", sum);
+
+	return 0;
+}
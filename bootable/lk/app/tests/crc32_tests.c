@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <app/tests.h>
+#include <platform.h>
+
+#if WITH_CRC32
+#include <crc32.h>
+
+/*
+ * Checks the table-driven crc32() against a bit at a time reference on
+ * every length up to CRC32_TEST_LEN from every start offset within a
+ * word pair, so the byte-wise head and tail of the sliced loop are both
+ * covered, then across an update split at every point. Finally reports
+ * the throughput of both over an unaligned buffer that fits the data
+ * cache.
+ */
+
+#define CRC32_TEST_LEN   300
+#define CRC32_BENCH_LEN  (32 * 1024)
+#define CRC32_BENCH_BYTES (4 * 1024 * 1024)	/* checksummed per measurement */
+
+static unsigned char crc32_test_buf[CRC32_BENCH_LEN + 8];
+
+static uint32_t crc32_bitwise(const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	uint32_t crc = 0xFFFFFFFF;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return crc ^ 0xFFFFFFFF;
+}
+
+/* MB/s, taking a MB as 10^6 bytes to keep it in 32 bits */
+static uint crc32_bench(uint32_t (*fn)(const void *, size_t), uint32_t *sum)
+{
+	bigtime_t t = current_time_hires();
+	size_t done;
+
+	/* feeding each result back keeps the passes from being merged */
+	for (done = 0; done < CRC32_BENCH_BYTES; done += CRC32_BENCH_LEN) {
+		*sum += fn(crc32_test_buf + 1, CRC32_BENCH_LEN);
+		crc32_test_buf[1] = *sum;
+	}
+
+	t = current_time_hires() - t;
+	if (t == 0)
+		t = 1;
+	return (uint)(done / t);
+}
+
+int crc32_tests(void)
+{
+	struct crc32_ctx ctx;
+	uint32_t seed = 1, sum = 0, want, got;
+	size_t off, len, split;
+	int errors = 0;
+
+	for (off = 0; off < sizeof(crc32_test_buf); off++) {
+		seed = seed * 1664525 + 1013904223;
+		crc32_test_buf[off] = seed >> 24;
+	}
+
+	if (crc32("123456789", 9) != 0xCBF43926) {
+		printf("crc32 check value is %08x, expected cbf43926\n",
+		       crc32("123456789", 9));
+		errors++;
+	}
+
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len <= CRC32_TEST_LEN; len++) {
+			want = crc32_bitwise(crc32_test_buf + off, len);
+			got = crc32(crc32_test_buf + off, len);
+			if (got != want) {
+				printf("crc32 offset %u len %u: %08x, expected %08x\n",
+				       (uint)off, (uint)len, got, want);
+				errors++;
+			}
+		}
+	}
+
+	want = crc32_bitwise(crc32_test_buf + 3, CRC32_TEST_LEN);
+	for (split = 0; split <= CRC32_TEST_LEN; split++) {
+		crc32_init(&ctx);
+		crc32_update(&ctx, crc32_test_buf + 3, split);
+		crc32_update(&ctx, crc32_test_buf + 3 + split, CRC32_TEST_LEN - split);
+		got = crc32_final(&ctx);
+		if (got != want) {
+			printf("crc32 split at %u: %08x, expected %08x\n",
+			       (uint)split, got, want);
+			errors++;
+		}
+	}
+
+	printf("crc32: %d mismatches\n", errors);
+	printf("crc32 throughput over %uK: table %u MB/s, bitwise %u MB/s\n",
+	       CRC32_BENCH_LEN / 1024, crc32_bench(crc32, &sum),
+	       crc32_bench(crc32_bitwise, &sum));
+
+	/* keep the benchmark loops from being optimized away */
+	dprintf(SPEW, "sum %x\n", sum);
+
+	return errors ? -1 : 0;
+}
+
+#endif
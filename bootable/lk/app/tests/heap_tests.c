@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <string.h>
+#include <app/tests.h>
+#include <arch/ops.h>
+#include <lib/heap.h>
+#include <lib/slab.h>
+
+/*
+ * Allocator stress benchmark. The same random mix of mostly small, some
+ * medium and a few large allocations, freed in random order, is run
+ * against the plain heap and against the slab front end. It reports the
+ * average and worst cost of an allocation and of a free, then, with the
+ * surviving objects still live, the largest block the heap can still
+ * hand out as a measure of fragmentation.
+ */
+
+#define HEAP_BENCH_SLOTS 256
+#define HEAP_BENCH_OPS   20000
+
+struct heap_bench_ops {
+	const char *name;
+	void *(*alloc)(size_t, unsigned int);
+	void (*free)(void *);
+};
+
+static void *heap_bench_slots[HEAP_BENCH_SLOTS];
+static uint32_t heap_bench_seed;
+
+/* private generator, so both runs see the same sequence */
+static uint32_t heap_bench_rand(void)
+{
+	heap_bench_seed = heap_bench_seed * 1664525 + 1013904223;
+	return heap_bench_seed >> 8;
+}
+
+static size_t heap_bench_size(void)
+{
+	uint32_t r = heap_bench_rand() % 100;
+
+	if (r < 80)
+		return 8 + heap_bench_rand() % 249;	/* struct sized */
+	if (r < 98)
+		return 257 + heap_bench_rand() % 3840;	/* buffers */
+	return 16384 + heap_bench_rand() % 49152;	/* large */
+}
+
+static size_t heap_bench_largest(void)
+{
+	size_t lo = 0, hi = 16 * 1024 * 1024, mid;
+	void *p;
+
+	while (hi - lo > 1024) {
+		mid = (lo + hi) / 2;
+		p = heap_alloc(mid, 0);
+		if (p) {
+			heap_free(p);
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static void heap_bench_run(const struct heap_bench_ops *ops)
+{
+	uint32_t t, dt;
+	uint32_t alloc_total = 0, alloc_worst = 0, allocs = 0, failed = 0;
+	uint32_t free_total = 0, free_worst = 0, frees = 0;
+	int i, op;
+
+	heap_bench_seed = 12345;
+	memset(heap_bench_slots, 0, sizeof(heap_bench_slots));
+
+	for (op = 0; op < HEAP_BENCH_OPS; op++) {
+		i = heap_bench_rand() % HEAP_BENCH_SLOTS;
+
+		if (heap_bench_slots[i]) {
+			t = arch_cycle_count();
+			ops->free(heap_bench_slots[i]);
+			dt = arch_cycle_count() - t;
+			heap_bench_slots[i] = NULL;
+
+			free_total += dt;
+			if (dt > free_worst)
+				free_worst = dt;
+			frees++;
+		} else {
+			size_t size = heap_bench_size();
+
+			t = arch_cycle_count();
+			heap_bench_slots[i] = ops->alloc(size, 0);
+			dt = arch_cycle_count() - t;
+
+			if (!heap_bench_slots[i]) {
+				failed++;
+				continue;
+			}
+			alloc_total += dt;
+			if (dt > alloc_worst)
+				alloc_worst = dt;
+			allocs++;
+		}
+	}
+
+	printf("%s: alloc avg %u worst %u cycles, free avg %u worst %u cycles, %u failed\n",
+	       ops->name, allocs ? alloc_total / allocs : 0, alloc_worst,
+	       frees ? free_total / frees : 0, free_worst, failed);
+	printf("%s: largest free block with survivors live: %u KB\n",
+	       ops->name, (uint)(heap_bench_largest() / 1024));
+
+	for (i = 0; i < HEAP_BENCH_SLOTS; i++)
+		ops->free(heap_bench_slots[i]);
+}
+
+static void heap_bench_heap_free(void *ptr)
+{
+	if (ptr)
+		heap_free(ptr);
+}
+
+static const struct heap_bench_ops heap_bench_allocators[] = {
+	{ "heap", heap_alloc, heap_bench_heap_free },
+	{ "slab", slab_alloc, slab_free },
+};
+
+int heap_tests(void)
+{
+	uint i;
+
+	printf("allocator benchmark, %d ops over %d slots\n",
+	       HEAP_BENCH_OPS, HEAP_BENCH_SLOTS);
+	printf("largest free block before: %u KB\n",
+	       (uint)(heap_bench_largest() / 1024));
+
+	for (i = 0; i < countof(heap_bench_allocators); i++)
+		heap_bench_run(&heap_bench_allocators[i]);
+
+	slab_dump();
+
+	return 0;
+}
@@ -25,6 +25,10 @@
 
 int thread_tests(void);
 void printf_tests(void);
+int timer_tests(void);
+int cache_tests(void);
+int heap_tests(void);
+int crc32_tests(void);
 
 #endif
 
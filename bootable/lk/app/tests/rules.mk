@@ -5,4 +5,8 @@ INCLUDES += -I$(LOCAL_DIR)/include
 OBJS += \
 	$(LOCAL_DIR)/tests.o \
 	$(LOCAL_DIR)/thread_tests.o \
-	$(LOCAL_DIR)/printf_tests.o
+	$(LOCAL_DIR)/printf_tests.o \
+	$(LOCAL_DIR)/timer_tests.o \
+	$(LOCAL_DIR)/cache_tests.o \
+	$(LOCAL_DIR)/heap_tests.o \
+	$(LOCAL_DIR)/crc32_tests.o
@@ -31,6 +31,12 @@
 STATIC_COMMAND_START
 STATIC_COMMAND("printf_tests", NULL, (console_cmd)&printf_tests)
 STATIC_COMMAND("thread_tests", NULL, (console_cmd)&thread_tests)
+STATIC_COMMAND("timer_tests", NULL, (console_cmd)&timer_tests)
+STATIC_COMMAND("cache_tests", NULL, (console_cmd)&cache_tests)
+STATIC_COMMAND("heap_tests", NULL, (console_cmd)&heap_tests)
+#if WITH_CRC32
+STATIC_COMMAND("crc32_tests", NULL, (console_cmd)&crc32_tests)
+#endif
 STATIC_COMMAND_END(tests);
 
 #endif
@@ -26,6 +26,7 @@
 #include <kernel/thread.h>
 #include <kernel/mutex.h>
 #include <kernel/event.h>
+#include <platform.h>
 
 static int sleep_thread(void *arg)
 {
@@ -267,6 +268,101 @@ void context_switch_test(void)
 	thread_sleep(100);
 }
 
+/*
+ * Time slicing benchmark: CPU-bound threads at LOW_PRIORITY spin while a
+ * HIGH_PRIORITY thread measures how late its 2ms sleeps wake up. Each
+ * configuration runs with periodic ticks and in tickless mode; with a
+ * single spinner the tickless run should take no scheduler ticks at all,
+ * with two it should still slice between them.
+ */
+#define SLICE_BENCH_WAKEUPS 100
+
+static volatile bool slice_stop;
+static volatile uint slice_work[2];
+static event_t slice_done_event;
+static bigtime_t slice_latency_total, slice_latency_worst;
+
+static int slice_spinner(void *arg)
+{
+	volatile uint *work = &slice_work[(int)arg];
+
+	while (!slice_stop)
+		(*work)++;
+
+	return 0;
+}
+
+static int slice_waker(void *arg)
+{
+	bigtime_t t, late;
+	int i;
+
+	slice_latency_total = slice_latency_worst = 0;
+	for (i = 0; i < SLICE_BENCH_WAKEUPS; i++) {
+		t = current_time_hires();
+		thread_sleep(2);
+		t = current_time_hires() - t;
+		late = t > 2000 ? t - 2000 : 0;
+		slice_latency_total += late;
+		if (late > slice_latency_worst)
+			slice_latency_worst = late;
+	}
+
+	event_signal(&slice_done_event, true);
+	return 0;
+}
+
+static void slice_bench_run(bool tickless, int spinners)
+{
+	int i;
+#if THREAD_STATS
+	struct thread_stats old_stats = thread_stats;
+#endif
+
+	if (thread_set_tickless(tickless) < 0) {
+		printf("%s: not supported\n", tickless ? "tickless" : "periodic");
+		return;
+	}
+
+	slice_stop = false;
+	slice_work[0] = slice_work[1] = 0;
+	event_init(&slice_done_event, false, 0);
+
+	for (i = 0; i < spinners; i++)
+		thread_resume(thread_create("slice spinner", &slice_spinner, (void *)i, LOW_PRIORITY, DEFAULT_STACK_SIZE));
+	thread_resume(thread_create("slice waker", &slice_waker, NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE));
+
+	event_wait(&slice_done_event);
+	slice_stop = true;
+	thread_sleep(100);
+	event_destroy(&slice_done_event);
+
+	printf("%s, %d spinner(s): work %u/%u, wakeup late avg %u us, worst %u us\n",
+	       tickless ? "tickless" : "periodic", spinners,
+	       slice_work[0], slice_work[1],
+	       (uint)(slice_latency_total / SLICE_BENCH_WAKEUPS),
+	       (uint)slice_latency_worst);
+#if THREAD_STATS
+	printf("\tcs %d, timer ints %d, slice expiries %d, ticks avoided %d\n",
+	       thread_stats.context_switches - old_stats.context_switches,
+	       thread_stats.timer_ints - old_stats.timer_ints,
+	       thread_stats.slice_expiries - old_stats.slice_expiries,
+	       thread_stats.ticks_avoided - old_stats.ticks_avoided);
+#endif
+}
+
+static void slice_test(void)
+{
+	int spinners;
+
+	for (spinners = 1; spinners <= 2; spinners++) {
+		slice_bench_run(false, spinners);
+		slice_bench_run(true, spinners);
+	}
+
+	thread_set_tickless(true);
+}
+
 static volatile int atomic;
 static volatile int atomic_count;
 
@@ -316,6 +412,9 @@ int thread_tests(void)
 	thread_sleep(200);
 	context_switch_test();
 
+	thread_sleep(200);
+	slice_test();
+
 	atomic_test();
 	
 	return 0;
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <rand.h>
+#include <app/tests.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <platform.h>
+
+/*
+ * Microbenchmark for the kernel timer queue. For a number of active
+ * timers it reports the average and worst cost of arming and cancelling
+ * a timer, and of firing a burst of timers that all expire on the same
+ * tick. Both run with interrupts disabled for almost all of their
+ * duration, so the worst figures are a good measure of the interrupt
+ * latency the timer queue adds.
+ */
+
+#define TIMER_BENCH_MAX 256
+
+static timer_t bench_timers[TIMER_BENCH_MAX];
+static int bench_order[TIMER_BENCH_MAX];
+static volatile int bench_fired;
+static bigtime_t bench_first, bench_last;
+
+static enum handler_return bench_callback(timer_t *timer, time_t now, void *arg)
+{
+	bigtime_t t = current_time_hires();
+
+	if (bench_fired++ == 0)
+		bench_first = t;
+	bench_last = t;
+
+	return INT_NO_RESCHEDULE;
+}
+
+static void bench_shuffle(int count)
+{
+	int i, j, tmp;
+
+	for (i = 0; i < count; i++)
+		bench_order[i] = i;
+
+	for (i = count - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = bench_order[i];
+		bench_order[i] = bench_order[j];
+		bench_order[j] = tmp;
+	}
+}
+
+static void timer_bench_run(int count)
+{
+	bigtime_t t, dt, total, worst;
+	int i;
+
+	/* arm: random far-off deadlines so nothing fires during the run */
+	total = worst = 0;
+	for (i = 0; i < count; i++) {
+		timer_initialize(&bench_timers[i]);
+		t = current_time_hires();
+		timer_set_oneshot(&bench_timers[i], 60000 + rand() % 60000,
+				  bench_callback, NULL);
+		dt = current_time_hires() - t;
+		total += dt;
+		if (dt > worst)
+			worst = dt;
+	}
+	printf("%4d timers: insert avg %u ns, worst %u us\n", count,
+	       (uint)(total * 1000 / count), (uint)worst);
+
+	/* cancel in a different order than they were armed */
+	bench_shuffle(count);
+	total = worst = 0;
+	for (i = 0; i < count; i++) {
+		t = current_time_hires();
+		timer_cancel(&bench_timers[bench_order[i]]);
+		dt = current_time_hires() - t;
+		total += dt;
+		if (dt > worst)
+			worst = dt;
+	}
+	printf("%4d timers: cancel avg %u ns, worst %u us\n", count,
+	       (uint)(total * 1000 / count), (uint)worst);
+
+	/* fire: everything due on the same tick */
+	bench_fired = 0;
+	for (i = 0; i < count; i++)
+		timer_set_oneshot(&bench_timers[i], 50, bench_callback, NULL);
+
+	thread_sleep(200);
+
+	if (bench_fired != count) {
+		printf("%4d timers: only %d fired\n", count, bench_fired);
+		for (i = 0; i < count; i++)
+			timer_cancel(&bench_timers[i]);
+		return;
+	}
+	printf("%4d timers: fire avg %u ns, burst %u us\n", count,
+	       (uint)((bench_last - bench_first) * 1000 / count),
+	       (uint)(bench_last - bench_first));
+}
+
+int timer_tests(void)
+{
+	int count;
+
+	printf("timer queue benchmark\n");
+
+	for (count = 16; count <= TIMER_BENCH_MAX; count *= 4)
+		timer_bench_run(count);
+
+	return 0;
+}
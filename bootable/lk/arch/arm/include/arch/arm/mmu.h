@@ -57,6 +57,7 @@ uint32_t arm_mmu_virt2phy(uint32_t virt_addr);
 #endif
 
 void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags);
+void arm_mmu_map_region(addr_t paddr, addr_t vaddr, size_t size, uint flags);
 
 
 #if defined(__cplusplus)
@@ -21,6 +21,7 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <debug.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <compiler.h>
 #include <arch.h>
@@ -42,7 +43,9 @@ static uint32_t *tt = (void *)MMU_TRANSLATION_TABLE_ADDR;
 static uint32_t tt[4096] __ALIGNED(16384);
 #endif
 
-void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags)
+#define SUPERSECTION_SIZE (16*MB)
+
+static void arm_mmu_set_section(addr_t paddr, addr_t vaddr, uint flags)
 {
 	int index;
 
@@ -55,13 +58,68 @@ void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags)
 	 *  flags: TEX, CB and AP bit settings provided by the caller.
 	 */
 	tt[index] = (paddr & ~(MB-1)) | (0<<5) | (2<<0) | flags;
+}
+
+#if ARM_ISA_ARMv7
+/* A supersection is 16 identical consecutive entries with bit 18 set,
+ * covering 16MB with a single TLB entry. Its domain is always 0.
+ */
+static void arm_mmu_set_supersection(addr_t paddr, addr_t vaddr, uint flags)
+{
+	int index = vaddr / MB;
+	uint32_t entry;
+	int i;
+
+	entry = (paddr & ~(SUPERSECTION_SIZE-1)) | (1<<18) | (2<<0) | flags;
+
+	for (i = 0; i < 16; i++)
+		tt[index + i] = entry;
+}
+#endif
+
+void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags)
+{
+	arm_mmu_set_section(paddr, vaddr, flags);
+
+	arm_invalidate_tlb();
+}
+
+/* Maps 'size' bytes, rounded up to whole sections, with the same attributes.
+ * Stretches where both addresses are 16MB aligned use supersections. The TLB
+ * is invalidated once, after the whole region is in the table.
+ */
+void arm_mmu_map_region(addr_t paddr, addr_t vaddr, size_t size, uint flags)
+{
+	size = ROUNDUP(size, MB);
+
+	while (size) {
+#if ARM_ISA_ARMv7
+		if (size >= SUPERSECTION_SIZE &&
+		    !((paddr | vaddr) & (SUPERSECTION_SIZE-1))) {
+			arm_mmu_set_supersection(paddr, vaddr, flags);
+			paddr += SUPERSECTION_SIZE;
+			vaddr += SUPERSECTION_SIZE;
+			size -= SUPERSECTION_SIZE;
+			continue;
+		}
+#endif
+		arm_mmu_set_section(paddr, vaddr, flags);
+		paddr += MB;
+		vaddr += MB;
+		size -= MB;
+	}
 
 	arm_invalidate_tlb();
 }
 
 uint32_t arm_mmu_virt2phy(uint32_t virt_addr)
 {
-	return (tt[virt_addr >> 20] & 0xfff00000) + (virt_addr & 0xfffff);
+	uint32_t entry = tt[virt_addr >> 20];
+
+	if (entry & (1<<18))
+		return (entry & 0xff000000) + (virt_addr & 0xffffff);
+
+	return (entry & 0xfff00000) + (virt_addr & 0xfffff);
 }
 
 void arm_mmu_init(void)
@@ -77,12 +135,14 @@ void arm_mmu_init(void)
 	 * strongly ordered memory type and read/write access.
 	 */
 	for (i=0; i < 4096; i++) {
-		arm_mmu_map_section(i * MB,
+		arm_mmu_set_section(i * MB,
 				    i * MB,
 				    MMU_MEMORY_TYPE_STRONGLY_ORDERED |
 				    MMU_MEMORY_AP_READ_WRITE);
 	}
 
+	arm_invalidate_tlb();
+
 	/* set up the translation table base */
 	arm_write_ttbr((uint32_t)tt);
 
@@ -30,9 +30,31 @@ void dpc_init(void);
 
 typedef void (*dpc_callback)(void *arg);
 
+struct dpc {
+	struct list_node node;
+
+	dpc_callback cb;
+	void *arg;
+	bigtime_t queued;
+	bool pooled;		/* taken from the pool, goes back after it ran */
+};
+
 #define DPC_FLAG_NORESCHED 0x1
+#define DPC_FLAG_LOW       0x2	/* run on the low priority worker */
+
+/* deferred calls from the pool that can be pending at once, over all levels */
+#define DPC_POOL_SIZE 32
 
+/* returns ERR_NO_MEMORY if the pool is exhausted */
 status_t dpc_queue(dpc_callback, void *arg, uint flags);
 
+/* queues an entry owned by the caller, which cannot fail; the entry must
+ * not be queued again before its callback has started, and the callback
+ * may free it
+ */
+void dpc_queue_entry(struct dpc *dpc, dpc_callback, void *arg, uint flags);
+
+void dump_dpc_stats(void);
+
 #endif
 
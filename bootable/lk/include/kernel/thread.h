@@ -28,6 +28,7 @@
 #include <compiler.h>
 #include <arch/ops.h>
 #include <arch/thread.h>
+#include <kernel/dpc.h>
 
 enum thread_state {
 	THREAD_SUSPENDED = 0,
@@ -76,6 +77,9 @@ typedef struct thread {
 	/* return code */
 	int retcode;
 
+	/* queued by thread_exit() to free the thread */
+	struct dpc cleanup_dpc;
+
 	/* thread local storage */
 	uint32_t tls[MAX_TLS_ENTRY];
 
@@ -95,12 +99,18 @@ typedef struct thread {
 /* stack size */
 #define DEFAULT_STACK_SIZE 8192
 
+/* scheduler tick and default time slice, in ms */
+#define THREAD_TICK_MS 10
+#define THREAD_QUANTUM 50
+
 /* functions */
 void thread_init_early(void);
 void thread_init(void);
 void thread_become_idle(void) __NO_RETURN;
 void thread_set_name(const char *name);
 void thread_set_priority(int priority);
+void thread_set_quantum(int priority, time_t quantum);
+status_t thread_set_tickless(bool enable);
 thread_t *thread_create(const char *name, thread_start_routine entry, void *arg, int priority, size_t stack_size);
 status_t thread_resume(thread_t *);
 void thread_exit(int retcode) __NO_RETURN;
@@ -221,6 +231,8 @@ struct thread_stats {
 	int interrupts; /* platform code increment this */
 	int timer_ints; /* timer code increment this */
 	int timers; /* timer code increment this */
+	int slice_expiries;
+	int ticks_avoided; /* scheduler ticks not taken in tickless mode */
 };
 
 extern struct thread_stats thread_stats;
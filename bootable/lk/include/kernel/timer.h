@@ -35,7 +35,11 @@ typedef enum handler_return (*timer_callback)(struct timer *, time_t now, void *
 
 typedef struct timer {
 	int magic;
-	struct list_node node;
+
+	/* links in the pending timer heap, see kernel/timer.c */
+	struct timer *parent;
+	struct timer *left;
+	struct timer *right;
 
 	time_t scheduled_time;
 	time_t periodic_time;
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __LIB_SLAB_H
+#define __LIB_SLAB_H
+
+#include <sys/types.h>
+
+/*
+ * Size-class front end for the heap.
+ *
+ * Requests of up to SLAB_MAX_SIZE bytes with no more than SLAB_ALIGN
+ * alignment are served from per-class slabs, pages carved out of one
+ * arena that slab_init() takes from the heap. Everything else, and small
+ * requests once the arena is full, goes straight to heap_alloc(). These
+ * are drop-in replacements for heap_alloc()/heap_realloc()/heap_free().
+ * kmain() calls slab_init() right after heap_init(); malloc() does not go
+ * through the slabs, the small objects the kernel churns through (thread_t,
+ * udc_request) are allocated here explicitly.
+ */
+#define SLAB_PAGE_SIZE   4096
+#define SLAB_ARENA_SIZE  (64 * 1024)
+#define SLAB_MIN_SIZE    16
+#define SLAB_MAX_SIZE    512
+#define SLAB_ALIGN       16
+
+void *slab_alloc(size_t size, unsigned int alignment);
+void *slab_realloc(void *ptr, size_t size);
+void slab_free(void *ptr);
+
+void slab_init(void);
+void slab_dump(void);
+
+#endif
+
@@ -266,4 +266,17 @@ static inline bool list_is_empty(struct list_node *list)
 	return (list->next == list) ? true : false;
 }
 
+/* moves every entry of other to the tail of list, leaving other empty */
+static inline void list_splice_tail(struct list_node *list, struct list_node *other)
+{
+	if (list_is_empty(other))
+		return;
+
+	other->next->prev = list->prev;
+	other->prev->next = list;
+	list->prev->next = other->next;
+	list->prev = other->prev;
+	list_initialize(other);
+}
+
 #endif
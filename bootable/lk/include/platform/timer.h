@@ -26,6 +26,8 @@
 typedef enum handler_return (*platform_timer_callback)(void *arg, time_t now);
 
 status_t platform_set_periodic_timer(platform_timer_callback callback, void *arg, time_t interval);
+status_t platform_set_oneshot_timer(platform_timer_callback callback, void *arg, time_t interval);
+void platform_stop_timer(void);
 
 void mdelay(unsigned msecs);
 void udelay(unsigned usecs);
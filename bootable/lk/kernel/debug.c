@@ -34,6 +34,7 @@
 #include <debug.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/dpc.h>
 #include <platform.h>
 
 #if WITH_LIB_CONSOLE
@@ -42,6 +43,7 @@
 static int cmd_threads(int argc, const cmd_args *argv);
 static int cmd_threadstats(int argc, const cmd_args *argv);
 static int cmd_threadload(int argc, const cmd_args *argv);
+static int cmd_dpcstats(int argc, const cmd_args *argv);
 
 STATIC_COMMAND_START
 #if DEBUGLEVEL > 1
@@ -51,6 +53,7 @@ STATIC_COMMAND("threads", "list kernel threads", &cmd_threads)
 STATIC_COMMAND("threadstats", "thread level statistics", &cmd_threadstats)
 STATIC_COMMAND("threadload", "toggle thread load display", &cmd_threadload)
 #endif
+STATIC_COMMAND("dpcstats", "dpc queue statistics", &cmd_dpcstats)
 STATIC_COMMAND_END(kernel);
 
 #if DEBUGLEVEL > 1
@@ -76,6 +79,8 @@ static int cmd_threadstats(int argc, const cmd_args *argv)
 	printf("\tinterrupts: %d\n", thread_stats.interrupts);
 	printf("\ttimer interrupts: %d\n", thread_stats.timer_ints);
 	printf("\ttimers: %d\n", thread_stats.timers);
+	printf("\tslice expiries: %d\n", thread_stats.slice_expiries);
+	printf("\tticks avoided: %d\n", thread_stats.ticks_avoided);
 
 	return 0;
 }
@@ -130,5 +135,13 @@ static int cmd_threadload(int argc, const cmd_args *argv)
 
 #endif
 
+static int cmd_dpcstats(int argc, const cmd_args *argv)
+{
+	printf("dpc stats:\n");
+	dump_dpc_stats();
+
+	return 0;
+}
+
 #endif
 
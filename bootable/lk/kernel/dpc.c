@@ -22,67 +22,180 @@
  */
 #include <debug.h>
 #include <list.h>
-#include <malloc.h>
 #include <err.h>
 #include <kernel/dpc.h>
 #include <kernel/thread.h>
 #include <kernel/event.h>
+#include <platform.h>
 
-struct dpc {
-	struct list_node node;	
+/*
+ * Deferred procedure calls.
+ *
+ * There are two levels, each with its own queue and worker thread: the
+ * "dpc" worker at DPC_PRIORITY, and "dpc low" at LOW_PRIORITY for work
+ * queued with DPC_FLAG_LOW. Entries come from a fixed pool so dpc_queue()
+ * never allocates and is safe close to interrupt context. A worker takes
+ * its whole pending list in one critical section, runs it, and gives the
+ * pooled entries back in one more.
+ */
 
-	dpc_callback cb;
-	void *arg;
+enum {
+	DPC_LEVEL_NORMAL,
+	DPC_LEVEL_LOW,
+	DPC_LEVELS
 };
 
-static struct list_node dpc_list = LIST_INITIAL_VALUE(dpc_list);
-static event_t dpc_event;
+struct dpc_queue {
+	const char *name;
+	int priority;
+	struct list_node list;
+	event_t event;
+
+	/* statistics */
+	uint depth;
+	uint max_depth;
+	uint enqueued;
+	uint ran;
+	uint batches;
+	bigtime_t latency_total;
+	bigtime_t latency_max;
+};
+
+static struct dpc_queue dpc_q[DPC_LEVELS] = {
+	[DPC_LEVEL_NORMAL] = { .name = "dpc", .priority = DPC_PRIORITY },
+	[DPC_LEVEL_LOW] = { .name = "dpc low", .priority = LOW_PRIORITY },
+};
+
+static struct dpc dpc_pool[DPC_POOL_SIZE];
+static struct list_node dpc_free_list = LIST_INITIAL_VALUE(dpc_free_list);
+static uint dpc_overflows;
 
 static int dpc_thread_routine(void *arg);
 
 void dpc_init(void)
 {
-	event_init(&dpc_event, false, 0);
+	struct dpc_queue *q;
+	int i;
+
+	for (i = 0; i < DPC_POOL_SIZE; i++) {
+		dpc_pool[i].pooled = true;
+		list_add_tail(&dpc_free_list, &dpc_pool[i].node);
+	}
+
+	for (i = 0; i < DPC_LEVELS; i++) {
+		q = &dpc_q[i];
+		list_initialize(&q->list);
+		event_init(&q->event, false, 0);
+		thread_resume(thread_create(q->name, &dpc_thread_routine, q, q->priority, DEFAULT_STACK_SIZE));
+	}
+}
+
+/* called in a critical section */
+static void dpc_enqueue(struct dpc *dpc, dpc_callback cb, void *arg, uint flags)
+{
+	struct dpc_queue *q = &dpc_q[(flags & DPC_FLAG_LOW) ? DPC_LEVEL_LOW : DPC_LEVEL_NORMAL];
 
-	thread_resume(thread_create("dpc", &dpc_thread_routine, NULL, DPC_PRIORITY, DEFAULT_STACK_SIZE));
+	dpc->cb = cb;
+	dpc->arg = arg;
+	dpc->queued = current_time_hires();
+	list_add_tail(&q->list, &dpc->node);
+
+	q->enqueued++;
+	if (++q->depth > q->max_depth)
+		q->max_depth = q->depth;
+
+	/* the worker only needs waking for the first entry of a batch */
+	if (q->depth == 1)
+		event_signal(&q->event, (flags & DPC_FLAG_NORESCHED) ? false : true);
 }
 
 status_t dpc_queue(dpc_callback cb, void *arg, uint flags)
 {
 	struct dpc *dpc;
 
-	dpc = malloc(sizeof(struct dpc));
-
-	dpc->cb = cb;
-	dpc->arg = arg;
 	enter_critical_section();
-	list_add_tail(&dpc_list, &dpc->node);
-	event_signal(&dpc_event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+
+	dpc = list_remove_head_type(&dpc_free_list, struct dpc, node);
+	if (!dpc) {
+		dpc_overflows++;
+		exit_critical_section();
+		return ERR_NO_MEMORY;
+	}
+	dpc_enqueue(dpc, cb, arg, flags);
+
 	exit_critical_section();
 
 	return NO_ERROR;
 }
 
+void dpc_queue_entry(struct dpc *dpc, dpc_callback cb, void *arg, uint flags)
+{
+	enter_critical_section();
+	dpc->pooled = false;
+	dpc_enqueue(dpc, cb, arg, flags);
+	exit_critical_section();
+}
+
 static int dpc_thread_routine(void *arg)
 {
+	struct dpc_queue *q = arg;
+	struct list_node batch = LIST_INITIAL_VALUE(batch);
+	struct list_node done = LIST_INITIAL_VALUE(done);
+	struct dpc *dpc;
+	dpc_callback cb;
+	bigtime_t latency;
+
 	for (;;) {
-		event_wait(&dpc_event);
+		event_wait(&q->event);
 
 		enter_critical_section();
-		struct dpc *dpc = list_remove_head_type(&dpc_list, struct dpc, node);
-		if (!dpc)
-			event_unsignal(&dpc_event);
+		list_splice_tail(&batch, &q->list);
+		q->depth = 0;
+		q->batches++;
+		event_unsignal(&q->event);
 		exit_critical_section();
 
-		if (dpc) {
-//			dprintf("dpc calling %p, arg %p\n", dpc->cb, dpc->arg);
-			dpc->cb(dpc->arg);
-
-			free(dpc);
+		while ((dpc = list_remove_head_type(&batch, struct dpc, node))) {
+			latency = current_time_hires() - dpc->queued;
+			q->ran++;
+			q->latency_total += latency;
+			if (latency > q->latency_max)
+				q->latency_max = latency;
+
+			/* an entry the caller owns may be gone once its callback ran */
+			cb = dpc->cb;
+			arg = dpc->arg;
+			if (dpc->pooled)
+				list_add_tail(&done, &dpc->node);
+
+//			dprintf("dpc calling %p, arg %p\n", cb, arg);
+			cb(arg);
 		}
+
+		enter_critical_section();
+		list_splice_tail(&dpc_free_list, &done);
+		exit_critical_section();
 	}
 
 	return 0;
 }
 
-
+/**
+ * @brief  Dump the dpc counters.
+ */
+void dump_dpc_stats(void)
+{
+	struct dpc_queue *q;
+	int i;
+
+	for (i = 0; i < DPC_LEVELS; i++) {
+		q = &dpc_q[i];
+		printf("%s (priority %d):\n", q->name, q->priority);
+		printf("\tenqueued: %u, ran %u\n", q->enqueued, q->ran);
+		printf("\tbatches: %u\n", q->batches);
+		printf("\tdepth: %u, max %u\n", q->depth, q->max_depth);
+		printf("\tlatency: avg %llu us, max %llu us\n",
+		       q->ran ? q->latency_total / q->ran : 0, q->latency_max);
+	}
+	printf("pool: %d entries, %u overflows\n", DPC_POOL_SIZE, dpc_overflows);
+}
@@ -30,6 +30,7 @@
 #include <platform.h>
 #include <target.h>
 #include <lib/heap.h>
+#include <lib/slab.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <kernel/dpc.h>
@@ -86,6 +87,7 @@ void kmain(void)
 	// 内核堆链表上下文初始化等 
 	dprintf(SPEW, "initializing heap\n");
 	heap_init();
+	slab_init();
 
 	// 线程池初始化,前提是PLATFORM_HAS_DYNAMIC_TIMER需要支持  
 	dprintf(SPEW, "initializing threads\n");
@@ -3,7 +3,8 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULES += \
 	lib/libc \
 	lib/debug \
-	lib/heap
+	lib/heap \
+	lib/slab
 
 OBJS += \
 	$(LOCAL_DIR)/debug.o \
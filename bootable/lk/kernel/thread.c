@@ -35,6 +35,7 @@
 #include <malloc.h>
 #include <string.h>
 #include <err.h>
+#include <lib/slab.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <kernel/dpc.h>
@@ -71,10 +72,44 @@ thread_t *idle_thread;
 static void thread_resched(void);
 static void idle_thread_routine(void) __NO_RETURN;
 
+/* time slice given to threads of each priority, in ms */
+static time_t thread_quantum[NUM_PRIORITIES];
+
 #if PLATFORM_HAS_DYNAMIC_TIMER
 /* preemption timer */
 static timer_t preempt_timer;
+
+/* In tickless mode the preemption timer is a one-shot that covers the
+ * rest of the running thread's quantum, and it is only armed while
+ * another thread of the same priority is ready to take over. A thread
+ * alone at its priority runs without timer interrupts and is not charged
+ * for that time.
+ */
+static bool tickless = true;
+static bool quantum_armed;
+static time_t quantum_start;
+
+static void quantum_arm(thread_t *t);
+static void quantum_preempt(thread_t *t);
+#endif
+
+/* called when t becomes ready, to start slicing the running thread, or
+ * to cut it short if t outranks it
+ */
+static inline void check_quantum(thread_t *t)
+{
+#if PLATFORM_HAS_DYNAMIC_TIMER
+	if (!tickless || t == current_thread ||
+	    current_thread == idle_thread ||
+	    current_thread->state != THREAD_RUNNING)
+		return;
+
+	if (t->priority > current_thread->priority)
+		quantum_preempt(current_thread);
+	else if (!quantum_armed && t->priority == current_thread->priority)
+		quantum_arm(current_thread);
 #endif
+}
 
 /* run queue manipulation */
 static void insert_in_run_queue_head(thread_t *t)
@@ -88,6 +123,7 @@ static void insert_in_run_queue_head(thread_t *t)
 
 	list_add_head(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+	check_quantum(t);
 }
 
 static void insert_in_run_queue_tail(thread_t *t)
@@ -101,6 +137,7 @@ static void insert_in_run_queue_tail(thread_t *t)
 
 	list_add_tail(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+	check_quantum(t);
 }
 
 static void init_thread_struct(thread_t *t, const char *name)
@@ -141,7 +178,7 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 {
 	thread_t *t;
 
-	t = malloc(sizeof(thread_t));
+	t = slab_alloc(sizeof(thread_t), 0);
 	if (!t)
 		return NULL;
 
@@ -158,7 +195,7 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 	/* create the stack */
 	t->stack = malloc(stack_size);
 	if (!t->stack) {
-		free(t);
+		slab_free(t);
 		return NULL;
 	}
 
@@ -230,7 +267,7 @@ static void thread_cleanup_dpc(void *thread)
 	if (t->stack)
 		free(t->stack);
 
-	free(t);
+	slab_free(t);
 }
 
 /**
@@ -255,8 +292,9 @@ void thread_exit(int retcode)
 	current_thread->state = THREAD_DEATH;
 	current_thread->retcode = retcode;
 
-	/* schedule a dpc to clean ourselves up */
-	dpc_queue(thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED);
+	/* schedule a dpc to clean ourselves up; the entry lives in the thread
+	 * itself so this cannot run out */
+	dpc_queue_entry(&current_thread->cleanup_dpc, thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED);
 
 	/* reschedule */
 	thread_resched();
@@ -270,6 +308,96 @@ static void idle_thread_routine(void)
 		arch_idle();
 }
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+static enum handler_return thread_quantum_expired(timer_t *timer, time_t now, void *arg)
+{
+	quantum_armed = false;
+	quantum_start = now;
+
+	if (current_thread == idle_thread)
+		return INT_NO_RESCHEDULE;
+
+#if THREAD_STATS
+	thread_stats.slice_expiries++;
+#endif
+	current_thread->remaining_quantum = 0;
+	return INT_RESCHEDULE;
+}
+
+/* start the running thread's slice; the time it ran alone is free */
+static void quantum_arm(thread_t *t)
+{
+	time_t now = current_time();
+
+#if THREAD_STATS
+	thread_stats.ticks_avoided += (now - quantum_start) / THREAD_TICK_MS;
+#endif
+
+	if (t->remaining_quantum <= 0)
+		t->remaining_quantum = thread_quantum[t->priority];
+
+	quantum_start = now;
+	quantum_armed = true;
+	timer_set_oneshot(&preempt_timer, t->remaining_quantum,
+			  thread_quantum_expired, NULL);
+}
+
+static enum handler_return thread_preempt_expired(timer_t *timer, time_t now, void *arg)
+{
+	if (current_thread == idle_thread) {
+		quantum_armed = false;
+		quantum_start = now;
+		return INT_NO_RESCHEDULE;
+	}
+
+	/* the slice stays armed, so the switch charges it for its time */
+	return INT_RESCHEDULE;
+}
+
+/*
+ * A higher priority thread became ready while t was running, possibly
+ * without a slice timer: fire the timer right away so t is preempted.
+ * It keeps what is left of its quantum.
+ */
+static void quantum_preempt(thread_t *t)
+{
+	if (quantum_armed) {
+		timer_cancel(&preempt_timer);
+	} else {
+		time_t now = current_time();
+
+#if THREAD_STATS
+		thread_stats.ticks_avoided += (now - quantum_start) / THREAD_TICK_MS;
+#endif
+		if (t->remaining_quantum <= 0)
+			t->remaining_quantum = thread_quantum[t->priority];
+		quantum_start = now;
+		quantum_armed = true;
+	}
+	timer_set_oneshot(&preempt_timer, 0, thread_preempt_expired, NULL);
+}
+
+/* stop the slice of a thread being switched out, charging it for its time */
+static void quantum_stop(thread_t *t)
+{
+	time_t now = current_time();
+
+	if (quantum_armed) {
+		timer_cancel(&preempt_timer);
+		quantum_armed = false;
+
+		t->remaining_quantum -= now - quantum_start;
+		if (t->remaining_quantum < 0)
+			t->remaining_quantum = 0;
+	}
+#if THREAD_STATS
+	else if (t != idle_thread) {
+		thread_stats.ticks_avoided += (now - quantum_start) / THREAD_TICK_MS;
+	}
+#endif
+}
+#endif
+
 /**
  * @brief  Cause another thread to be executed.
  *
@@ -338,7 +466,7 @@ void thread_resched(void)
 
 	/* set up quantum for the new thread if it was consumed */
 	if (newthread->remaining_quantum <= 0) {
-		newthread->remaining_quantum = 5; // XXX make this smarter
+		newthread->remaining_quantum = thread_quantum[newthread->priority];
 	}
 
 #if THREAD_STATS
@@ -359,11 +487,18 @@ void thread_resched(void)
 #endif
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-	/* if we're switching from idle to a real thread, set up a periodic
-	 * timer to run our preemption tick.
-	 */
-	if (oldthread == idle_thread) {
-		timer_set_periodic(&preempt_timer, 10, (timer_callback)thread_timer_tick, NULL);
+	if (tickless) {
+		/* slice the new thread only if it has company at its priority */
+		quantum_stop(oldthread);
+		quantum_start = current_time();
+		if (newthread != idle_thread &&
+		    !list_is_empty(&run_queue[newthread->priority]))
+			quantum_arm(newthread);
+	} else if (oldthread == idle_thread) {
+		/* if we're switching from idle to a real thread, set up a periodic
+		 * timer to run our preemption tick.
+		 */
+		timer_set_periodic(&preempt_timer, THREAD_TICK_MS, (timer_callback)thread_timer_tick, NULL);
 	} else if (newthread == idle_thread) {
 		timer_cancel(&preempt_timer);
 	}
@@ -477,11 +612,15 @@ enum handler_return thread_timer_tick(void)
 	if (current_thread == idle_thread)
 		return INT_NO_RESCHEDULE;
 
-	current_thread->remaining_quantum--;
-	if (current_thread->remaining_quantum <= 0)
+	current_thread->remaining_quantum -= THREAD_TICK_MS;
+	if (current_thread->remaining_quantum <= 0) {
+#if THREAD_STATS
+		thread_stats.slice_expiries++;
+#endif
 		return INT_RESCHEDULE;
-	else
+	} else {
 		return INT_NO_RESCHEDULE;
+	}
 }
 
 /* timer callback to wake up a sleeping thread */
@@ -538,8 +677,10 @@ void thread_init_early(void)
 	int i;
 
 	/* initialize the run queues */
-	for (i=0; i < NUM_PRIORITIES; i++)
+	for (i=0; i < NUM_PRIORITIES; i++) {
 		list_initialize(&run_queue[i]);
+		thread_quantum[i] = THREAD_QUANTUM;
+	}
 
 	/* initialize the thread list */
 	list_initialize(&thread_list);
@@ -590,6 +731,67 @@ void thread_set_priority(int priority)
 	current_thread->priority = priority;
 }
 
+/**
+ * @brief Change the time slice of threads at a priority
+ *
+ * @param priority  The priority level
+ * @param quantum   Slice length in ms; the running thread gets a new one
+ *                  when it next uses up its current slice.
+ */
+void thread_set_quantum(int priority, time_t quantum)
+{
+	if (priority < LOWEST_PRIORITY || priority > HIGHEST_PRIORITY)
+		return;
+	if (quantum == 0)
+		quantum = 1;
+	thread_quantum[priority] = quantum;
+}
+
+/**
+ * @brief Choose between tickless and periodic time slicing
+ *
+ * In tickless mode the running thread is only interrupted when its slice
+ * ends and another thread of its priority is waiting. Otherwise the
+ * scheduler ticks every THREAD_TICK_MS while a thread is running.
+ *
+ * @return NO_ERROR, or ERR_NOT_SUPPORTED if the platform has no one-shot
+ * timer, in which case the scheduler always ticks.
+ */
+status_t thread_set_tickless(bool enable)
+{
+#if PLATFORM_HAS_DYNAMIC_TIMER
+	enter_critical_section();
+
+	if (enable != tickless) {
+		if (tickless) {
+			if (quantum_armed) {
+				timer_cancel(&preempt_timer);
+				quantum_armed = false;
+			}
+		} else {
+			timer_cancel(&preempt_timer);
+		}
+
+		tickless = enable;
+
+		if (current_thread != idle_thread) {
+			if (tickless) {
+				quantum_start = current_time();
+				if (!list_is_empty(&run_queue[current_thread->priority]))
+					quantum_arm(current_thread);
+			} else {
+				timer_set_periodic(&preempt_timer, THREAD_TICK_MS, (timer_callback)thread_timer_tick, NULL);
+			}
+		}
+	}
+
+	exit_critical_section();
+	return NO_ERROR;
+#else
+	return enable ? ERR_NOT_SUPPORTED : NO_ERROR;
+#endif
+}
+
 /**
  * @brief  Become an idle thread
  *
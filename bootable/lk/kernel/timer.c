@@ -41,7 +41,17 @@
 #include <platform/timer.h>
 #include <platform.h>
 
-static struct list_node timer_queue;
+/*
+ * Pending timers are kept in a binary min-heap ordered on scheduled_time.
+ * The heap is linked through the timers themselves rather than stored in
+ * an array, so there is no limit on the number of pending timers and
+ * nothing is allocated. Node n (counting from 1 in breadth first order)
+ * is found by walking down from the root along the bits of n below the
+ * leading one, 0 for left and 1 for right. Insert and cancel are
+ * O(log n) with interrupts disabled; the next timer to fire is the root.
+ */
+static timer_t *timer_heap;
+static uint timer_heap_count;
 
 static enum handler_return timer_tick(void *arg, time_t now);
 
@@ -51,28 +61,154 @@ static enum handler_return timer_tick(void *arg, time_t now);
 void timer_initialize(timer_t *timer)
 {
 	timer->magic = TIMER_MAGIC;
-	list_clear_node(&timer->node);
+	timer->parent = timer->left = timer->right = NULL;
 	timer->scheduled_time = 0;
 	timer->periodic_time = 0;
 	timer->callback = 0;
 	timer->arg = 0;
 }
 
+static inline bool timer_queued(timer_t *timer)
+{
+	return timer->parent || timer_heap == timer;
+}
+
+static timer_t *timer_heap_node(uint n)
+{
+	timer_t *node = timer_heap;
+	int bit;
+
+	for (bit = 30 - __builtin_clz(n); bit >= 0; bit--)
+		node = (n & (1U << bit)) ? node->right : node->left;
+
+	return node;
+}
+
+/* point whatever referenced 'old' from above at 'node' instead */
+static void timer_heap_relink_parent(timer_t *old, timer_t *node)
+{
+	timer_t *parent = old->parent;
+
+	node->parent = parent;
+	if (!parent)
+		timer_heap = node;
+	else if (parent->left == old)
+		parent->left = node;
+	else
+		parent->right = node;
+}
+
+/* swap a timer with its parent 'p' */
+static void timer_heap_swap(timer_t *p, timer_t *c)
+{
+	timer_t *left = c->left;
+	timer_t *right = c->right;
+	timer_t *sibling;
+
+	timer_heap_relink_parent(p, c);
+
+	if (p->left == c) {
+		sibling = p->right;
+		c->left = p;
+		c->right = sibling;
+	} else {
+		sibling = p->left;
+		c->left = sibling;
+		c->right = p;
+	}
+	if (sibling)
+		sibling->parent = c;
+
+	p->parent = c;
+	p->left = left;
+	p->right = right;
+	if (left)
+		left->parent = p;
+	if (right)
+		right->parent = p;
+}
+
+static void timer_heap_sift_up(timer_t *timer)
+{
+	while (timer->parent &&
+	       TIME_LT(timer->scheduled_time, timer->parent->scheduled_time))
+		timer_heap_swap(timer->parent, timer);
+}
+
+static void timer_heap_sift_down(timer_t *timer)
+{
+	timer_t *child;
+
+	for (;;) {
+		child = timer->left;
+		if (!child)
+			break;
+		if (timer->right &&
+		    TIME_LT(timer->right->scheduled_time, child->scheduled_time))
+			child = timer->right;
+		if (!TIME_LT(child->scheduled_time, timer->scheduled_time))
+			break;
+		timer_heap_swap(timer, child);
+	}
+}
+
 static void insert_timer_in_queue(timer_t *timer)
 {
-	timer_t *entry;
+	timer_t *parent;
 
 //	TRACEF("timer %p, scheduled %d, periodic %d\n", timer, timer->scheduled_time, timer->periodic_time);
 
-	list_for_every_entry(&timer_queue, entry, timer_t, node) {
-		if (TIME_GT(entry->scheduled_time, timer->scheduled_time)) {
-			list_add_before(&entry->node, &timer->node);
-			return;
-		}
+	timer->left = timer->right = NULL;
+	timer_heap_count++;
+
+	if (timer_heap_count == 1) {
+		timer->parent = NULL;
+		timer_heap = timer;
+		return;
 	}
 
-	/* walked off the end of the list */
-	list_add_tail(&timer_queue, &timer->node);
+	parent = timer_heap_node(timer_heap_count / 2);
+	if (timer_heap_count & 1)
+		parent->right = timer;
+	else
+		parent->left = timer;
+	timer->parent = parent;
+
+	timer_heap_sift_up(timer);
+}
+
+static void remove_timer_from_queue(timer_t *timer)
+{
+	timer_t *last;
+
+	/* unhook the last node, then let it take the removed timer's place */
+	last = timer_heap_node(timer_heap_count);
+	timer_heap_count--;
+
+	if (!last->parent)
+		timer_heap = NULL;
+	else if (last->parent->left == last)
+		last->parent->left = NULL;
+	else
+		last->parent->right = NULL;
+
+	if (last != timer) {
+		timer_heap_relink_parent(timer, last);
+		last->left = timer->left;
+		last->right = timer->right;
+		if (last->left)
+			last->left->parent = last;
+		if (last->right)
+			last->right->parent = last;
+
+		if (last->parent &&
+		    TIME_LT(last->scheduled_time, last->parent->scheduled_time))
+			timer_heap_sift_up(last);
+		else
+			timer_heap_sift_down(last);
+	}
+
+	timer->parent = timer->left = timer->right = NULL;
 }
 
 static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callback callback, void *arg)
@@ -83,7 +219,7 @@ static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callbac
 
 	DEBUG_ASSERT(timer->magic == TIMER_MAGIC);	
 
-	if (list_in_list(&timer->node)) {
+	if (timer_queued(timer)) {
 		panic("timer %p already in list\n", timer);
 	}
 
@@ -100,7 +236,7 @@ static void timer_set(timer_t *timer, time_t delay, time_t period, timer_callbac
 	insert_timer_in_queue(timer);
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-	if (list_peek_head_type(&timer_queue, timer_t, node) == timer) {
+	if (timer_heap == timer) {
 		/* we just modified the head of the timer queue */
 //		TRACEF("setting new timer for %u msecs\n", (uint)delay);
 		platform_set_oneshot_timer(timer_tick, NULL, delay);
@@ -162,11 +298,11 @@ void timer_cancel(timer_t *timer)
 	enter_critical_section();
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-	timer_t *oldhead = list_peek_head_type(&timer_queue, timer_t, node);
+	timer_t *oldhead = timer_heap;
 #endif
 
-	if (list_in_list(&timer->node))
-		list_delete(&timer->node);
+	if (timer_queued(timer))
+		remove_timer_from_queue(timer);
 
 	/* to keep it from being reinserted into the queue if called from 
 	 * periodic timer callback.
@@ -177,7 +313,7 @@ void timer_cancel(timer_t *timer)
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
 	/* see if we've just modified the head of the timer queue */
-	timer_t *newhead = list_peek_head_type(&timer_queue, timer_t, node);
+	timer_t *newhead = timer_heap;
 	if (newhead == NULL) {
 //		TRACEF("clearing old hw timer, nothing in the queue\n");
 		platform_stop_timer();
@@ -212,15 +348,13 @@ static enum handler_return timer_tick(void *arg, time_t now)
 
 	for (;;) {
 		/* see if there's an event to process */
-		timer = list_peek_head_type(&timer_queue, timer_t, node);
+		timer = timer_heap;
 		if (likely(!timer || TIME_LT(now, timer->scheduled_time)))
 			break;
 
 		/* process it */
 		DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
-		list_delete(&timer->node);
-//		timer = list_remove_head_type(&timer_queue, timer_t, node);
-//		ASSERT(timer);
+		remove_timer_from_queue(timer);
 
 //		TRACEF("dequeued timer %p, scheduled %d periodic %d\n", timer, timer->scheduled_time, timer->periodic_time);
 
@@ -237,7 +371,7 @@ static enum handler_return timer_tick(void *arg, time_t now)
 		/* if it was a periodic timer and it hasn't been requeued
 		 * by the callback put it back in the list
 		 */
-		if (periodic && !list_in_list(&timer->node) && timer->periodic_time > 0) {
+		if (periodic && !timer_queued(timer) && timer->periodic_time > 0) {
 //			TRACEF("periodic timer, period %u\n", (uint)timer->periodic_time);
 			timer->scheduled_time = now + timer->periodic_time;
 			insert_timer_in_queue(timer);
@@ -246,7 +380,7 @@ static enum handler_return timer_tick(void *arg, time_t now)
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
 	/* reset the timer to the next event */
-	timer = list_peek_head_type(&timer_queue, timer_t, node);
+	timer = timer_heap;
 	if (timer) {
 		/* has to be the case or it would have fired already */
 		ASSERT(TIME_GT(timer->scheduled_time, now));
@@ -269,10 +403,13 @@ static enum handler_return timer_tick(void *arg, time_t now)
 
 void timer_init(void)
 {
-	list_initialize(&timer_queue);
+	timer_heap = NULL;
+	timer_heap_count = 0;
 
+#if !PLATFORM_HAS_DYNAMIC_TIMER
 	/* register for a periodic timer tick */
-	platform_set_periodic_timer(timer_tick, NULL, 10); /* 10ms */
+	platform_set_periodic_timer(timer_tick, NULL, THREAD_TICK_MS);
+#endif
 }
 
 
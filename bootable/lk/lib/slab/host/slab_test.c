@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Host test for the slab allocator, run against a heap stub that counts
+ * what reaches it. It checks that small requests are served from the
+ * arena and large or over-aligned ones from the heap, that objects keep
+ * their contents and alignment through a long random mix of allocs,
+ * reallocs and frees, that empty pages go back to the arena and are
+ * reused by other classes, that a full arena spills to the heap, and
+ * that everything still works when slab_init() gets no arena at all.
+ * The cost comparison against the real heap is the in-target heap_tests
+ * benchmark; glibc malloc says nothing about LK's heap.
+ *
+ * Built from the lk top directory with
+ *
+ *   gcc -Ilib/slab/host -Iplatform/msm_shared/host -idirafter include \
+ *       -o slab_test lib/slab/host/slab_test.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../slab.c"
+
+#define CHECK(c) do {							\
+	if (!(c)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__FILE__, __LINE__, #c);			\
+		exit(1);						\
+	}								\
+} while (0)
+
+/* heap stub */
+
+static int heap_refuse_arena;
+static unsigned heap_stub_allocs;
+static unsigned heap_stub_live;
+
+void *heap_alloc(size_t size, unsigned int alignment)
+{
+	void *ptr;
+
+	if (heap_refuse_arena && size == SLAB_ARENA_SIZE)
+		return NULL;
+	if (alignment < sizeof(void *))
+		alignment = sizeof(void *);
+	ptr = aligned_alloc(alignment, ROUNDUP(size ? size : 1, alignment));
+	if (ptr) {
+		heap_stub_allocs++;
+		heap_stub_live++;
+	}
+	return ptr;
+}
+
+void *heap_realloc(void *ptr, size_t size)
+{
+	if (!ptr)
+		return heap_alloc(size, 0);
+	return realloc(ptr, size);
+}
+
+void heap_free(void *ptr)
+{
+	if (ptr)
+		heap_stub_live--;
+	free(ptr);
+}
+
+/* start over with a fresh allocator */
+static void slab_reset(void)
+{
+	if (arena)
+		heap_free(arena);
+	memset(slab_classes, 0, sizeof(slab_classes));
+	list_initialize(&free_pages);
+	arena = NULL;
+	arena_used = arena_pages = 0;
+	heap_allocs = heap_frees = heap_spills = heap_live = heap_peak = 0;
+	slab_init();
+}
+
+static void test_routing(void)
+{
+	void *small, *edge, *big, *aligned;
+
+	small = slab_alloc(1, 0);
+	edge = slab_alloc(SLAB_MAX_SIZE, SLAB_ALIGN);
+	big = slab_alloc(SLAB_MAX_SIZE + 1, 0);
+	aligned = slab_alloc(32, 64);
+
+	CHECK(in_arena(small) && in_arena(edge));
+	CHECK(!in_arena(big) && !in_arena(aligned));
+	CHECK(((uintptr_t) aligned & 63) == 0);
+	CHECK(slab_of(small)->cls->size == SLAB_MIN_SIZE);
+	CHECK(slab_of(edge)->cls->size == SLAB_MAX_SIZE);
+	CHECK(heap_allocs == 2 && heap_spills == 0);
+
+	slab_free(small);
+	slab_free(edge);
+	slab_free(big);
+	slab_free(aligned);
+	slab_free(NULL);
+	CHECK(arena_pages == 0 && heap_live == 0);
+}
+
+#define NSLOTS 4000
+
+static struct {
+	unsigned char *ptr;
+	size_t size;
+	unsigned char tag;
+} slots[NSLOTS];
+
+static void check_slot(int i)
+{
+	size_t n;
+
+	for (n = 0; n < slots[i].size; n++)
+		CHECK(slots[i].ptr[n] == slots[i].tag);
+}
+
+static void test_random(unsigned seed, long ops)
+{
+	unsigned int alignment;
+	size_t size;
+	long op;
+	int i;
+
+	srand(seed);
+	for (op = 0; op < ops; op++) {
+		i = rand() % NSLOTS;
+		if (slots[i].ptr) {
+			check_slot(i);
+			if (rand() % 8 == 0) {
+				size = slots[i].size + rand() % 200;
+				slots[i].ptr = slab_realloc(slots[i].ptr, size);
+				CHECK(slots[i].ptr);
+				check_slot(i);
+				memset(slots[i].ptr, slots[i].tag, size);
+				slots[i].size = size;
+			} else {
+				slab_free(slots[i].ptr);
+				slots[i].ptr = NULL;
+			}
+			continue;
+		}
+
+		size = rand() % 10 == 0 ? rand() % 8192 + 1 : rand() % SLAB_MAX_SIZE + 1;
+		alignment = rand() % 20 == 0 ? 64 : 0;
+		slots[i].ptr = slab_alloc(size, alignment);
+		CHECK(slots[i].ptr);
+		CHECK(((uintptr_t) slots[i].ptr & (SLAB_ALIGN - 1)) == 0);
+		if (alignment)
+			CHECK(((uintptr_t) slots[i].ptr & (alignment - 1)) == 0);
+		slots[i].size = size;
+		slots[i].tag = rand();
+		memset(slots[i].ptr, slots[i].tag, size);
+	}
+
+	/* the arena is far too small for this many objects */
+	CHECK(heap_spills > 0);
+
+	for (i = 0; i < NSLOTS; i++) {
+		if (slots[i].ptr)
+			check_slot(i);
+		slab_free(slots[i].ptr);
+		slots[i].ptr = NULL;
+	}
+
+	for (i = 0; i < SLAB_CLASSES; i++)
+		CHECK(slab_classes[i].inuse == 0 && slab_classes[i].pages == 0);
+	CHECK(arena_pages == 0 && heap_live == 0);
+}
+
+static void test_page_reuse(void)
+{
+	void *objs[SLAB_PAGE_SIZE / SLAB_MIN_SIZE];
+	uint carved;
+	int n, i;
+
+	/* fill one page of the smallest class, free it, then make sure the
+	 * largest class gets that page instead of a new one */
+	objs[0] = slab_alloc(SLAB_MIN_SIZE, 0);
+	n = slab_of(objs[0])->count;
+	for (i = 1; i < n; i++)
+		objs[i] = slab_alloc(SLAB_MIN_SIZE, 0);
+	CHECK(slab_classes[0].pages == 1);
+	CHECK(list_is_empty(&slab_classes[0].partial));
+
+	carved = arena_used;
+	for (i = 0; i < n; i++)
+		slab_free(objs[i]);
+	CHECK(slab_classes[0].pages == 0 && arena_pages == 0);
+
+	objs[0] = slab_alloc(SLAB_MAX_SIZE, 0);
+	CHECK(arena_used == carved);
+	CHECK(slab_of(objs[0])->cls->size == SLAB_MAX_SIZE);
+	slab_free(objs[0]);
+}
+
+static void test_full_arena(void)
+{
+	void *objs[SLAB_ARENA_SIZE / SLAB_PAGE_SIZE * 8];
+	void *ptr;
+	int per_page, i, n;
+
+	/* one object per page of the largest class... */
+	ptr = slab_alloc(SLAB_MAX_SIZE, 0);
+	per_page = slab_of(ptr)->count;
+	slab_free(ptr);
+
+	n = SLAB_ARENA_SIZE / SLAB_PAGE_SIZE * per_page;
+	CHECK(n <= (int) countof(objs));
+	for (i = 0; i < n; i++) {
+		objs[i] = slab_alloc(SLAB_MAX_SIZE, 0);
+		CHECK(in_arena(objs[i]));
+	}
+
+	/* ...until the arena is used up, then small requests spill */
+	ptr = slab_alloc(SLAB_MIN_SIZE, 0);
+	CHECK(ptr && !in_arena(ptr));
+	CHECK(heap_spills == 1);
+	slab_free(ptr);
+
+	/* a freed object makes room again */
+	slab_free(objs[0]);
+	objs[0] = slab_alloc(SLAB_MAX_SIZE, 0);
+	CHECK(in_arena(objs[0]));
+
+	for (i = 0; i < n; i++)
+		slab_free(objs[i]);
+	CHECK(arena_pages == 0 && heap_live == 0);
+}
+
+int main(void)
+{
+	unsigned char *first;
+
+	slab_reset();
+	CHECK(arena);
+	test_routing();
+	test_page_reuse();
+	test_full_arena();
+	test_random(1, 1000000);
+	slab_dump();
+
+	/* a second slab_init() keeps the existing arena */
+	first = arena;
+	slab_init();
+	CHECK(arena == first);
+
+	/* no arena: everything goes to the heap */
+	heap_refuse_arena = 1;
+	slab_reset();
+	CHECK(!arena);
+	test_random(2, 200000);
+	CHECK(arena_used == 0 && arena_pages == 0);
+
+	CHECK(heap_stub_live == 0);
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <debug.h>
+#include <list.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/heap.h>
+#include <lib/slab.h>
+#include <kernel/thread.h>
+
+#define SLAB_MAGIC 'slab'
+#define SLAB_CLASSES 6	/* 16 .. 512 */
+
+struct slab_class;
+
+/* header at the start of every slab page */
+struct slab {
+	int magic;
+	struct list_node node;	/* class partial list, or the free page list */
+	struct slab_class *cls;
+	void *free;		/* objects freed back to this page */
+	uint16_t inuse;
+	uint16_t count;		/* objects the page holds */
+	uint16_t unused;	/* objects never handed out, at the end */
+};
+
+#define SLAB_HEADER_SIZE ROUNDUP(sizeof(struct slab), SLAB_ALIGN)
+
+struct slab_class {
+	size_t size;
+	struct list_node partial;	/* pages with objects left */
+
+	/* statistics */
+	uint pages;
+	uint inuse;
+	uint peak;
+	uint allocs;
+	uint frees;
+	unsigned long long requested;	/* bytes asked for, over all allocs */
+};
+
+static struct slab_class slab_classes[SLAB_CLASSES];
+
+static unsigned char *arena;
+static uint arena_used;		/* pages ever carved from the arena */
+static uint arena_pages;	/* pages currently owned by a class */
+static struct list_node free_pages = LIST_INITIAL_VALUE(free_pages);
+
+/* requests that went to the heap */
+static uint heap_allocs;
+static uint heap_frees;
+static uint heap_spills;	/* small ones, the arena being full */
+static uint heap_live;
+static uint heap_peak;
+
+static inline bool in_arena(void *ptr)
+{
+	return arena && (unsigned char *)ptr >= arena &&
+	       (unsigned char *)ptr < arena + SLAB_ARENA_SIZE;
+}
+
+static inline struct slab *slab_of(void *ptr)
+{
+	return (struct slab *)((addr_t)ptr & ~(SLAB_PAGE_SIZE - 1));
+}
+
+static struct slab_class *slab_class_for(size_t size)
+{
+	size_t class_size = SLAB_MIN_SIZE;
+	int i = 0;
+
+	while (class_size < size) {
+		class_size <<= 1;
+		i++;
+	}
+	return &slab_classes[i];
+}
+
+/* called in a critical section */
+static struct slab *slab_page_alloc(struct slab_class *cls)
+{
+	struct slab *page;
+
+	page = list_remove_head_type(&free_pages, struct slab, node);
+	if (!page) {
+		if (!arena || arena_used == SLAB_ARENA_SIZE / SLAB_PAGE_SIZE)
+			return NULL;
+		page = (struct slab *)(arena + arena_used++ * SLAB_PAGE_SIZE);
+	}
+
+	page->magic = SLAB_MAGIC;
+	page->cls = cls;
+	page->free = NULL;
+	page->inuse = 0;
+	page->count = (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / cls->size;
+	page->unused = page->count;
+	list_add_head(&cls->partial, &page->node);
+
+	cls->pages++;
+	arena_pages++;
+	return page;
+}
+
+static void *heap_path_alloc(size_t size, unsigned int alignment, bool spill)
+{
+	void *ptr = heap_alloc(size, alignment);
+
+	if (ptr) {
+		enter_critical_section();
+		heap_allocs++;
+		if (spill)
+			heap_spills++;
+		if (++heap_live > heap_peak)
+			heap_peak = heap_live;
+		exit_critical_section();
+	}
+	return ptr;
+}
+
+void *slab_alloc(size_t size, unsigned int alignment)
+{
+	struct slab_class *cls;
+	struct slab *page;
+	void *ptr;
+
+	if (size > SLAB_MAX_SIZE || alignment > SLAB_ALIGN)
+		return heap_path_alloc(size, alignment, false);
+
+	cls = slab_class_for(size);
+
+	enter_critical_section();
+
+	page = list_peek_head_type(&cls->partial, struct slab, node);
+	if (!page)
+		page = slab_page_alloc(cls);
+	if (!page) {
+		exit_critical_section();
+		return heap_path_alloc(size, alignment, true);
+	}
+
+	if (page->free) {
+		ptr = page->free;
+		page->free = *(void **)ptr;
+	} else {
+		ptr = (unsigned char *)page + SLAB_HEADER_SIZE +
+		      (page->count - page->unused) * cls->size;
+		page->unused--;
+	}
+
+	/* full pages leave the partial list until something is freed */
+	if (++page->inuse == page->count)
+		list_delete(&page->node);
+
+	cls->allocs++;
+	cls->requested += size;
+	if (++cls->inuse > cls->peak)
+		cls->peak = cls->inuse;
+
+	exit_critical_section();
+
+	return ptr;
+}
+
+void slab_free(void *ptr)
+{
+	struct slab_class *cls;
+	struct slab *page;
+
+	if (!ptr)
+		return;
+
+	if (!in_arena(ptr)) {
+		heap_free(ptr);
+		enter_critical_section();
+		heap_frees++;
+		heap_live--;
+		exit_critical_section();
+		return;
+	}
+
+	page = slab_of(ptr);
+	DEBUG_ASSERT(page->magic == SLAB_MAGIC);
+	cls = page->cls;
+
+	enter_critical_section();
+
+	if (page->inuse == page->count)
+		list_add_head(&cls->partial, &page->node);
+
+	*(void **)ptr = page->free;
+	page->free = ptr;
+
+	cls->frees++;
+	cls->inuse--;
+
+	/* empty pages go back to the arena for any class to use */
+	if (--page->inuse == 0) {
+		list_delete(&page->node);
+		page->magic = 0;
+		list_add_head(&free_pages, &page->node);
+		cls->pages--;
+		arena_pages--;
+	}
+
+	exit_critical_section();
+}
+
+void *slab_realloc(void *ptr, size_t size)
+{
+	size_t old_size;
+	void *new_ptr;
+
+	if (!ptr)
+		return slab_alloc(size, 0);
+
+	if (!in_arena(ptr))
+		return heap_realloc(ptr, size);
+
+	old_size = slab_of(ptr)->cls->size;
+	if (size <= old_size)
+		return ptr;
+
+	new_ptr = slab_alloc(size, 0);
+	if (!new_ptr)
+		return NULL;
+
+	memcpy(new_ptr, ptr, old_size);
+	slab_free(ptr);
+
+	return new_ptr;
+}
+
+void slab_init(void)
+{
+	size_t size = SLAB_MIN_SIZE;
+	int i;
+
+	if (slab_classes[0].size)
+		return;
+
+	for (i = 0; i < SLAB_CLASSES; i++, size <<= 1) {
+		slab_classes[i].size = size;
+		list_initialize(&slab_classes[i].partial);
+	}
+
+	/* without an arena every request simply goes to the heap */
+	arena = heap_alloc(SLAB_ARENA_SIZE, SLAB_PAGE_SIZE);
+	if (!arena)
+		dprintf(CRITICAL, "slab: no arena, using the heap only\n");
+}
+
+/* percentage, 0 when there is nothing to measure */
+static uint percent(unsigned long long part, unsigned long long whole)
+{
+	return whole ? (uint)(part * 100 / whole) : 0;
+}
+
+void slab_dump(void)
+{
+	struct slab_class *cls;
+	uint objs_per_page;
+	int i;
+
+	printf("slab arena %p: %u of %u pages in use, %u carved\n", arena,
+	       arena_pages, SLAB_ARENA_SIZE / SLAB_PAGE_SIZE, arena_used);
+	printf("%5s %6s %6s %6s %8s %8s %5s %5s\n", "size", "pages", "inuse",
+	       "peak", "allocs", "frees", "used", "waste");
+
+	for (i = 0; i < SLAB_CLASSES; i++) {
+		cls = &slab_classes[i];
+		objs_per_page = (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / cls->size;
+
+		/* used: live objects over the room in the class's pages.
+		 * waste: bytes lost to rounding requests up to the class size.
+		 */
+		printf("%5zu %6u %6u %6u %8u %8u %4u%% %4u%%\n", cls->size,
+		       cls->pages, cls->inuse, cls->peak, cls->allocs, cls->frees,
+		       percent(cls->inuse, cls->pages * objs_per_page),
+		       cls->allocs ? 100 - percent(cls->requested,
+				(unsigned long long)cls->allocs * cls->size) : 0);
+	}
+
+	printf("heap: %u allocs (%u small spills), %u frees, %u live, peak %u\n",
+	       heap_allocs, heap_spills, heap_frees, heap_live, heap_peak);
+}
+
+#if defined(WITH_LIB_CONSOLE)
+#include <lib/console.h>
+
+static int cmd_slabinfo(int argc, const cmd_args *argv)
+{
+	slab_dump();
+
+	return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("slabinfo", "slab allocator statistics", &cmd_slabinfo)
+STATIC_COMMAND_END(slab);
+
+#endif
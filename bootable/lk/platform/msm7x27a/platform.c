@@ -87,20 +87,13 @@ mmu_section_t mmu_section_table[] = {
 void platform_init_mmu_mappings(void)
 {
     uint32_t i;
-    uint32_t sections;
     uint32_t table_size = ARRAY_SIZE(mmu_section_table);
 
     for (i = 0; i < table_size; i++)
-    {
-        sections = mmu_section_table[i].num_of_sections;
-
-        while (sections--)
-        {
-            arm_mmu_map_section(mmu_section_table[i].paddress + sections*MB,
-                                mmu_section_table[i].vaddress + sections*MB,
-                                mmu_section_table[i].flags);
-        }
-    }
+        arm_mmu_map_region(mmu_section_table[i].paddress,
+                           mmu_section_table[i].vaddress,
+                           mmu_section_table[i].num_of_sections * MB,
+                           mmu_section_table[i].flags);
 }
 
 void platform_early_init(void)
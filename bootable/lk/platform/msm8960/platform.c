@@ -56,16 +56,16 @@ static uint8_t display_enabled = 0;
 
 #define MSM_IOMAP_SIZE ((MSM_IOMAP_END - MSM_IOMAP_BASE)/MB)
 
-/* LK memory - cacheable, write through */
-#define LK_MEMORY         (MMU_MEMORY_TYPE_NORMAL_WRITE_THROUGH | \
+/* LK memory - cacheable, write back, write allocate */
+#define LK_MEMORY         (MMU_MEMORY_TYPE_NORMAL_WRITE_BACK_ALLOCATE | \
                            MMU_MEMORY_AP_READ_WRITE)
 
-/* Kernel region - cacheable, write through */
-#define KERNEL_MEMORY     (MMU_MEMORY_TYPE_NORMAL_WRITE_THROUGH   | \
+/* Kernel region - cacheable, write back, write allocate */
+#define KERNEL_MEMORY     (MMU_MEMORY_TYPE_NORMAL_WRITE_BACK_ALLOCATE | \
                            MMU_MEMORY_AP_READ_WRITE | MMU_MEMORY_XN)
 
-/* Scratch region - cacheable, write through */
-#define SCRATCH_MEMORY    (MMU_MEMORY_TYPE_NORMAL_WRITE_THROUGH   | \
+/* Scratch region - cacheable, write back, write allocate */
+#define SCRATCH_MEMORY    (MMU_MEMORY_TYPE_NORMAL_WRITE_BACK_ALLOCATE | \
                            MMU_MEMORY_AP_READ_WRITE | MMU_MEMORY_XN)
 
 /* Peripherals - non-shared device */
@@ -135,20 +135,13 @@ void platform_uninit(void)
 void platform_init_mmu_mappings(void)
 {
 	uint32_t i;
-	uint32_t sections;
 	uint32_t table_size = ARRAY_SIZE(mmu_section_table);
 
-	for (i = 0; i < table_size; i++) {
-		sections = mmu_section_table[i].num_of_sections;
-
-		while (sections--) {
-			arm_mmu_map_section(mmu_section_table[i].paddress +
-					    sections * MB,
-					    mmu_section_table[i].vaddress +
-					    sections * MB,
-					    mmu_section_table[i].flags);
-		}
-	}
+	for (i = 0; i < table_size; i++)
+		arm_mmu_map_region(mmu_section_table[i].paddress,
+				   mmu_section_table[i].vaddress,
+				   mmu_section_table[i].num_of_sections * MB,
+				   mmu_section_table[i].flags);
 }
 
 /* Initialize DGT timer */
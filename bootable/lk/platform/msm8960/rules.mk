@@ -6,6 +6,9 @@ CPU     := generic
 
 DEFINES += ARM_CPU_CORE_KRAIT
 
+# the DGT runs as a one-shot timer, see msm_shared/timer.c
+DEFINES += PLATFORM_HAS_DYNAMIC_TIMER=1
+
 MMC_SLOT         := 1
 
 DEFINES += WITH_CPU_EARLY_INIT=0 WITH_CPU_WARM_BOOT=0 \
@@ -216,20 +216,13 @@ uint32_t platform_id_read(void)
 void platform_init_mmu_mappings(void)
 {
 	uint32_t i;
-	uint32_t sections;
 	uint32_t table_size = ARRAY_SIZE(mmu_section_table);
 
-	for (i = 0; i < table_size; i++) {
-		sections = mmu_section_table[i].num_of_sections;
-
-		while (sections--) {
-			arm_mmu_map_section(mmu_section_table[i].paddress +
-					    sections * MB,
-					    mmu_section_table[i].vaddress +
-					    sections * MB,
-					    mmu_section_table[i].flags);
-		}
-	}
+	for (i = 0; i < table_size; i++)
+		arm_mmu_map_region(mmu_section_table[i].paddress,
+				   mmu_section_table[i].vaddress,
+				   mmu_section_table[i].num_of_sections * MB,
+				   mmu_section_table[i].flags);
 }
 
 /* Do any platform specific cleanup just before kernel entry */
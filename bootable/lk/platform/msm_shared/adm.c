@@ -29,6 +29,7 @@
 
 #include <stdlib.h>
 #include <reg.h>
+#include <arch/ops.h>
 
 #include "adm.h"
 #include <platform/adm.h>
@@ -88,6 +89,15 @@ adm_transfer_mmc_data(unsigned char slot,
 	row_len = MMC_BOOT_MCI_FIFO_SIZE;
 	num_rows = data_len / MMC_BOOT_MCI_FIFO_SIZE;
 
+	/* The ADM works on memory. Data going to the card must be written
+	 * back first; lines of a read buffer are dropped so that no dirty
+	 * line gets evicted on top of what the ADM writes.
+	 */
+	if (direction == ADM_MMC_READ)
+		arch_clean_invalidate_cache_range((addr_t) data_ptr, data_len);
+	else
+		arch_clean_cache_range((addr_t) data_ptr, data_len);
+
 	/* While there is data to be transferred */
 	while (data_len) {
 		if (data_len <= MAX_ROW_LEN) {
@@ -137,6 +147,11 @@ adm_transfer_mmc_data(unsigned char slot,
 				       (((uint32_t) (&box_mode_entry[0])) >>
 					3));
 
+		arch_clean_cache_range((addr_t) box_mode_entry,
+				       sizeof(box_mode_entry));
+		arch_clean_cache_range((addr_t) adm_cmd_ptr_list,
+				       sizeof(adm_cmd_ptr_list));
+
 		/* Start ADM transfer, this is a blocking call. */
 		result = adm_transfer_start(ADM_CHN, adm_cmd_ptr_list);
 
@@ -144,6 +159,11 @@ adm_transfer_mmc_data(unsigned char slot,
 			break;
 		}
 
+		/* Drop anything speculatively fetched while the ADM ran */
+		if (direction == ADM_MMC_READ)
+			arch_invalidate_cache_range((addr_t) data_ptr,
+						    row_len * row_num);
+
 		/* Update the data ptr and data len by the amount
 		 * we just transferred.
 		 */
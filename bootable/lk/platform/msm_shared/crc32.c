@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <endian.h>
+#include "crc32.h"
+
+#define CRC32_POLY	0xEDB88320
+
+/*
+ * Slice-by-8 tables: crc32_table[0] is the classic byte-wise table and
+ * crc32_table[k][n] is the CRC of byte n followed by k zero bytes, which
+ * lets the inner loop fold eight input bytes per iteration.
+ */
+static uint32_t crc32_table[8][256];
+static int crc32_table_ready;
+
+static void crc32_init_table(void)
+{
+	uint32_t crc;
+	unsigned i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (CRC32_POLY & -(crc & 1));
+		crc32_table[0][i] = crc;
+	}
+
+	for (i = 0; i < 256; i++) {
+		crc = crc32_table[0][i];
+		for (j = 1; j < 8; j++) {
+			crc = crc32_table[0][crc & 0xFF] ^ (crc >> 8);
+			crc32_table[j][i] = crc;
+		}
+	}
+
+	crc32_table_ready = 1;
+}
+
+void crc32_init(struct crc32_ctx *ctx)
+{
+	if (!crc32_table_ready)
+		crc32_init_table();
+
+	ctx->crc = 0xFFFFFFFF;
+}
+
+void crc32_update(struct crc32_ctx *ctx, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	uint32_t crc = ctx->crc;
+	uint32_t lo, hi;
+
+	/* Byte-wise until the input is word aligned */
+	while (len && ((unsigned long)p & 3)) {
+		crc = crc32_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		len--;
+	}
+
+	while (len >= 8) {
+		lo = LE32(*(const uint32_t *)p) ^ crc;
+		hi = LE32(*(const uint32_t *)(p + 4));
+		crc = crc32_table[7][lo & 0xFF] ^
+		      crc32_table[6][(lo >> 8) & 0xFF] ^
+		      crc32_table[5][(lo >> 16) & 0xFF] ^
+		      crc32_table[4][lo >> 24] ^
+		      crc32_table[3][hi & 0xFF] ^
+		      crc32_table[2][(hi >> 8) & 0xFF] ^
+		      crc32_table[1][(hi >> 16) & 0xFF] ^
+		      crc32_table[0][hi >> 24];
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc = crc32_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	ctx->crc = crc;
+}
+
+uint32_t crc32_final(struct crc32_ctx *ctx)
+{
+	return ctx->crc ^ 0xFFFFFFFF;
+}
+
+uint32_t crc32(const void *buf, size_t len)
+{
+	struct crc32_ctx ctx;
+
+	crc32_init(&ctx);
+	crc32_update(&ctx, buf, len);
+	return crc32_final(&ctx);
+}
@@ -80,6 +80,81 @@ hash_find(unsigned char *addr, unsigned int size, unsigned char *digest,
 
 }
 
+static crypto_result_type crypto_sha256_init(crypto_SHA256_ctx * ctx_ptr);
+static crypto_result_type crypto_sha1_init(crypto_SHA1_ctx * ctx_ptr);
+
+/*
+ * Incremental counterpart of hash_find() for data that is not contiguous
+ * or not all in memory yet. Call hash_update() for each piece in order,
+ * with last set on the final one, then pick up the digest with
+ * hash_final().
+ */
+
+void hash_init(hash_ctx *ctx, unsigned char auth_alg)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->auth_alg = auth_alg;
+	ctx->ce_type = board_ce_type();
+	ctx->first = TRUE;
+
+	if (ctx->ce_type == CRYPTO_ENGINE_TYPE_SW) {
+		if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			SHA1_Init(&ctx->sw.sha1);
+		else
+			SHA256_Init(&ctx->sw.sha256);
+	} else if (ctx->ce_type == CRYPTO_ENGINE_TYPE_HW) {
+		crypto_init();
+		if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			crypto_sha1_init(&ctx->hw.sha1);
+		else
+			crypto_sha256_init(&ctx->hw.sha256);
+	}
+}
+
+crypto_result_type
+hash_update(hash_ctx *ctx, unsigned char *addr, unsigned int size, bool last)
+{
+	crypto_result_type ret_val;
+
+	if (ctx->ce_type == CRYPTO_ENGINE_TYPE_SW) {
+		if (ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			SHA1_Update(&ctx->sw.sha1, addr, size);
+		else
+			SHA256_Update(&ctx->sw.sha256, addr, size);
+		return CRYPTO_SHA_ERR_NONE;
+	}
+
+	if (ctx->ce_type != CRYPTO_ENGINE_TYPE_HW)
+		return CRYPTO_SHA_ERR_FAIL;
+
+	ret_val = do_sha_update(&ctx->hw, addr, size, ctx->auth_alg,
+				ctx->first, last);
+	ctx->first = FALSE;
+
+	if (ret_val != CRYPTO_SHA_ERR_NONE) {
+		dprintf(CRITICAL, "do_sha_update returns error %d\n", ret_val);
+	}
+
+	return ret_val;
+}
+
+void hash_final(hash_ctx *ctx, unsigned char *digest)
+{
+	if (ctx->ce_type == CRYPTO_ENGINE_TYPE_SW) {
+		if (ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			SHA1_Final(digest, &ctx->sw.sha1);
+		else
+			SHA256_Final(digest, &ctx->sw.sha256);
+	} else if (ctx->ce_type == CRYPTO_ENGINE_TYPE_HW) {
+		if (ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1)
+			memcpy(digest, ctx->hw.sha1.auth_iv, 20);
+		else
+			memcpy(digest, ctx->hw.sha256.auth_iv, 32);
+	}
+
+	crypto_eng_cleanup();
+}
+
 /*
  * Function to reset and init crypto engine. It resets the engine for the
  * first time. Used for multiple SHA operations.
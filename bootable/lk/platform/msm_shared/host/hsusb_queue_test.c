@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Host test for the hsusb endpoint queue. A model of the controller's
+ * endpoint machinery walks the dTD chains hsusb.c builds: it follows the
+ * links, fills or drains the buffers through the page pointers, retires
+ * dTDs the way the hardware does on full and short packets, and raises
+ * the transfer interrupt. The test checks that queued requests complete
+ * in order with the right byte counts, that requests queued behind busy
+ * ones are linked rather than primed again, that a short packet ends its
+ * request and the next one picks up the data that follows, and that
+ * cancelling fails the rest of the queue. It then runs fastboot's
+ * usb_read() and usb_write() against the model.
+ *
+ * hsusb.c hands the controller 32 bit addresses, so everything it touches
+ * has to sit below 4G: built from the lk top directory with
+ *
+ *   gcc -no-pie -Iplatform/msm_shared/host -Iapp/aboot/host -idirafter include \
+ *       -o hsusb_queue_test platform/msm_shared/host/hsusb_queue_test.c \
+ *       platform/msm_shared/hsusb.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <platform/iomap.h>
+#include <platform/interrupts.h>
+
+#include "../../../app/aboot/fastboot.c"
+#include "../hsusb.h"
+
+#define HOST_MAXPKT	512
+
+#define CHECK(c) do {							\
+	if (!(c)) {							\
+		fprintf(stderr, "%s:%d: check failed: %s\n",		\
+			__FILE__, __LINE__, #c);			\
+		exit(1);						\
+	}								\
+} while (0)
+
+enum handler_return udc_interrupt(void *arg);
+extern struct ept_queue_head *epts;
+
+/* hsusb.c takes its requests from the slab allocator, malloc will do */
+void *slab_alloc(size_t size, unsigned int alignment)
+{
+	return malloc(size);
+}
+
+void slab_free(void *ptr)
+{
+	free(ptr);
+}
+
+/* controller model */
+
+uint32_t host_usb_regs[0x200 / 4];
+
+#define REG(a) host_usb_regs[((a) - MSM_USB_BASE) / 4]
+
+static uint32_t ept_stat;			/* ENDPTSTAT */
+static uint32_t ept_complete;			/* ENDPTCOMPLETE */
+static struct ept_queue_item *ept_cur[32];	/* dTD being worked on */
+static unsigned ept_done[32];			/* bytes moved in it so far */
+static int irq_held;				/* completions wait for irq_release() */
+static unsigned primes, flushes;
+
+static struct ept_queue_head *qh(unsigned bit)
+{
+	return epts + (bit & 15) * 2 + (bit >= 16);
+}
+
+uint32_t host_readl(uintptr_t addr)
+{
+	if (addr < MSM_USB_BASE || addr >= MSM_USB_BASE + sizeof(host_usb_regs))
+		return *(volatile uint32_t *) addr;
+	if (addr == USB_ENDPTPRIME || addr == USB_ENDPTFLUSH)
+		return 0;
+	if (addr == USB_ENDPTSTAT)
+		return ept_stat;
+	if (addr == USB_ENDPTCOMPLETE)
+		return ept_complete;
+	return REG(addr);
+}
+
+void host_writel(uint32_t val, uintptr_t addr)
+{
+	unsigned b;
+
+	if (addr < MSM_USB_BASE || addr >= MSM_USB_BASE + sizeof(host_usb_regs)) {
+		*(volatile uint32_t *) addr = val;
+		return;
+	}
+	if (addr == USB_ENDPTPRIME) {
+		for (b = 0; b < 32; b++) {
+			if (!(val & (1u << b)))
+				continue;
+			primes++;
+			/* priming a busy endpoint is a driver bug */
+			CHECK(!(ept_stat & (1u << b)));
+			if (qh(b)->next & TERMINATE)
+				continue;
+			ept_cur[b] = (struct ept_queue_item *) (uintptr_t) qh(b)->next;
+			ept_done[b] = 0;
+			ept_stat |= 1u << b;
+		}
+	} else if (addr == USB_ENDPTFLUSH) {
+		for (b = 0; b < 32; b++)
+			if (val & (1u << b))
+				ept_cur[b] = 0;
+		ept_stat &= ~val;
+		flushes++;
+	} else if (addr == USB_ENDPTCOMPLETE) {
+		ept_complete &= ~val;
+	} else if (addr == USB_USBSTS) {
+		REG(addr) &= ~val;
+	} else {
+		REG(addr) = val;
+	}
+}
+
+static void irq_raise(void)
+{
+	if (!ept_complete || irq_held)
+		return;
+	REG(USB_USBSTS) |= STS_UI;
+	udc_interrupt(0);
+}
+
+static void irq_release(void)
+{
+	irq_held = 0;
+	irq_raise();
+}
+
+/* where byte 'off' of a dTD's buffer lives, and how much follows it in that page */
+static unsigned char *dtd_addr(struct ept_queue_item *item, unsigned off, unsigned *room)
+{
+	unsigned pos = (item->page0 & 0xfff) + off;
+	unsigned page = pos >> 12;
+	unsigned ptr = (&item->page0)[page];
+
+	CHECK(page < 5);
+	*room = 0x1000 - (pos & 0xfff);
+	if (page == 0)
+		return (unsigned char *) (uintptr_t) ptr + off;
+	CHECK((ptr & 0xfff) == 0);
+	return (unsigned char *) (uintptr_t) ptr + (pos & 0xfff);
+}
+
+static void dtd_copy(struct ept_queue_item *item, unsigned off, unsigned char *data,
+		     unsigned len, int out)
+{
+	unsigned char *p;
+	unsigned room, n;
+
+	while (len) {
+		p = dtd_addr(item, off, &room);
+		n = len < room ? len : room;
+		if (out)
+			memcpy(p, data, n);
+		else
+			memcpy(data, p, n);
+		off += n;
+		data += n;
+		len -= n;
+	}
+}
+
+/* moves 'len' bytes through the current dTD of endpoint bit 'b' */
+static void ept_packet(unsigned b, unsigned char *data, unsigned len, int out)
+{
+	struct ept_queue_item *item = ept_cur[b];
+	unsigned maxpkt = (qh(b)->config >> 16) & 0x7ff;
+	unsigned left = (item->info >> 16) & 0x7fff;
+
+	CHECK(item->info & INFO_ACTIVE);
+	/* dTDs end on packet boundaries, so a packet never spans two */
+	CHECK(len <= left);
+	dtd_copy(item, ept_done[b], data, len, out);
+	ept_done[b] += len;
+	left -= len;
+	item->info = (item->info & ~(0x7fff << 16)) | (left << 16);
+	if (left && len == maxpkt)
+		return;
+
+	/* retired; a short packet moves on to the next dTD as well */
+	item->info &= ~INFO_ACTIVE;
+	if (item->info & INFO_IOC)
+		ept_complete |= 1u << b;
+	qh(b)->next = item->next;
+	ept_done[b] = 0;
+	if (item->next & TERMINATE) {
+		ept_cur[b] = 0;
+		ept_stat &= ~(1u << b);
+	} else {
+		ept_cur[b] = (struct ept_queue_item *) (uintptr_t) item->next;
+	}
+	irq_raise();
+}
+
+/* the host sends one packet to OUT endpoint 'num'; 0 if it was NAKed */
+static int host_out(unsigned num, const void *data, unsigned len)
+{
+	if (!ept_cur[num])
+		return 0;
+	ept_packet(num, (unsigned char *) data, len, 1);
+	return 1;
+}
+
+/* the host reads one packet from IN endpoint 'num'; -1 if it was NAKed */
+static int host_in(unsigned num, void *data)
+{
+	unsigned b = num + 16;
+	unsigned left, n;
+
+	if (!ept_cur[b])
+		return -1;
+	left = (ept_cur[b]->info >> 16) & 0x7fff;
+	n = left < HOST_MAXPKT ? left : HOST_MAXPKT;
+	ept_packet(b, data, n, 0);
+	return n;
+}
+
+/* sends a whole transfer, ending it with a zero length packet if asked */
+static void host_transfer(unsigned num, const unsigned char *data, unsigned len, int zlp)
+{
+	unsigned n;
+
+	while (len) {
+		n = len < HOST_MAXPKT ? len : HOST_MAXPKT;
+		CHECK(host_out(num, data, n));
+		data += n;
+		len -= n;
+	}
+	if (zlp)
+		CHECK(host_out(num, data, 0));
+}
+
+static int ept_idle(unsigned b)
+{
+	return !ept_cur[b] && !(ept_stat & (1u << b));
+}
+
+/* what the host does while fastboot waits: read any reply, else send */
+
+static const unsigned char *host_data;
+static unsigned host_len, host_zlp;
+static unsigned char host_reply[MAX_RSP_SIZE];
+static unsigned host_reply_len;
+
+static void host_send(const void *data, unsigned len, int zlp)
+{
+	host_data = data;
+	host_len = len;
+	host_zlp = zlp;
+}
+
+void host_event_idle(void)
+{
+	int n;
+
+	n = host_in(1, host_reply + host_reply_len);
+	if (n >= 0) {
+		host_reply_len += n;
+		return;
+	}
+	if (host_len || host_zlp) {
+		n = host_len < HOST_MAXPKT ? host_len : HOST_MAXPKT;
+		CHECK(host_out(1, host_data, n));
+		host_data += n;
+		host_len -= n;
+		if (!n)
+			host_zlp = 0;
+		return;
+	}
+	fprintf(stderr, "fastboot is waiting for a host with nothing left to send\n");
+	exit(1);
+}
+
+time_t current_time(void)
+{
+	return 0;
+}
+
+/* requests queued directly on a second OUT endpoint */
+
+#define NREQ 8
+
+static struct udc_request *reqs[NREQ];
+static unsigned done_order[NREQ], done_actual[NREQ];
+static int done_status[NREQ];
+static unsigned ndone;
+
+static void test_complete(struct udc_request *req, unsigned actual, int status)
+{
+	done_order[ndone] = (unsigned) (uintptr_t) req->context;
+	done_actual[ndone] = actual;
+	done_status[ndone] = status;
+	ndone++;
+}
+
+static void queue(struct udc_endpoint *ept, unsigned i, unsigned char *buf, unsigned len)
+{
+	reqs[i]->buf = buf;
+	reqs[i]->length = len;
+	reqs[i]->complete = test_complete;
+	CHECK(udc_request_queue(ept, reqs[i]) == 0);
+}
+
+static void fill(unsigned char *p, unsigned len, unsigned seed)
+{
+	while (len--)
+		*p++ = (unsigned char) (seed = seed * 1103515245 + 12345) >> 16;
+}
+
+static void test_queue(struct udc_endpoint *ept, unsigned char *buf, unsigned char *pat)
+{
+	static const unsigned lens[] = { 1536, 40000, 16384, 512, 70000 };
+	unsigned b = 2, i, off, primed;
+
+	/* everything queued up front: one prime, completions in order */
+	ndone = 0;
+	primed = primes;
+	memset(buf, 0, 256 * 1024);
+	for (i = 0, off = 100; i < 5; off += lens[i] + 100, i++)
+		queue(ept, i, buf + off, lens[i]);
+	CHECK(primes == primed + 1);
+	for (i = 0, off = 0; i < 5; off += lens[i], i++)
+		host_transfer(b, pat + off, lens[i], 0);
+	CHECK(ndone == 5);
+	for (i = 0, off = 100; i < 5; off += lens[i] + 100, i++) {
+		CHECK(done_order[i] == i && done_actual[i] == lens[i] && done_status[i] == 0);
+		CHECK(!memcmp(buf + off, pat + off - 100 * (i + 1), lens[i]));
+		CHECK(buf[off - 1] == 0);
+	}
+	CHECK(primes == primed + 1);
+	CHECK(ept_idle(b));
+	printf("in order: ok\n");
+
+	/* a short packet in the second dTD of a request ends it there */
+	ndone = 0;
+	primed = flushes;
+	memset(buf, 0, 256 * 1024);
+	queue(ept, 0, buf, 40000);
+	queue(ept, 1, buf + 40000, 3000);
+	queue(ept, 2, buf + 43000, 1000);
+	host_transfer(b, pat, 20000, 0);
+	CHECK(ndone == 1 && done_actual[0] == 20000 && done_status[0] == 0);
+	CHECK(flushes == primed + 1);
+	host_transfer(b, pat + 20000, 3000, 0);
+	host_transfer(b, pat + 23000, 1000, 0);
+	CHECK(ndone == 3);
+	CHECK(done_order[1] == 1 && done_actual[1] == 3000);
+	CHECK(done_order[2] == 2 && done_actual[2] == 1000);
+	CHECK(!memcmp(buf, pat, 20000) && buf[20000] == 0);
+	CHECK(!memcmp(buf + 40000, pat + 20000, 4000));
+	CHECK(ept_idle(b));
+	printf("short packet: ok\n");
+
+	/* a zero length packet right after a full dTD */
+	ndone = 0;
+	queue(ept, 0, buf, 40000);
+	queue(ept, 1, buf + 40000, 512);
+	host_transfer(b, pat, 16384, 1);
+	host_transfer(b, pat, 512, 0);
+	CHECK(ndone == 2 && done_actual[0] == 16384 && done_actual[1] == 512);
+	CHECK(ept_idle(b));
+	printf("zero length packet: ok\n");
+
+	/* the controller retires its list before it sees the new link */
+	ndone = 0;
+	irq_held = 1;
+	queue(ept, 0, buf, 1000);
+	host_transfer(b, pat, 1000, 0);
+	CHECK(ept_idle(b) && ndone == 0);
+	queue(ept, 1, buf + 1000, 2000);
+	CHECK(!ept_idle(b));
+	irq_release();
+	CHECK(ndone == 1 && done_actual[0] == 1000);
+	host_transfer(b, pat + 1000, 2000, 0);
+	CHECK(ndone == 2 && done_order[1] == 1 && done_actual[1] == 2000);
+	CHECK(!memcmp(buf, pat, 3000));
+	printf("late link: ok\n");
+
+	/* cancelling fails everything queued, oldest first */
+	ndone = 0;
+	queue(ept, 0, buf, 5000);
+	queue(ept, 1, buf + 5000, 5000);
+	queue(ept, 2, buf + 10000, 5000);
+	CHECK(udc_request_cancel(ept, reqs[1]) < 0);
+	CHECK(udc_request_cancel(ept, reqs[0]) == 0);
+	CHECK(ndone == 3);
+	for (i = 0; i < 3; i++)
+		CHECK(done_order[i] == i && done_status[i] < 0);
+	CHECK(ept_idle(b));
+	CHECK(!host_out(b, pat, HOST_MAXPKT));
+	printf("cancel: ok\n");
+}
+
+static int rx_idle(void)
+{
+	unsigned i;
+
+	for (i = 0; i < USB_READ_DEPTH; i++)
+		if (rx_busy[i])
+			return 0;
+	return ept_idle(1);
+}
+
+static void test_fastboot(unsigned char *base, unsigned size, unsigned char *pat)
+{
+	int r;
+
+	/* ends in a short packet */
+	memset(base, 0, size);
+	host_send(pat, 300000, 0);
+	r = usb_read(base, 300000);
+	CHECK(r == 300000 && !memcmp(base, pat, 300000));
+	CHECK(rx_idle());
+	printf("usb_read: ok\n");
+
+	/* a multiple of the request size */
+	host_send(pat + 5, USB_READ_DEPTH * USB_READ_CHUNK * 3, 0);
+	r = usb_read(base, USB_READ_DEPTH * USB_READ_CHUNK * 3);
+	CHECK(r == USB_READ_DEPTH * USB_READ_CHUNK * 3 && !memcmp(base, pat + 5, r));
+	CHECK(rx_idle());
+	printf("usb_read, whole requests: ok\n");
+
+	/* the host stops early, inside the first request and in a later one */
+	memset(base, 0, size);
+	host_send(pat, 20000, 0);
+	r = usb_read(base, 300000);
+	CHECK(r == 20000 && !memcmp(base, pat, 20000) && base[20000] == 0);
+	CHECK(rx_idle());
+	host_send(pat, 3 * USB_READ_CHUNK, 1);
+	r = usb_read(base, 300000);
+	CHECK(r == 3 * USB_READ_CHUNK && !memcmp(base, pat, r));
+	CHECK(base[r] == 0);
+	CHECK(rx_idle());
+	printf("usb_read, host stops early: ok\n");
+
+	/* the next command lands in the command buffer */
+	memset(buffer, 0, sizeof(buffer));
+	host_send("getvar:version", 14, 0);
+	r = usb_read(buffer, MAX_RSP_SIZE);
+	CHECK(r == 14 && !memcmp(buffer, "getvar:version", 14));
+	CHECK(rx_idle());
+	printf("usb_read, command after short: ok\n");
+
+	host_reply_len = 0;
+	r = usb_write("OKAY0.5", 7);
+	CHECK(r == 7 && host_reply_len == 7 && !memcmp(host_reply, "OKAY0.5", 7));
+	CHECK(ept_idle(17));
+	printf("usb_write: ok\n");
+}
+
+int main(void)
+{
+	static struct udc_device dev;
+	unsigned size = 4 << 20, i;
+	unsigned char *base, *pat, *buf;
+	struct udc_endpoint *ept;
+
+	/* keep every buffer in the heap, below 4G */
+	mallopt(M_MMAP_MAX, 0);
+	base = memalign(4096, size);
+	buf = memalign(4096, 256 * 1024);
+	pat = malloc(size);
+	if (((uintptr_t) base + size) >> 32 || ((uintptr_t) buffer) >> 32) {
+		fprintf(stderr, "buffers above 4G, build with -no-pie\n");
+		return 1;
+	}
+	fill(pat, size, 1);
+
+	CHECK(udc_init(&dev) == 0);
+	CHECK(fastboot_init(base, size) == 0);
+
+	ept = udc_endpoint_alloc(UDC_TYPE_BULK_OUT, HOST_MAXPKT);
+	CHECK(ept);
+	for (i = 0; i < NREQ; i++) {
+		reqs[i] = udc_request_alloc();
+		reqs[i]->context = (void *) (uintptr_t) i;
+	}
+
+	test_queue(ept, buf, pat);
+	test_fastboot(base, size, pat);
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HOST_KERNEL_EVENT_H
+#define __HOST_KERNEL_EVENT_H
+
+/*
+ * Stand-in for the LK kernel/event.h in a single threaded host test
+ * program. Nothing else can run while event_wait() blocks, so it calls
+ * host_event_idle(), provided by the test, until the event is signaled;
+ * that is where the test plays the other side of whatever is awaited.
+ */
+
+#include <stdbool.h>
+
+#define EVENT_FLAG_AUTOUNSIGNAL 1
+
+typedef struct event {
+	bool signaled;
+	unsigned flags;
+} event_t;
+
+void host_event_idle(void);
+
+static inline void event_init(event_t *e, bool initial, unsigned flags)
+{
+	e->signaled = initial;
+	e->flags = flags;
+}
+
+static inline int event_wait(event_t *e)
+{
+	while (!e->signaled)
+		host_event_idle();
+	if (e->flags & EVENT_FLAG_AUTOUNSIGNAL)
+		e->signaled = false;
+	return 0;
+}
+
+static inline int event_signal(event_t *e, bool reschedule)
+{
+	e->signaled = true;
+	return 0;
+}
+
+static inline int event_unsignal(event_t *e)
+{
+	e->signaled = false;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HOST_KERNEL_THREAD_H
+#define __HOST_KERNEL_THREAD_H
+
+/*
+ * Stand-in for the LK kernel/thread.h, and the arch ops it pulls in, when
+ * driver code is built into a single threaded host test program. Threads
+ * are never run, critical sections are empty, and memory is coherent and
+ * mapped one to one, so the cache and MMU calls have nothing to do.
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include <malloc.h>
+#include <compiler.h>
+
+typedef unsigned long addr_t;
+typedef int (*thread_start_routine)(void *arg);
+typedef struct thread thread_t;
+
+#define DEFAULT_PRIORITY 16
+
+static inline thread_t *thread_create(const char *name, thread_start_routine entry,
+				      void *arg, int priority, size_t stack_size)
+{
+	return (thread_t *) entry;
+}
+
+static inline int thread_resume(thread_t *t) { return 0; }
+static inline void thread_sleep(time_t delay) { }
+
+static inline void enter_critical_section(void) { }
+static inline void exit_critical_section(void) { }
+
+static inline void arch_clean_cache_range(addr_t start, size_t len) { }
+static inline void arch_clean_invalidate_cache_range(addr_t start, size_t len) { }
+static inline void arch_invalidate_cache_range(addr_t start, size_t len) { }
+
+static inline uint32_t arm_mmu_virt2phy(uint32_t virt_addr) { return virt_addr; }
+
+#endif
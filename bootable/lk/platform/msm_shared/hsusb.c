@@ -37,6 +37,7 @@
 #include <platform/timer.h>
 #include <kernel/thread.h>
 #include <reg.h>
+#include <lib/slab.h>
 
 #include <dev/udc.h>
 
@@ -123,16 +124,28 @@ __WEAK void hsusb_clock_init(void)
 
 #define usb_status(a,b)
 
+/* bytes per dTD: four pages, so the five page pointers cover any offset
+ * and every dTD but the last ends on a max packet boundary
+ */
+#define DTD_MAX_BYTES	(4 * 4096)
+
 struct usb_request {
 	struct udc_request req;
-	struct ept_queue_item *item;
+	struct ept_queue_item *item;	/* dTD chain, 'count' long */
+	unsigned count;
+	unsigned nitems;		/* dTDs allocated */
+	struct usb_request *next;	/* endpoint queue */
 };
 
+/* requests are kept in the order queued; 'req' is the one the
+ * controller is working on, 'last' the one new dTDs get linked to
+ */
 struct udc_endpoint {
 	struct udc_endpoint *next;
 	unsigned bit;
 	struct ept_queue_head *head;
 	struct usb_request *req;
+	struct usb_request *last;
 	unsigned char num;
 	unsigned char in;
 	unsigned short maxpkt;
@@ -160,6 +173,7 @@ struct udc_endpoint *_udc_endpoint_alloc(unsigned num, unsigned in,
 	ept->num = num;
 	ept->in = !!in;
 	ept->req = 0;
+	ept->last = 0;
 
 	cfg = CONFIG_MAX_PKT(max_pkt) | CONFIG_ZLT;
 
@@ -244,109 +258,276 @@ static void endpoint_enable(struct udc_endpoint *ept, unsigned yes)
 struct udc_request *udc_request_alloc(void)
 {
 	struct usb_request *req;
-	req = malloc(sizeof(*req));
+	req = slab_alloc(sizeof(*req), 0);
 	req->req.buf = 0;
 	req->req.length = 0;
 	req->item = memalign(32, 32);
+	req->nitems = 1;
+	req->count = 0;
+	req->next = 0;
 	return &req->req;
 }
 
-void udc_request_free(struct udc_request *req)
+void udc_request_free(struct udc_request *_req)
 {
-	free(req);
+	struct usb_request *req = (struct usb_request *)_req;
+	free(req->item);
+	slab_free(req);
 }
 
-int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
+static int req_reserve(struct usb_request *req, unsigned count)
 {
-	struct usb_request *req = (struct usb_request *)_req;
-	struct ept_queue_item *item = req->item;
-	uint32_t phys = arm_mmu_virt2phy((uint32_t)req->req.buf);
+	struct ept_queue_item *item;
+
+	if (count <= req->nitems)
+		return 0;
+	item = memalign(32, count * sizeof(struct ept_queue_item));
+	if (!item)
+		return -1;
+	free(req->item);
+	req->item = item;
+	req->nitems = count;
+	return 0;
+}
 
-	item->next = TERMINATE;
-	item->info = INFO_BYTES(req->req.length) | INFO_IOC | INFO_ACTIVE;
-	item->page0 = phys;
-	item->page1 = (phys & 0xfffff000) + 0x1000;
-	item->page2 = (phys & 0xfffff000) + 0x2000;
-	item->page3 = (phys & 0xfffff000) + 0x3000;
-	item->page4 = (phys & 0xfffff000) + 0x4000;
+/* bytes the n'th dTD of a request was set up for */
+static unsigned dtd_bytes(struct usb_request *req, unsigned n)
+{
+	if (n + 1 < req->count)
+		return DTD_MAX_BYTES;
+	return req->req.length - n * DTD_MAX_BYTES;
+}
 
-	enter_critical_section();
-	ept->head->next = (unsigned)item;
+static void ept_prime(struct udc_endpoint *ept, struct usb_request *req)
+{
+	ept->head->next = (unsigned)req->item;
 	ept->head->info = 0;
-	ept->req = req;
-
-	arch_clean_invalidate_cache_range((addr_t) ept,
-					  sizeof(struct udc_endpoint));
 	arch_clean_invalidate_cache_range((addr_t) ept->head,
 					  sizeof(struct ept_queue_head));
-	arch_clean_invalidate_cache_range((addr_t) ept->req,
-					  sizeof(struct usb_request));
-	arch_clean_invalidate_cache_range((addr_t) req->req.buf,
-					  req->req.length);
-	arch_clean_invalidate_cache_range((addr_t) ept->req->item,
-					  sizeof(struct ept_queue_item));
+	writel(ept->bit, USB_ENDPTPRIME);
+}
 
-	DBG("ept%d %s queue req=%p\n", ept->num, ept->in ? "in" : "out", req);
+static void ept_flush(struct udc_endpoint *ept)
+{
+	writel(ept->bit, USB_ENDPTFLUSH);
+	while (readl(USB_ENDPTFLUSH) & ept->bit) ;
+}
 
-	writel(ept->bit, USB_ENDPTPRIME);
-	exit_critical_section();
-	return 0;
+/* Is the endpoint still working through its dTD list? */
+static int ept_busy(struct udc_endpoint *ept)
+{
+	unsigned cmd, stat;
+
+	if (readl(USB_ENDPTPRIME) & ept->bit)
+		return 1;
+	do {
+		cmd = readl(USB_USBCMD);
+		writel(cmd | USBCMD_ATDTW, USB_USBCMD);
+		stat = readl(USB_ENDPTSTAT);
+	} while (!(readl(USB_USBCMD) & USBCMD_ATDTW));
+	writel(readl(USB_USBCMD) & ~USBCMD_ATDTW, USB_USBCMD);
+	return !!(stat & ept->bit);
 }
 
-static void handle_ept_complete(struct udc_endpoint *ept)
+/*
+ * Builds the request's dTD chain and adds it to the endpoint queue. If the
+ * endpoint already has requests in flight the chain is linked behind the
+ * last one, so the controller moves on to it without a new prime.
+ */
+int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 {
+	struct usb_request *req = (struct usb_request *)_req;
 	struct ept_queue_item *item;
-	unsigned actual;
-	int status;
-	struct usb_request *req;
+	struct usb_request *last;
+	unsigned len = req->req.length;
+	unsigned count = len ? (len + DTD_MAX_BYTES - 1) / DTD_MAX_BYTES : 1;
+	uint32_t phys = arm_mmu_virt2phy((uint32_t)req->req.buf);
+	unsigned n, i;
 
-	DBG("ept%d %s complete req=%p\n",
-	    ept->num, ept->in ? "in" : "out", ept->req);
+	if (req_reserve(req, count))
+		return -1;
 
-	arch_clean_invalidate_cache_range((addr_t) ept,
-					  sizeof(struct udc_endpoint));
-	arch_clean_invalidate_cache_range((addr_t) ept->req,
-					  sizeof(struct usb_request));
+	for (i = 0; i < count; i++) {
+		item = req->item + i;
+		n = (len > DTD_MAX_BYTES) ? DTD_MAX_BYTES : len;
 
-	req = ept->req;
-	if (req) {
+		item->next = (i + 1 < count) ? (unsigned)(item + 1) : TERMINATE;
+		/* OUT dTDs all interrupt, so a short packet part way
+		 * through a chain is seen straight away
+		 */
+		item->info = INFO_BYTES(n) | INFO_ACTIVE;
+		if (!ept->in || i + 1 == count)
+			item->info |= INFO_IOC;
+		item->page0 = phys;
+		item->page1 = (phys & 0xfffff000) + 0x1000;
+		item->page2 = (phys & 0xfffff000) + 0x2000;
+		item->page3 = (phys & 0xfffff000) + 0x3000;
+		item->page4 = (phys & 0xfffff000) + 0x4000;
+
+		phys += n;
+		len -= n;
+	}
+	req->count = count;
+	req->next = 0;
+
+	if (ept->in)
+		arch_clean_cache_range((addr_t) req->req.buf,
+				       req->req.length);
+	else
+		arch_clean_invalidate_cache_range((addr_t) req->req.buf,
+						  req->req.length);
+	arch_clean_invalidate_cache_range((addr_t) req->item,
+					  count * sizeof(struct ept_queue_item));
+
+	enter_critical_section();
+
+	/* control transfers never overlap; a new one replaces the old */
+	if (ept->num == 0)
 		ept->req = 0;
 
-		item = req->item;
+	DBG("ept%d %s queue req=%p\n", ept->num, ept->in ? "in" : "out", req);
 
-		/* For some reason we are getting the notification for
-		 * transfer completion before the active bit has cleared.
-		 * HACK: wait for the ACTIVE bit to clear:
+	if (!ept->req) {
+		ept->req = ept->last = req;
+		ept_prime(ept, req);
+	} else {
+		last = ept->last;
+		item = last->item + last->count - 1;
+		item->next = (unsigned)req->item;
+		arch_clean_invalidate_cache_range((addr_t) item,
+						  sizeof(struct ept_queue_item));
+		last->next = req;
+		ept->last = req;
+
+		/* the controller may have retired its list before it saw
+		 * the new link
 		 */
-		do {
-			/* Must clean/invalidate cached item data before checking
-			 * the status every time.
+		if (!ept_busy(ept))
+			ept_prime(ept, req);
+	}
+
+	exit_critical_section();
+	return 0;
+}
+
+/*
+ * Checks the request at the head of the queue. Returns 1 if it is done,
+ * with the byte count and status filled in, 0 if the controller is still
+ * on it.
+ */
+static int req_retired(struct udc_endpoint *ept, struct usb_request *req,
+		       unsigned *actual, int *status, int *is_short)
+{
+	struct ept_queue_item *item;
+	unsigned i, left, info;
+
+	*actual = 0;
+	*status = 0;
+	*is_short = 0;
+	for (i = 0; i < req->count; i++) {
+		item = req->item + i;
+		arch_clean_invalidate_cache_range((addr_t) item,
+						  sizeof(struct ept_queue_item));
+		info = readl(&item->info);
+
+		if (info & INFO_ACTIVE) {
+			/* For some reason we are getting the notification
+			 * for transfer completion before the active bit has
+			 * cleared. If the endpoint has gone idle the dTD is
+			 * done, so wait for the bit; otherwise the controller
+			 * really is still on it.
 			 */
-			arch_clean_invalidate_cache_range((addr_t) item,
-							  sizeof(struct
-								 ept_queue_item));
+			if (ept_busy(ept))
+				return 0;
+			do {
+				arch_clean_invalidate_cache_range((addr_t) item,
+						sizeof(struct ept_queue_item));
+				info = readl(&item->info);
+			} while (info & INFO_ACTIVE);
 		}
-		while (readl(&(item->info)) & INFO_ACTIVE);
 
-		arch_clean_invalidate_cache_range((addr_t) req->req.buf,
-						  req->req.length);
-
-		if (item->info & 0xff) {
-			actual = 0;
-			status = -1;
+		if (info & 0xff) {
+			*status = -1;
 			dprintf(INFO, "EP%d/%s FAIL nfo=%x pg0=%x\n",
-				ept->num, ept->in ? "in" : "out", item->info,
+				ept->num, ept->in ? "in" : "out", info,
 				item->page0);
-		} else {
-			actual =
-			    req->req.length - ((item->info >> 16) & 0x7fff);
-			status = 0;
+			return 1;
+		}
+
+		left = (info >> 16) & 0x7fff;
+		*actual += dtd_bytes(req, i) - left;
+		if (left) {
+			*is_short = (i + 1 < req->count);
+			return 1;
+		}
+	}
+	return 1;
+}
+
+static void handle_ept_complete(struct udc_endpoint *ept)
+{
+	struct usb_request *req;
+	unsigned actual;
+	int status, is_short;
+
+	while ((req = ept->req)) {
+		if (!req_retired(ept, req, &actual, &status, &is_short))
+			break;
+
+		DBG("ept%d %s complete req=%p\n",
+		    ept->num, ept->in ? "in" : "out", req);
+
+		ept->req = req->next;
+
+		/* a short packet ends the request, but the controller would
+		 * go on filling the rest of its dTDs: stop the endpoint and
+		 * restart it at the next request
+		 */
+		if (is_short) {
+			ept_flush(ept);
+			if (ept->req)
+				ept_prime(ept, ept->req);
 		}
+
+		if (!ept->in && actual)
+			arch_invalidate_cache_range((addr_t) req->req.buf,
+						    actual);
 		if (req->req.complete)
 			req->req.complete(&req->req, actual, status);
 	}
 }
 
+/* Fails every queued request; used on bus reset. */
+static void ept_fail_all(struct udc_endpoint *ept)
+{
+	struct usb_request *req;
+
+	while ((req = ept->req)) {
+		ept->req = req->next;
+		if (req->req.complete)
+			req->req.complete(&req->req, 0, -1);
+	}
+}
+
+/*
+ * Cancels 'req', which must be the oldest request on the endpoint, and
+ * everything queued behind it; each completes with status -1.
+ */
+int udc_request_cancel(struct udc_endpoint *ept, struct udc_request *_req)
+{
+	struct usb_request *req = (struct usb_request *)_req;
+
+	enter_critical_section();
+	if (ept->req != req) {
+		exit_critical_section();
+		return -1;
+	}
+	ept_flush(ept);
+	ept_fail_all(ept);
+	exit_critical_section();
+	return 0;
+}
+
 static const char *reqname(unsigned r)
 {
 	switch (r) {
@@ -716,15 +897,8 @@ enum handler_return udc_interrupt(void *arg)
 		the_gadget->notify(the_gadget, UDC_EVENT_OFFLINE);
 
 		/* error out any pending reqs */
-		for (ept = ept_list; ept; ept = ept->next) {
-			/* ensure that ept_complete considers
-			 * this to be an error state
-			 */
-			if (ept->req) {
-				ept->req->item->info = INFO_HALTED;
-				handle_ept_complete(ept);
-			}
-		}
+		for (ept = ept_list; ept; ept = ept->next)
+			ept_fail_all(ept);
 		usb_status(0, usb_highspeed);
 	}
 	if (n & STS_SLI) {
@@ -85,11 +85,30 @@ image_verify(unsigned char *image_ptr,
 	     unsigned char *signature_ptr,
 	     unsigned int image_size, unsigned hash_type)
 {
+	unsigned int digest[8];
+
+	/*
+	 * Calculate hash of image for comparison
+	 */
+	hash_find(image_ptr, image_size, (unsigned char *)&digest, hash_type);
+
+	return image_verify_digest((unsigned char *)&digest, signature_ptr,
+				   hash_type);
+}
+
+/*
+ * Same as image_verify(), for callers that hashed the image themselves
+ * (e.g. while loading it). Expects the digest of the image and a pointer
+ * to the start of sig.
+ */
+int
+image_verify_digest(unsigned char *digest,
+		    unsigned char *signature_ptr, unsigned hash_type)
+{
 
 	int ret = -1;
 	int auth = 0;
 	unsigned char *plain_text = NULL;
-	unsigned int digest[8];
 	unsigned int hash_size;
 
 	plain_text = (unsigned char *)calloc(sizeof(char), SIGNATURE_SIZE);
@@ -104,12 +123,8 @@ image_verify(unsigned char *image_ptr,
 		goto cleanup;
 	}
 
-	/*
-	 * Calculate hash of image for comparison
-	 */
 	hash_size =
 	    (hash_type == CRYPTO_AUTH_ALG_SHA256) ? SHA256_SIZE : SHA1_SIZE;
-	hash_find(image_ptr, image_size, (unsigned char *)&digest, hash_type);
 	if (memcmp(plain_text, digest, hash_size) != 0) {
 		dprintf(CRITICAL,
 			"ERROR: Image Invalid! Please use another image!\n");
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014 The LK Project Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CRC32_H__
+#define __CRC32_H__
+
+#include <sys/types.h>
+
+/*
+ * IEEE 802.3 CRC32 (reflected polynomial 0xEDB88320), as used by GPT.
+ *
+ * The incremental interface lets a caller checksum data that arrives in
+ * pieces:
+ *
+ *	struct crc32_ctx ctx;
+ *	crc32_init(&ctx);
+ *	crc32_update(&ctx, buf1, len1);
+ *	crc32_update(&ctx, buf2, len2);
+ *	crc = crc32_final(&ctx);
+ */
+struct crc32_ctx {
+	uint32_t crc;
+};
+
+void crc32_init(struct crc32_ctx *ctx);
+void crc32_update(struct crc32_ctx *ctx, const void *buf, size_t len);
+uint32_t crc32_final(struct crc32_ctx *ctx);
+
+/* One-shot CRC32 of a buffer */
+uint32_t crc32(const void *buf, size_t len);
+
+#endif
@@ -29,6 +29,8 @@
 #ifndef __CRYPTO_HASH_H__
 #define __CRYPYO_HASH_H__
 
+#include <sha.h>
+
 #ifndef NULL
 #define NULL		0
 #endif
@@ -79,6 +81,29 @@ typedef struct {
 	unsigned char flags;
 } crypto_SHA256_ctx;
 
+/* State for hashing data that arrives in pieces, see hash_init() */
+typedef struct {
+	unsigned char auth_alg;
+	crypto_engine_type ce_type;
+	bool first;
+	union {
+		crypto_SHA1_ctx sha1;
+		crypto_SHA256_ctx sha256;
+	} hw;
+	union {
+		SHA_CTX sha1;
+		SHA256_CTX sha256;
+	} sw;
+} hash_ctx;
+
+void hash_find(unsigned char *addr, unsigned int size, unsigned char *digest,
+	       unsigned char auth_alg);
+
+void hash_init(hash_ctx *ctx, unsigned char auth_alg);
+crypto_result_type hash_update(hash_ctx *ctx, unsigned char *addr,
+			       unsigned int size, bool last);
+void hash_final(hash_ctx *ctx, unsigned char *digest);
+
 extern void crypto_eng_reset(void);
 
 extern void crypto_eng_init(void);
@@ -592,6 +592,8 @@ unsigned int mmc_boot_write_to_card(struct mmc_boot_host *host,
 
 unsigned int mmc_erase_card(unsigned long long data_addr,
 			    unsigned long long data_len);
+unsigned long long mmc_get_erase_group_size(void);
+int mmc_erase_reads_zero(void);
 
 struct mmc_boot_host *get_mmc_host(void);
 struct mmc_boot_card *get_mmc_card(void);
@@ -38,6 +38,7 @@
 #include <platform/iomap.h>
 #include <platform/clock.h>
 #include <platform/timer.h>
+#include <arch/ops.h>
 
 extern void mdp_disable(void);
 extern int mipi_dsi_cmd_config(struct fbcon_config *mipi_fb_cfg,
@@ -748,6 +749,8 @@ config_dsi_cmd_mode(unsigned short disp_width, unsigned short disp_height,
 	writel(0x00000040, DSI_ERR_INT_MASK0);
 	writel(0x1, DSI_EOT_PACKET_CTRL);
 	// writel(0x0, MDP_OVERLAYPROC0_START);
+	/* MDP fetches the frame from memory, which may be cached */
+	arch_clean_cache_range(MIPI_FB_ADDR, img_width * img_height * ystride);
 	mdp_start_dma();
 	mdelay(10);
 	writel(0x1, DSI_CMD_MODE_MDP_SW_TRIGGER);
@@ -2737,6 +2737,34 @@ static unsigned int mmc_boot_send_erase(struct mmc_boot_card *card)
 	return MMC_BOOT_E_SUCCESS;
 }
 
+/*
+ * Size in bytes of the card's erase group. Erases are carried out a
+ * whole group at a time, so callers that must not disturb neighbouring
+ * data should only hand mmc_erase_card() group aligned ranges.
+ */
+unsigned long long mmc_get_erase_group_size(void)
+{
+	if (ext_csd_buf[MMC_BOOT_EXT_ERASE_GROUP_DEF])
+		return (unsigned long long)
+		    ext_csd_buf[MMC_BOOT_EXT_HC_ERASE_GRP_SIZE] * 512 * 1024;
+
+	return (unsigned long long)(mmc_card.csd.erase_grp_size + 1) *
+	    (mmc_card.csd.erase_grp_mult + 1) * 512;
+}
+
+/*
+ * Returns 1 if erased regions of the card are known to read back as
+ * zeroes, so an erase can stand in for writing zeroes.
+ */
+int mmc_erase_reads_zero(void)
+{
+	if (mmc_card.type != MMC_BOOT_TYPE_MMCHC &&
+	    mmc_card.type != MMC_BOOT_TYPE_STD_MMC)
+		return 0;
+
+	return ext_csd_buf[MMC_BOOT_EXT_ERASE_MEM_CONT] == 0;
+}
+
 /*
  * Function to erase data on the eMMC card
  */
@@ -2752,15 +2780,7 @@ mmc_erase_card(unsigned long long data_addr, unsigned long long size)
 	/* Converting size to sectors */
 	size = size / 512;
 
-	if (ext_csd_buf[MMC_BOOT_EXT_ERASE_GROUP_DEF]) {
-		erase_grp_size =
-		    (512 * ext_csd_buf[MMC_BOOT_EXT_HC_ERASE_GRP_SIZE] * 1024);
-		erase_grp_size = erase_grp_size / 512;
-	} else {
-		erase_grp_size = (mmc_card.csd.erase_grp_size + 1) *
-		    (mmc_card.csd.erase_grp_mult + 1);
-	}
-
+	erase_grp_size = mmc_get_erase_group_size() / 512;
 	if (erase_grp_size == 0) {
 		return MMC_BOOT_E_FAILURE;
 	}
@@ -30,6 +30,7 @@
 #include <string.h>
 #include "mmc.h"
 #include "partition_parser.h"
+#include "crc32.h"
 
 char *ext3_partitions[] =
     { "system", "userdata", "persist", "cache", "tombstones" };
@@ -413,57 +414,6 @@ write_mbr(unsigned size, unsigned char *mbrImage,
 	return ret;
 }
 
-/*
- * A8h reflected is 15h, i.e. 10101000 <--> 00010101
-*/
-int reflect(int data, int len)
-{
-	int ref = 0;
-
-	for (int i = 0; i < len; i++) {
-		if (data & 0x1) {
-			ref |= (1 << ((len - 1) - i));
-		}
-		data = (data >> 1);
-	}
-
-	return ref;
-}
-
-/*
-* Function to calculate the CRC32
-*/
-unsigned int calculate_crc32(unsigned char *buffer, int len)
-{
-	int byte_length = 8;	/*length of unit (i.e. byte) */
-	int msb = 0;
-	int polynomial = 0x104C11DB7;	/* IEEE 32bit polynomial */
-	unsigned int regs = 0xFFFFFFFF;	/* init to all ones */
-	int regs_mask = 0xFFFFFFFF;	/* ensure only 32 bit answer */
-	int regs_msb = 0;
-	unsigned int reflected_regs;
-
-	for (int i = 0; i < len; i++) {
-		int data_byte = buffer[i];
-		data_byte = reflect(data_byte, 8);
-		for (int j = 0; j < byte_length; j++) {
-			msb = data_byte >> (byte_length - 1);	/* get MSB */
-			msb &= 1;	/* ensure just 1 bit */
-			regs_msb = (regs >> 31) & 1;	/* MSB of regs */
-			regs = regs << 1;	/* shift regs for CRC-CCITT */
-			if (regs_msb ^ msb) {	/* MSB is a 1 */
-				regs = regs ^ polynomial;	/* XOR with generator poly */
-			}
-			regs = regs & regs_mask;	/* Mask off excess upper bits */
-			data_byte <<= 1;	/* get to next bit */
-		}
-	}
-	regs = regs & regs_mask;
-	reflected_regs = reflect(regs, 32) ^ 0xFFFFFFFF;
-
-	return reflected_regs;
-}
-
 /*
  * Write the GPT Partition Entry Array to the MMC.
  */
@@ -547,21 +497,21 @@ patch_gpt(unsigned char *gptImage,
 
 	/* Updating CRC of the Partition entry array in both headers */
 	partition_entry_array_start = primary_gpt_header + BLOCK_SIZE;
-	crc_value = calculate_crc32(partition_entry_array_start,
-				    max_part_count * part_entry_size);
+	crc_value = crc32(partition_entry_array_start,
+			  max_part_count * part_entry_size);
 	PUT_LONG(primary_gpt_header + PARTITION_CRC_OFFSET, crc_value);
 
-	crc_value = calculate_crc32(partition_entry_array_start + array_size,
-				    max_part_count * part_entry_size);
+	crc_value = crc32(partition_entry_array_start + array_size,
+			  max_part_count * part_entry_size);
 	PUT_LONG(secondary_gpt_header + PARTITION_CRC_OFFSET, crc_value);
 
 	/* Clearing CRC fields to calculate */
 	PUT_LONG(primary_gpt_header + HEADER_CRC_OFFSET, 0);
-	crc_value = calculate_crc32(primary_gpt_header, 92);
+	crc_value = crc32(primary_gpt_header, 92);
 	PUT_LONG(primary_gpt_header + HEADER_CRC_OFFSET, crc_value);
 
 	PUT_LONG(secondary_gpt_header + HEADER_CRC_OFFSET, 0);
-	crc_value = (calculate_crc32(secondary_gpt_header, 92));
+	crc_value = (crc32(secondary_gpt_header, 92));
 	PUT_LONG(secondary_gpt_header + HEADER_CRC_OFFSET, crc_value);
 
 }
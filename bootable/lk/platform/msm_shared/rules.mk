@@ -5,6 +5,7 @@ INCLUDES += \
 
 DEFINES += $(TARGET_XRES)
 DEFINES += $(TARGET_YRES)
+DEFINES += WITH_CRC32=1
 
 OBJS += \
 	$(LOCAL_DIR)/debug.o \
@@ -15,6 +16,7 @@ OBJS += \
 	$(LOCAL_DIR)/jtag.o \
 	$(LOCAL_DIR)/nand.o \
 	$(LOCAL_DIR)/mmc.o \
+	$(LOCAL_DIR)/crc32.o \
 	$(LOCAL_DIR)/partition_parser.o
 
 ifeq ($(PLATFORM),msm8x60)
@@ -50,6 +50,132 @@
 
 static platform_timer_callback timer_callback;
 static void *timer_arg;
+
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/*
+ * The DGT counts freely and time is read from it, widened to 64 bits by
+ * counting its wraps. Events are set with the match register. While no
+ * event is due sooner, the match is kept at most half a wrap ahead, so
+ * the counter is always read often enough to catch every wrap.
+ */
+#define DGT_HALF_WRAP	0x80000000ULL
+#define DGT_MIN_TICKS	16
+
+static bool dgt_running;
+static uint32_t dgt_last;
+static uint64_t dgt_wraps;
+static uint32_t ticks_per_ms;
+static uint64_t timer_deadline;		/* in DGT counts, 0 if none */
+
+static void wait_for_timer_op(void);
+
+/* called in a critical section */
+static uint64_t dgt_read(void)
+{
+	uint32_t count;
+
+	if (!dgt_running) {
+		ticks_per_ms = platform_tick_rate() / 1000;
+		writel(0, DGT_CLEAR);
+		wait_for_timer_op();
+		writel(0xffffffff, DGT_MATCH_VAL);
+		writel(DGT_ENABLE_EN, DGT_ENABLE);
+		wait_for_timer_op();
+		dgt_running = true;
+	}
+
+	count = readl(DGT_COUNT_VAL);
+	if (count < dgt_last)
+		dgt_wraps += 1ULL << 32;
+	dgt_last = count;
+	return dgt_wraps + count;
+}
+
+/* program the match for 'when', or sooner to keep up with the wraps */
+static void dgt_set_match(uint64_t when)
+{
+	uint64_t now = dgt_read();
+
+	if (when > now + DGT_HALF_WRAP)
+		when = now + DGT_HALF_WRAP;
+
+	/* a match the counter has already passed would not fire until the
+	 * next wrap; the interrupt handler copes with an early or extra one
+	 */
+	for (;;) {
+		writel((uint32_t) when, DGT_MATCH_VAL);
+		now = dgt_read();
+		if (now < when)
+			break;
+		when = now + DGT_MIN_TICKS;
+	}
+}
+
+static enum handler_return timer_irq(void *arg)
+{
+	uint64_t now = dgt_read();
+
+	if (!timer_deadline || now < timer_deadline) {
+		/* early, or only keeping track of the wraps */
+		dgt_set_match(timer_deadline ? timer_deadline : now + DGT_HALF_WRAP);
+		return INT_NO_RESCHEDULE;
+	}
+
+	/* the callback sets the next event, if there is one */
+	timer_deadline = 0;
+	dgt_set_match(now + DGT_HALF_WRAP);
+	return timer_callback(timer_arg, now / ticks_per_ms);
+}
+
+status_t
+platform_set_oneshot_timer(platform_timer_callback callback,
+			   void *arg, time_t interval)
+{
+	enter_critical_section();
+
+	if (!timer_callback) {
+		register_int_handler(INT_DEBUG_TIMER_EXP, timer_irq, 0);
+		unmask_interrupt(INT_DEBUG_TIMER_EXP);
+	}
+	timer_callback = callback;
+	timer_arg = arg;
+
+	timer_deadline = dgt_read() + (uint64_t) interval * ticks_per_ms;
+	dgt_set_match(timer_deadline);
+
+	exit_critical_section();
+	return 0;
+}
+
+void platform_stop_timer(void)
+{
+	enter_critical_section();
+	timer_deadline = 0;
+	dgt_set_match(dgt_read() + DGT_HALF_WRAP);
+	exit_critical_section();
+}
+
+time_t current_time(void)
+{
+	time_t t;
+
+	enter_critical_section();
+	t = dgt_read() / ticks_per_ms;
+	exit_critical_section();
+	return t;
+}
+
+/* Return current time in micro seconds */
+bigtime_t current_time_hires(void)
+{
+	bigtime_t t;
+
+	enter_critical_section();
+	t = dgt_read() * 1000 / ticks_per_ms;
+	exit_critical_section();
+	return t;
+}
+#else
 static time_t timer_interval;
 
 static volatile uint32_t ticks;
@@ -88,6 +214,13 @@ time_t current_time(void)
 	return ticks;
 }
 
+/* Return current time in micro seconds */
+bigtime_t current_time_hires(void)
+{
+	return ticks * 1000ULL;
+}
+#endif
+
 static void wait_for_timer_op(void)
 {
 	while (readl(SPSS_TIMER_STATUS) & SPSS_TIMER_STATUS_DGT_EN) ;
@@ -130,9 +263,3 @@ void udelay(unsigned usecs)
 	writel(0, GPT_ENABLE);
 	writel(0, GPT_CLEAR);
 }
-
-/* Return current time in micro seconds */
-bigtime_t current_time_hires(void)
-{
-	return ticks * 1000ULL;
-}
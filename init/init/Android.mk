@@ -0,0 +1,112 @@
+# Copyright 2005 The Android Open Source Project
+
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	builtins.c \
+	init.c \
+	devices.c \
+	property_service.c \
+	property_watch.c \
+	util.c \
+	parser.c \
+	logo.c \
+	keychords.c \
+	signal_handler.c \
+	init_parser.c \
+	init_cache.c \
+	arena.c \
+	restorecon.c \
+	ueventd.c \
+	ueventd_parser.c \
+	watchdogd.c
+
+ifeq ($(strip $(INIT_BOOTCHART)),true)
+LOCAL_SRC_FILES += bootchart.c
+LOCAL_CFLAGS    += -DBOOTCHART=1
+endif
+
+ifeq ($(strip $(INIT_PERSISTENT_PROPERTY_WRITEBACK)),true)
+LOCAL_CFLAGS += -DPERSISTENT_PROPERTY_WRITEBACK=1
+endif
+
+ifneq (,$(filter userdebug eng,$(TARGET_BUILD_VARIANT)))
+LOCAL_CFLAGS += -DALLOW_LOCAL_PROP_OVERRIDE=1
+endif
+
+LOCAL_MODULE:= init
+
+LOCAL_FORCE_STATIC_EXECUTABLE := true
+LOCAL_MODULE_PATH := $(TARGET_ROOT_OUT)
+LOCAL_UNSTRIPPED_PATH := $(TARGET_ROOT_OUT_UNSTRIPPED)
+
+LOCAL_STATIC_LIBRARIES := \
+	libfs_mgr \
+	liblogwrapper \
+	libcutils \
+	liblog \
+	libc \
+	libselinux \
+	libmincrypt \
+	libext4_utils_static
+
+include $(BUILD_EXECUTABLE)
+
+# Make a symlink from /sbin/ueventd and /sbin/watchdogd to /init
+SYMLINKS := \
+	$(TARGET_ROOT_OUT)/sbin/ueventd \
+	$(TARGET_ROOT_OUT)/sbin/watchdogd
+
+$(SYMLINKS): INIT_BINARY := $(LOCAL_MODULE)
+$(SYMLINKS): $(LOCAL_INSTALLED_MODULE) $(LOCAL_PATH)/Android.mk
+	@echo "Symlink: $@ -> ../$(INIT_BINARY)"
+	@mkdir -p $(dir $@)
+	@rm -rf $@
+	$(hide) ln -sf ../$(INIT_BINARY) $@
+
+ALL_DEFAULT_INSTALLED_MODULES += $(SYMLINKS)
+
+# We need this so that the installed files could be picked up based on the
+# local module name
+ALL_MODULES.$(LOCAL_MODULE).INSTALLED := \
+    $(ALL_MODULES.$(LOCAL_MODULE).INSTALLED) $(SYMLINKS)
+
+# Host build of the rc parser that compiles /init.rc.cache
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	host/init_rc_compile.c \
+	host/init_host.c \
+	init_parser.c \
+	arena.c \
+	parser.c
+
+LOCAL_MODULE:= init_rc_compile
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/host
+LOCAL_STATIC_LIBRARIES := libcutils liblog libselinux
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Compile the rc files in the ramdisk so init does not have to parse them
+# at boot. Imports are expanded with ro.hardware set to the board name and
+# whatever INIT_RC_CACHE_PROPERTIES (name=value ...) adds; if the device
+# ends up with other values the cache is stale and init parses as before.
+INIT_RC_CACHE := $(TARGET_ROOT_OUT)/init.rc.cache
+INIT_RC_CACHE_INPUTS := \
+	$(TARGET_ROOT_OUT)/init.rc \
+	$(TARGET_ROOT_OUT)/init.environ.rc \
+	$(filter $(TARGET_ROOT_OUT)/%.rc, \
+	    $(foreach cf,$(PRODUCT_COPY_FILES),$(PRODUCT_OUT)/$(call word-colon,2,$(cf))))
+
+$(INIT_RC_CACHE): PRIVATE_PROPERTIES := \
+	$(addprefix -p ,ro.hardware=$(TARGET_BOOTLOADER_BOARD_NAME) $(INIT_RC_CACHE_PROPERTIES))
+$(INIT_RC_CACHE): $(HOST_OUT_EXECUTABLES)/init_rc_compile $(INIT_RC_CACHE_INPUTS)
+	@echo "Compile rc: $@"
+	@mkdir -p $(dir $@)
+	$(hide) $< $(PRIVATE_PROPERTIES) $(TARGET_ROOT_OUT) $@ > /dev/null
+
+ALL_DEFAULT_INSTALLED_MODULES += $(INIT_RC_CACHE)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
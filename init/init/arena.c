@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE    (16 * 1024)
+#define ARENA_ALIGN         8
+#define ARENA_ALIGNED(n)    (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/* requests this big get a block of their own instead of wasting a tail */
+#define ARENA_LARGE         (ARENA_BLOCK_SIZE / 4)
+
+/* per-chunk header and minimum chunk of the libc allocator */
+#define HEAP_OVERHEAD       sizeof(size_t)
+#define HEAP_MIN_CHUNK      16
+
+#define INTERN_HASH_SIZE    512     /* must be a power of two */
+
+struct intern {
+    struct intern *next;
+    unsigned hash;
+    char str[];
+};
+
+struct arena arena_nodes;
+struct arena arena_data;
+
+static struct intern *intern_table[INTERN_HASH_SIZE];
+static struct arena_stats stats;
+
+static void account(size_t size, size_t used)
+{
+    size_t chunk = ARENA_ALIGNED(size + HEAP_OVERHEAD);
+
+    stats.objects++;
+    stats.requested += size;
+    stats.used += used;
+    stats.heap_estimate += chunk < HEAP_MIN_CHUNK ? HEAP_MIN_CHUNK : chunk;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+    size_t used = ARENA_ALIGNED(size ? size : 1);
+    void *p;
+
+    if (used >= ARENA_LARGE) {
+        p = calloc(1, used);
+        if (!p)
+            return NULL;
+        stats.blocks++;
+        stats.reserved += used;
+        account(size, used);
+        return p;
+    }
+
+    if (used > a->left) {
+        char *block = calloc(1, ARENA_BLOCK_SIZE);
+        if (!block)
+            return NULL;
+        a->next = block;
+        a->left = ARENA_BLOCK_SIZE;
+        stats.blocks++;
+        stats.reserved += ARENA_BLOCK_SIZE;
+    }
+
+    p = a->next;
+    a->next += used;
+    a->left -= used;
+    account(size, used);
+    return p;
+}
+
+const char *arena_intern(const char *s)
+{
+    struct intern *in;
+    unsigned hash = 0;
+    const char *p;
+    size_t len;
+
+    if (!s)
+        return NULL;
+    for (p = s; *p; p++)
+        hash = hash * 31 + (unsigned char) *p;
+    len = p - s;
+
+    for (in = intern_table[hash & (INTERN_HASH_SIZE - 1)]; in; in = in->next) {
+        if (in->hash == hash && !strcmp(in->str, s)) {
+            stats.string_hits++;
+            stats.string_saved += len + 1;
+            return in->str;
+        }
+    }
+
+    in = arena_alloc(&arena_data, sizeof(*in) + len + 1);
+    if (!in)
+        return NULL;
+    in->hash = hash;
+    memcpy(in->str, s, len + 1);
+    in->next = intern_table[hash & (INTERN_HASH_SIZE - 1)];
+    intern_table[hash & (INTERN_HASH_SIZE - 1)] = in;
+    stats.strings++;
+    return in->str;
+}
+
+void arena_get_stats(struct arena_stats *st)
+{
+    *st = stats;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _INIT_ARENA_H_
+#define _INIT_ARENA_H_
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for data that lives as long as init (or ueventd) does:
+ * everything built from the rc files. Nothing allocated here is ever
+ * freed. Memory is zeroed and aligned for any type.
+ */
+struct arena {
+    char *next;
+    size_t left;
+};
+
+/* services and actions, walked by every lookup */
+extern struct arena arena_nodes;
+/* commands, options, strings and the rest */
+extern struct arena arena_data;
+
+void *arena_alloc(struct arena *a, size_t size);
+
+/* returns the one shared copy of 's' */
+const char *arena_intern(const char *s);
+
+struct arena_stats {
+    unsigned blocks;
+    unsigned objects;
+    size_t reserved;        /* bytes obtained from malloc */
+    size_t used;            /* bytes handed out, including alignment */
+    size_t requested;       /* bytes asked for */
+    size_t heap_estimate;   /* what separate mallocs would have used */
+    unsigned strings;       /* distinct interned strings */
+    unsigned string_hits;   /* interns answered with an existing copy */
+    size_t string_saved;    /* bytes not duplicated thanks to that */
+};
+
+void arena_get_stats(struct arena_stats *st);
+
+#endif
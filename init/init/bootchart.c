@@ -31,8 +31,15 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include "bootchart.h"
+#include "util.h"
+#include "log.h"
 
 #define VERSION         "0.8"
 #define SAMPLE_PERIOD   0.2
@@ -42,6 +49,7 @@
 #define LOG_DISK        LOG_ROOT"/proc_diskstats.log"
 #define LOG_HEADER      LOG_ROOT"/header"
 #define LOG_ACCT        LOG_ROOT"/kernel_pacct"
+#define LOG_BINARY      LOG_ROOT"/bootchart.bin"
 
 #define LOG_STARTFILE   "/data/bootchart-start"
 #define LOG_STOPFILE    "/data/bootchart-stop"
@@ -295,17 +303,762 @@ static FileBuffRec  log_stat[1];
 static FileBuffRec  log_procs[1];
 static FileBuffRec  log_disks[1];
 
+/*
+ * binary collector
+ *
+ * instead of copying the text of every /proc file into the logs on each
+ * period, the binary collector keeps its /proc files open, reads them with
+ * pread() and appends compact records to a buffer that is allocated and
+ * touched up front. a process is only logged when its stat values change
+ * (or when it appears or exits), and its command line is only read again
+ * when its name changes, i.e. after an exec or a zygote specialization.
+ * nothing is written to /data until bootchart_finish(), which saves the
+ * records to LOG_BINARY and converts them to the usual text logs.
+ *
+ * the buffer is not recycled: once it is full, sampling stops, since the
+ * beginning of the boot is what the chart is for.
+ */
+
+#define BC_MAGIC            0x31424342      /* "BCB1" */
+#define BC_TRUNCATED        0x1             /* header flag: the buffer filled up */
+
+#define BC_SAMPLE_ESTIMATE  2048            /* average bytes per sample */
+#define BC_MIN_BUFFER       (256*1024)
+#define BC_MAX_BUFFER       (8*1024*1024)
+
+#define BC_CPU_FIELDS       10
+#define BC_DISK_FIELDS      11
+#define BC_DISK_NAME        32
+#define BC_MAX_DISKS        64
+#define BC_NAME_MAX         128
+#define BC_PID_HASH         256             /* must be a power of two */
+#define BC_MAX_FDS          256             /* /proc/<pid>/stat kept open */
+
+#define BC_ALIGN(n)         (((n) + 3) & ~3)
+
+enum {
+    BC_SAMPLE = 1,
+    BC_CPU,
+    BC_DISK,
+    BC_PROC,
+    BC_EXIT,
+};
+
+typedef struct {
+    uint32_t  magic;
+    uint32_t  period_ms;
+    uint32_t  size;         /* bytes of records that follow */
+    uint32_t  flags;
+} BcHeader;
+
+/* every record starts with this; 'len' covers the whole record */
+typedef struct {
+    uint16_t  type;
+    uint16_t  len;
+} BcRec;
+
+typedef struct {
+    BcRec     rec;
+    uint32_t  jiffies;
+} BcSample;
+
+/* the first line of /proc/stat */
+typedef struct {
+    BcRec     rec;
+    uint32_t  count;
+    uint32_t  v[BC_CPU_FIELDS];
+} BcCpu;
+
+/* one line of /proc/diskstats, when it changed */
+typedef struct {
+    BcRec     rec;
+    uint32_t  major;
+    uint32_t  minor;
+    uint32_t  v[BC_DISK_FIELDS];
+    char      name[BC_DISK_NAME];
+} BcDisk;
+
+/* a process that appeared or changed; the name follows when BC_PROC_NAME */
+#define BC_PROC_NAME        0x1
+
+typedef struct {
+    BcRec     rec;
+    uint32_t  pid;
+    uint32_t  ppid;
+    uint32_t  utime;
+    uint32_t  stime;
+    uint32_t  starttime;
+    char      state;
+    uint8_t   flags;
+    char      name[];
+} BcProc;
+
+typedef struct {
+    BcRec     rec;
+    uint32_t  pid;
+} BcExit;
+
+/* what is known about a process, by the collector and the converter */
+typedef struct BcTask {
+    struct BcTask*  next;
+    int             pid;
+    int             fd;
+    unsigned        gen;
+    uint32_t        ppid;
+    uint32_t        utime;
+    uint32_t        stime;
+    uint32_t        starttime;
+    char            state;
+    char            comm[16];
+    char            name[BC_NAME_MAX];
+} BcTask;
+
+typedef struct {
+    uint32_t  major;
+    uint32_t  minor;
+    uint32_t  v[BC_DISK_FIELDS];
+    char      name[BC_DISK_NAME];
+} BcDiskState;
+
+static int           bc_binary;
+static int           bc_period = BOOTCHART_POLLING_MS;
+
+static char*         bc_buf;
+static size_t        bc_size;
+static size_t        bc_used;
+static int           bc_full;
+
+static int           bc_uptime_fd = -1;
+static int           bc_stat_fd = -1;
+static int           bc_disk_fd = -1;
+static DIR*          bc_proc_dir;
+
+static BcTask*       bc_tasks[BC_PID_HASH];
+static int           bc_nfds;
+static unsigned      bc_gen;
+
+static BcDiskState   bc_disks[BC_MAX_DISKS];
+static int           bc_ndisks;
+
+static void*
+bc_append(int  type, size_t  len)
+{
+    BcRec*  rec;
+
+    len = BC_ALIGN(len);
+    if (bc_used + len > bc_size) {
+        bc_full = 1;
+        return NULL;
+    }
+    rec = (BcRec*)(bc_buf + bc_used);
+    rec->type = type;
+    rec->len  = len;
+    bc_used  += len;
+    return rec;
+}
+
+static int
+bc_pread(int  fd, char*  buff, int  len)
+{
+    int  ret;
+    do { ret = pread(fd, buff, len-1, 0); } while (ret < 0 && errno == EINTR);
+    buff[ret > 0 ? ret : 0] = 0;
+    return ret;
+}
+
+static int
+bc_open(const char*  path)
+{
+    return open(path, O_RDONLY|O_CLOEXEC);
+}
+
+static BcTask**
+bc_task_slot(int  pid)
+{
+    BcTask**  pt = &bc_tasks[pid & (BC_PID_HASH-1)];
+    while (*pt && (*pt)->pid != pid)
+        pt = &(*pt)->next;
+    return pt;
+}
+
+static void
+bc_task_free(BcTask**  pt)
+{
+    BcTask*  t = *pt;
+    *pt = t->next;
+    if (t->fd >= 0) {
+        close(t->fd);
+        bc_nfds--;
+    }
+    free(t);
+}
+
+static int
+bc_log_sample(void)
+{
+    char       buff[64];
+    BcSample*  s;
+
+    if (bc_pread(bc_uptime_fd, buff, sizeof(buff)) <= 0)
+        return 0;
+    s = bc_append(BC_SAMPLE, sizeof(*s));
+    if (s == NULL)
+        return -1;
+    s->jiffies = (uint32_t)(100LL*strtod(buff,NULL));
+    return 0;
+}
+
+static int
+bc_log_cpu(void)
+{
+    /* only the first line is used, and the whole file is several KB */
+    char    buff[256];
+    char*   p;
+    BcCpu*  c;
+    int     n;
+
+    if (bc_pread(bc_stat_fd, buff, sizeof(buff)) <= 0 || strncmp(buff, "cpu ", 4))
+        return 0;
+    c = bc_append(BC_CPU, sizeof(*c));
+    if (c == NULL)
+        return -1;
+    p = buff + 4;
+    for (n = 0; n < BC_CPU_FIELDS; n++) {
+        char*          end;
+        unsigned long  v = strtoul(p, &end, 10);
+        if (end == p)
+            break;
+        c->v[n] = v;
+        p = end;
+    }
+    c->count = n;
+    return 0;
+}
+
+static int
+bc_log_disks(void)
+{
+    static char  buff[8192];
+    char*        line;
+    char*        next;
+
+    if (bc_pread(bc_disk_fd, buff, sizeof(buff)) <= 0)
+        return 0;
+
+    for (line = buff; *line; line = next) {
+        BcDiskState  d;
+        BcDisk*      rec;
+        int          i;
+
+        next = strchr(line, '\n');
+        if (next)
+            *next++ = 0;
+        else
+            next = line + strlen(line);
+
+        memset(&d, 0, sizeof(d));
+        if (sscanf(line, "%u %u %31s %u %u %u %u %u %u %u %u %u %u %u",
+                   &d.major, &d.minor, d.name,
+                   &d.v[0], &d.v[1], &d.v[2], &d.v[3], &d.v[4], &d.v[5],
+                   &d.v[6], &d.v[7], &d.v[8], &d.v[9], &d.v[10]) != 3+BC_DISK_FIELDS)
+            continue;
+
+        for (i = 0; i < bc_ndisks; i++) {
+            if (!strcmp(bc_disks[i].name, d.name))
+                break;
+        }
+        if (i < bc_ndisks && !memcmp(&bc_disks[i], &d, sizeof(d)))
+            continue;
+        if (i == bc_ndisks) {
+            if (bc_ndisks == BC_MAX_DISKS)
+                continue;
+            bc_ndisks++;
+        }
+        bc_disks[i] = d;
+
+        rec = bc_append(BC_DISK, sizeof(*rec));
+        if (rec == NULL)
+            return -1;
+        rec->major = d.major;
+        rec->minor = d.minor;
+        memcpy(rec->v, d.v, sizeof(rec->v));
+        memcpy(rec->name, d.name, sizeof(rec->name));
+    }
+    return 0;
+}
+
+/* reads /proc/<pid>/stat, through the task's own fd when it has one */
+static int
+bc_read_stat(BcTask*  t, char*  buff, int  len)
+{
+    char  filename[32];
+    int   fd, ret;
+
+    if (t->fd >= 0) {
+        ret = bc_pread(t->fd, buff, len);
+        if (ret > 0)
+            return ret;
+        /* that process is gone; the pid may belong to a new one */
+        close(t->fd);
+        t->fd = -1;
+        bc_nfds--;
+    }
+
+    snprintf(filename, sizeof(filename), "/proc/%d/stat", t->pid);
+    fd = bc_open(filename);
+    if (fd < 0)
+        return -1;
+    ret = bc_pread(fd, buff, len);
+    if (bc_nfds < BC_MAX_FDS) {
+        t->fd = fd;
+        bc_nfds++;
+    } else {
+        close(fd);
+    }
+    return ret;
+}
+
+static int
+bc_log_task(int  pid)
+{
+    BcTask**  pt = bc_task_slot(pid);
+    BcTask*   t  = *pt;
+    BcTask    cur;
+    BcProc*   rec;
+    char      buff[1024];
+    char*     p1;
+    char*     p2;
+    int       named, len;
+
+    if (t == NULL) {
+        t = calloc(1, sizeof(*t));
+        if (t == NULL)
+            return 0;
+        t->pid = pid;
+        t->fd  = -1;
+        *pt = t;
+    }
+    t->gen = bc_gen;
+
+    if (bc_read_stat(t, buff, sizeof(buff)) <= 0)
+        return 0;
+
+    /* "pid (comm) state ppid ...", and comm may contain anything */
+    p1 = strchr(buff, '(');
+    p2 = strrchr(buff, ')');
+    if (p1 == NULL || p2 == NULL || p2 < p1 || p2[1] != ' ')
+        return 0;
+
+    memset(&cur, 0, sizeof(cur));
+    len = p2 - p1 - 1;
+    if (len >= (int)sizeof(cur.comm))
+        len = sizeof(cur.comm) - 1;
+    memcpy(cur.comm, p1 + 1, len);
+    if (sscanf(p2 + 2, "%c %u %*d %*d %*d %*d %*u %*u %*u %*u %*u %u %u "
+                       "%*d %*d %*d %*d %*d %*d %u",
+               &cur.state, &cur.ppid, &cur.utime, &cur.stime,
+               &cur.starttime) != 5)
+        return 0;
+
+    /* a new name or start time means a new program: fetch its command line */
+    named = t->name[0] == 0 || strcmp(t->comm, cur.comm) ||
+            t->starttime != cur.starttime;
+    if (!named && t->state == cur.state && t->ppid == cur.ppid &&
+        t->utime == cur.utime && t->stime == cur.stime)
+        return 0;
+
+    if (named) {
+        char  filename[32];
+
+        snprintf(filename, sizeof(filename), "/proc/%d/cmdline", pid);
+        proc_read(filename, t->name, sizeof(t->name));
+        if (t->name[0] == 0)
+            strcpy(t->name, cur.comm);
+        strcpy(t->comm, cur.comm);
+    }
+    t->state     = cur.state;
+    t->ppid      = cur.ppid;
+    t->utime     = cur.utime;
+    t->stime     = cur.stime;
+    t->starttime = cur.starttime;
+
+    len = named ? strlen(t->name) + 1 : 0;
+    rec = bc_append(BC_PROC, offsetof(BcProc, name) + len);
+    if (rec == NULL)
+        return -1;
+    rec->pid       = pid;
+    rec->ppid      = t->ppid;
+    rec->utime     = t->utime;
+    rec->stime     = t->stime;
+    rec->starttime = t->starttime;
+    rec->state     = t->state;
+    rec->flags     = named ? BC_PROC_NAME : 0;
+    if (named)
+        memcpy(rec->name, t->name, len);
+    return 0;
+}
+
+static int
+bc_log_procs(void)
+{
+    struct dirent*  entry;
+    int             i;
+
+    bc_gen++;
+    rewinddir(bc_proc_dir);
+    while ((entry = readdir(bc_proc_dir)) != NULL) {
+        char*  end;
+        int    pid = strtol(entry->d_name, &end, 10);
+        if (end > entry->d_name && *end == 0) {
+            if (bc_log_task(pid) < 0)
+                return -1;
+        }
+    }
+
+    /* whatever was not listed has exited */
+    for (i = 0; i < BC_PID_HASH; i++) {
+        BcTask**  pt = &bc_tasks[i];
+        while (*pt) {
+            BcExit*  rec;
+            if ((*pt)->gen == bc_gen) {
+                pt = &(*pt)->next;
+                continue;
+            }
+            rec = bc_append(BC_EXIT, sizeof(*rec));
+            if (rec == NULL)
+                return -1;
+            rec->pid = (*pt)->pid;
+            bc_task_free(pt);
+        }
+    }
+    return 0;
+}
+
+static int
+bc_init(int  count)
+{
+    size_t  size = (size_t)count * BC_SAMPLE_ESTIMATE;
+
+    if (size < BC_MIN_BUFFER)
+        size = BC_MIN_BUFFER;
+    if (size > BC_MAX_BUFFER)
+        size = BC_MAX_BUFFER;
+
+    bc_buf = malloc(size);
+    if (bc_buf == NULL)
+        return -1;
+    /* fault the pages in now rather than while sampling */
+    memset(bc_buf, 0, size);
+    bc_size = size;
+    bc_used = 0;
+
+    bc_uptime_fd = bc_open("/proc/uptime");
+    bc_stat_fd   = bc_open("/proc/stat");
+    bc_disk_fd   = bc_open("/proc/diskstats");
+    bc_proc_dir  = opendir("/proc");
+    if (bc_uptime_fd < 0 || bc_proc_dir == NULL)
+        return -1;
+    close_on_exec(dirfd(bc_proc_dir));
+    return 0;
+}
+
+static int
+bc_step(void)
+{
+    size_t  start = bc_used;
+
+    if (bc_log_sample() < 0 || bc_log_cpu() < 0 ||
+        bc_log_disks() < 0 || bc_log_procs() < 0) {
+        /* drop the partial sample */
+        bc_used = start;
+        NOTICE("bootchart: buffer full after %u bytes, stopping\n", (unsigned)bc_used);
+        return -1;
+    }
+    return 0;
+}
+
+static void
+bc_save(void)
+{
+    BcHeader  hdr;
+    int       fd;
+
+    hdr.magic     = BC_MAGIC;
+    hdr.period_ms = bc_period;
+    hdr.size      = bc_used;
+    hdr.flags     = bc_full ? BC_TRUNCATED : 0;
+
+    fd = open(LOG_BINARY, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ERROR("bootchart: cannot create %s: %s\n", LOG_BINARY, strerror(errno));
+        return;
+    }
+    if (unix_write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        unix_write(fd, bc_buf, bc_used) != (int)bc_used)
+        ERROR("bootchart: cannot write %s: %s\n", LOG_BINARY, strerror(errno));
+    close(fd);
+}
+
+static void
+bc_done(void)
+{
+    int  i;
+
+    for (i = 0; i < BC_PID_HASH; i++) {
+        while (bc_tasks[i])
+            bc_task_free(&bc_tasks[i]);
+    }
+    if (bc_proc_dir)
+        closedir(bc_proc_dir);
+    close(bc_uptime_fd);
+    close(bc_stat_fd);
+    close(bc_disk_fd);
+    bc_proc_dir  = NULL;
+    bc_uptime_fd = bc_stat_fd = bc_disk_fd = -1;
+    bc_ndisks    = 0;
+
+    free(bc_buf);
+    bc_buf  = NULL;
+    bc_size = bc_used = 0;
+}
+
+/* converter: replays the records and writes the text logs */
+
+static void
+conv_printf(FileBuff  log, const char*  fmt, ...)
+{
+    char     buff[512];
+    va_list  args;
+    int      len;
+
+    va_start(args, fmt);
+    len = vsnprintf(buff, sizeof(buff), fmt, args);
+    va_end(args);
+    if (len >= (int)sizeof(buff))
+        len = sizeof(buff) - 1;
+    if (len > 0)
+        file_buff_write(log, buff, len);
+}
+
+static void
+conv_flush_sample(uint32_t  jiffies, const BcCpu*  cpu)
+{
+    uint32_t  i;
+    int       n;
+
+    conv_printf(log_stat, "%u\n", jiffies);
+    if (cpu != NULL) {
+        file_buff_write(log_stat, "cpu ", 4);
+        for (i = 0; i < cpu->count && i < BC_CPU_FIELDS; i++)
+            conv_printf(log_stat, " %u", cpu->v[i]);
+        do_log_ln(log_stat);
+    }
+    do_log_ln(log_stat);
+
+    conv_printf(log_disks, "%u\n", jiffies);
+    for (n = 0; n < bc_ndisks; n++) {
+        const BcDiskState*  d = &bc_disks[n];
+        conv_printf(log_disks, "%4u %7u %s %u %u %u %u %u %u %u %u %u %u %u\n",
+                    d->major, d->minor, d->name,
+                    d->v[0], d->v[1], d->v[2], d->v[3], d->v[4], d->v[5],
+                    d->v[6], d->v[7], d->v[8], d->v[9], d->v[10]);
+    }
+    do_log_ln(log_disks);
+
+    /* the fields bootchart does not use are written as zeroes */
+    conv_printf(log_procs, "%u\n", jiffies);
+    for (n = 0; n < BC_PID_HASH; n++) {
+        const BcTask*  t;
+        for (t = bc_tasks[n]; t; t = t->next) {
+            conv_printf(log_procs, "%d (%s) %c %u 0 0 0 0 0 0 0 0 0 %u %u "
+                        "0 0 0 0 0 0 %u\n", t->pid, t->name, t->state, t->ppid,
+                        t->utime, t->stime, t->starttime);
+        }
+    }
+    do_log_ln(log_procs);
+}
+
+static int
+conv_apply(const BcRec*  rec)
+{
+    if (rec->type == BC_DISK) {
+        const BcDisk*  d = (const BcDisk*)rec;
+        int            i;
+
+        if (rec->len < sizeof(*d))
+            return -1;
+        for (i = 0; i < bc_ndisks; i++) {
+            if (!strncmp(bc_disks[i].name, d->name, BC_DISK_NAME))
+                break;
+        }
+        if (i == bc_ndisks) {
+            if (bc_ndisks == BC_MAX_DISKS)
+                return 0;
+            bc_ndisks++;
+        }
+        bc_disks[i].major = d->major;
+        bc_disks[i].minor = d->minor;
+        memcpy(bc_disks[i].v, d->v, sizeof(d->v));
+        memcpy(bc_disks[i].name, d->name, BC_DISK_NAME);
+        bc_disks[i].name[BC_DISK_NAME-1] = 0;
+    } else if (rec->type == BC_PROC) {
+        const BcProc*  p  = (const BcProc*)rec;
+        BcTask**       pt;
+        BcTask*        t;
+
+        if (rec->len < offsetof(BcProc, name))
+            return -1;
+        pt = bc_task_slot(p->pid);
+        t  = *pt;
+        if (t == NULL) {
+            t = calloc(1, sizeof(*t));
+            if (t == NULL)
+                return -1;
+            t->pid = p->pid;
+            t->fd  = -1;
+            strcpy(t->name, "?");
+            *pt = t;
+        }
+        t->ppid      = p->ppid;
+        t->utime     = p->utime;
+        t->stime     = p->stime;
+        t->starttime = p->starttime;
+        t->state     = p->state;
+        if (p->flags & BC_PROC_NAME) {
+            size_t  len = rec->len - offsetof(BcProc, name);
+            if (len >= sizeof(t->name))
+                len = sizeof(t->name) - 1;
+            memcpy(t->name, p->name, len);
+            t->name[len] = 0;
+        }
+    } else if (rec->type == BC_EXIT) {
+        const BcExit*  e = (const BcExit*)rec;
+        BcTask**       pt;
+
+        if (rec->len < sizeof(*e))
+            return -1;
+        pt = bc_task_slot(e->pid);
+        if (*pt)
+            bc_task_free(pt);
+    }
+    return 0;
+}
+
+int  bootchart_convert( const char*  binfile, const char*  dir )
+{
+    char             path[PATH_MAX];
+    char*            data;
+    unsigned         size;
+    const BcHeader*  hdr;
+    const char*      p;
+    const char*      end;
+    const BcCpu*     cpu = NULL;
+    uint32_t         jiffies = 0;
+    int              have_sample = 0;
+    int              ret = -1;
+
+    data = read_file(binfile, &size);
+    if (data == NULL) {
+        ERROR("bootchart: cannot read %s\n", binfile);
+        return -1;
+    }
+    hdr = (const BcHeader*)data;
+    if (size < sizeof(*hdr) || hdr->magic != BC_MAGIC ||
+        hdr->size > size - sizeof(*hdr)) {
+        ERROR("bootchart: %s is not a bootchart log\n", binfile);
+        goto out;
+    }
+
+    snprintf(path, sizeof(path), "%s/proc_stat.log", dir);
+    file_buff_open(log_stat, path);
+    snprintf(path, sizeof(path), "%s/proc_ps.log", dir);
+    file_buff_open(log_procs, path);
+    snprintf(path, sizeof(path), "%s/proc_diskstats.log", dir);
+    file_buff_open(log_disks, path);
+    if (log_stat->fd < 0 || log_procs->fd < 0 || log_disks->fd < 0) {
+        ERROR("bootchart: cannot create logs in %s\n", dir);
+        goto done;
+    }
+
+    p   = data + sizeof(*hdr);
+    end = p + hdr->size;
+    while (p < end) {
+        const BcRec*  rec = (const BcRec*)p;
+
+        if ((size_t)(end - p) < sizeof(*rec) || rec->len < sizeof(*rec) ||
+            rec->len > end - p || (rec->len & 3))
+            goto corrupt;
+        p += rec->len;
+
+        if (rec->type == BC_SAMPLE) {
+            if (rec->len < sizeof(BcSample))
+                goto corrupt;
+            if (have_sample)
+                conv_flush_sample(jiffies, cpu);
+            jiffies = ((const BcSample*)rec)->jiffies;
+            have_sample = 1;
+            cpu = NULL;
+        } else if (rec->type == BC_CPU) {
+            if (rec->len < sizeof(BcCpu))
+                goto corrupt;
+            cpu = (const BcCpu*)rec;
+        } else if (conv_apply(rec) < 0) {
+            goto corrupt;
+        }
+    }
+    if (have_sample)
+        conv_flush_sample(jiffies, cpu);
+    if (hdr->flags & BC_TRUNCATED)
+        NOTICE("bootchart: %s was cut short when its buffer filled\n", binfile);
+    ret = 0;
+    goto done;
+
+corrupt:
+    ERROR("bootchart: %s is corrupt\n", binfile);
+done:
+    file_buff_done(log_stat);
+    file_buff_done(log_disks);
+    file_buff_done(log_procs);
+    close(log_stat->fd);
+    close(log_disks->fd);
+    close(log_procs->fd);
+    bc_done();
+out:
+    free(data);
+    return ret;
+}
+
+/* "<seconds> [period=<ms>] [binary]", e.g. "120 period=50 binary" */
+static int
+parse_options(const char*  s)
+{
+    const char*  p;
+    int          timeout = atoi(s);
+
+    p = strstr(s, "period=");
+    if (p) {
+        bc_period = atoi(p + sizeof("period=")-1);
+        if (bc_period < BOOTCHART_MIN_POLLING_MS)
+            bc_period = BOOTCHART_MIN_POLLING_MS;
+        if (bc_period > BOOTCHART_MAX_POLLING_MS)
+            bc_period = BOOTCHART_MAX_POLLING_MS;
+    }
+    if (strstr(s, "binary"))
+        bc_binary = 1;
+    return timeout;
+}
+
 /* called to setup bootcharting */
 int   bootchart_init( void )
 {
     int  ret;
-    char buff[4];
+    char buff[64];
     int  timeout = 0, count = 0;
 
     buff[0] = 0;
     proc_read( LOG_STARTFILE, buff, sizeof(buff) );
     if (buff[0] != 0) {
-        timeout = atoi(buff);
+        timeout = parse_options(buff);
     }
     else {
         /* when running with emulator, androidboot.bootchart=<timeout>
@@ -329,13 +1082,20 @@ int   bootchart_init( void )
     if (timeout > BOOTCHART_MAX_TIME_SEC)
         timeout = BOOTCHART_MAX_TIME_SEC;
 
-    count = (timeout*1000 + BOOTCHART_POLLING_MS-1)/BOOTCHART_POLLING_MS;
+    count = (timeout*1000 + bc_period-1)/bc_period;
 
     do {ret=mkdir(LOG_ROOT,0755);}while (ret < 0 && errno == EINTR);
 
-    file_buff_open(log_stat,  LOG_STAT);
-    file_buff_open(log_procs, LOG_PROCS);
-    file_buff_open(log_disks, LOG_DISK);
+    if (bc_binary) {
+        if (bc_init(count) < 0) {
+            bc_done();
+            return -1;
+        }
+    } else {
+        file_buff_open(log_stat,  LOG_STAT);
+        file_buff_open(log_procs, LOG_PROCS);
+        file_buff_open(log_disks, LOG_DISK);
+    }
 
     /* create kernel process accounting file */
     {
@@ -350,12 +1110,22 @@ int   bootchart_init( void )
     return count;
 }
 
+int  bootchart_period_ms( void )
+{
+    return bc_period;
+}
+
 /* called each time you want to perform a bootchart sampling op */
 int  bootchart_step( void )
 {
-    do_log_file(log_stat,   "/proc/stat");
-    do_log_file(log_disks,  "/proc/diskstats");
-    do_log_procs(log_procs);
+    if (bc_binary) {
+        if (bc_step() < 0)
+            return -1;
+    } else {
+        do_log_file(log_stat,   "/proc/stat");
+        do_log_file(log_disks,  "/proc/diskstats");
+        do_log_procs(log_procs);
+    }
 
     /* we stop when /data/bootchart-stop contains 1 */
     {
@@ -371,8 +1141,14 @@ int  bootchart_step( void )
 void  bootchart_finish( void )
 {
     unlink( LOG_STOPFILE );
-    file_buff_done(log_stat);
-    file_buff_done(log_disks);
-    file_buff_done(log_procs);
+    if (bc_binary) {
+        bc_save();
+        bc_done();
+        bootchart_convert(LOG_BINARY, LOG_ROOT);
+    } else {
+        file_buff_done(log_stat);
+        file_buff_done(log_disks);
+        file_buff_done(log_procs);
+    }
     acct(NULL);
 }
@@ -24,10 +24,16 @@
 #if BOOTCHART
 
 extern int   bootchart_init(void);
+extern int   bootchart_period_ms(void);
 extern int   bootchart_step(void);
 extern void  bootchart_finish(void);
 
-# define BOOTCHART_POLLING_MS   200   /* polling period in ms */
+/* turns a binary log into the text logs, see bootchart.c */
+extern int   bootchart_convert(const char*  binfile, const char*  dir);
+
+# define BOOTCHART_POLLING_MS   200   /* default polling period in ms */
+# define BOOTCHART_MIN_POLLING_MS      10
+# define BOOTCHART_MAX_POLLING_MS      1000
 # define BOOTCHART_DEFAULT_TIME_SEC    (2*60)  /* default polling time in seconds */
 # define BOOTCHART_MAX_TIME_SEC        (10*60) /* max polling time in seconds */
 
@@ -534,6 +534,7 @@ int do_setcon(int nargs, char **args) {
     if (setcon(args[1]) < 0) {
         return -errno;
     }
+    invalidate_exec_contexts();
     return 0;
 }
 
@@ -645,6 +646,7 @@ int do_powerctl(int nargs, char **args)
         return -EINVAL;
     }
 
+    property_sync_persistent();
     return android_reboot(cmd, 0, reboot_target);
 }
 
@@ -798,6 +800,8 @@ int do_chmod(int nargs, char **args) {
 int do_restorecon(int nargs, char **args) {
     int i;
 
+    /* a relabelled executable gets a new exec context */
+    invalidate_exec_contexts();
     for (i = 1; i < nargs; i++) {
         if (restorecon(args[i]) < 0)
             return -errno;
@@ -805,6 +809,17 @@ int do_restorecon(int nargs, char **args) {
     return 0;
 }
 
+int do_restorecon_recursive(int nargs, char **args) {
+    int i;
+
+    invalidate_exec_contexts();
+    for (i = 1; i < nargs; i++) {
+        if (restorecon_recursive(args[i]) < 0)
+            return -errno;
+    }
+    return 0;
+}
+
 int do_setsebool(int nargs, char **args) {
     const char *name = args[1];
     const char *value = args[2];
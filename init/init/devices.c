@@ -25,6 +25,8 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <string.h>
+#include <poll.h>
+#include <pthread.h>
 
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -38,10 +40,15 @@
 #include <sys/time.h>
 #include <asm/page.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <limits.h>
+#include <time.h>
 
 #include <cutils/list.h>
 #include <cutils/uevent.h>
 
+#include "arena.h"
 #include "devices.h"
 #include "util.h"
 #include "log.h"
@@ -55,6 +62,9 @@ extern struct selabel_handle *sehandle;
 
 static int device_fd = -1;
 
+/* number of sysfs walker threads used by coldboot, 0 walks serially */
+static int coldboot_threads = 0;
+
 struct uevent {
     const char *action;
     const char *path;
@@ -78,7 +88,20 @@ struct perms_ {
 
 struct perm_node {
     struct perms_ dp;
-    struct listnode plist;
+    unsigned int seq;           /* position of the rule in the rc files */
+    struct perm_node *next;     /* older rule ending at the same trie node */
+};
+
+/* The dev and sys rules are kept in character tries keyed on the rule
+ * path, so a lookup walks the uevent path once instead of comparing it
+ * against every rule. Rules ending at a node are chained newest first.
+ */
+struct perm_trie {
+    struct perm_trie *child;
+    struct perm_trie *sibling;
+    struct perm_node *exact;    /* rules matching exactly this path */
+    struct perm_node *prefix;   /* rules matching paths with this prefix */
+    char c;
 };
 
 struct platform_node {
@@ -88,23 +111,64 @@ struct platform_node {
     struct listnode list;
 };
 
-static list_declare(sys_perms);
-static list_declare(dev_perms);
+static struct perm_trie sys_perms;
+static struct perm_trie dev_perms;
+static unsigned int perm_seq = 0;
 static list_declare(platform_names);
 
+static struct perm_trie *perm_trie_child(struct perm_trie *node, char c,
+                                         int create)
+{
+    struct perm_trie *child;
+
+    for (child = node->child; child; child = child->sibling) {
+        if (child->c == c)
+            return child;
+    }
+    if (!create)
+        return NULL;
+
+    child = arena_alloc(&arena_data, sizeof(*child));
+    if (!child)
+        return NULL;
+    child->c = c;
+    child->sibling = node->child;
+    node->child = child;
+    return child;
+}
+
+static int perm_trie_add(struct perm_trie *root, const char *name,
+                         struct perm_node *node)
+{
+    while (*name) {
+        root = perm_trie_child(root, *name++, 1);
+        if (!root)
+            return -ENOMEM;
+    }
+
+    if (node->dp.prefix) {
+        node->next = root->prefix;
+        root->prefix = node;
+    } else {
+        node->next = root->exact;
+        root->exact = node;
+    }
+    return 0;
+}
+
 int add_dev_perms(const char *name, const char *attr,
                   mode_t perm, unsigned int uid, unsigned int gid,
                   unsigned short prefix) {
-    struct perm_node *node = calloc(1, sizeof(*node));
+    struct perm_node *node = arena_alloc(&arena_data, sizeof(*node));
     if (!node)
         return -ENOMEM;
 
-    node->dp.name = strdup(name);
+    node->dp.name = (char *) arena_intern(name);
     if (!node->dp.name)
         return -ENOMEM;
 
     if (attr) {
-        node->dp.attr = strdup(attr);
+        node->dp.attr = (char *) arena_intern(attr);
         if (!node->dp.attr)
             return -ENOMEM;
     }
@@ -113,34 +177,68 @@ int add_dev_perms(const char *name, const char *attr,
     node->dp.uid = uid;
     node->dp.gid = gid;
     node->dp.prefix = prefix;
+    node->seq = perm_seq++;
 
+    /* upaths omit the "/sys" that sys rules contain */
     if (attr)
-        list_add_tail(&sys_perms, &node->plist);
+        return perm_trie_add(&sys_perms, node->dp.name + 4, node);
     else
-        list_add_tail(&dev_perms, &node->plist);
+        return perm_trie_add(&dev_perms, node->dp.name, node);
+}
 
+static int perm_node_cmp(const void *a, const void *b)
+{
+    const struct perm_node *na = *(const struct perm_node **) a;
+    const struct perm_node *nb = *(const struct perm_node **) b;
+
+    return na->seq < nb->seq ? -1 : na->seq > nb->seq;
+}
+
+static int perm_matches_add(struct perm_node ***matches, int *count,
+                            int *size, struct perm_node *node)
+{
+    for (; node; node = node->next) {
+        if (*count == *size) {
+            int new_size = *size ? *size * 2 : 16;
+            struct perm_node **m = realloc(*matches, new_size * sizeof(*m));
+            if (!m)
+                return -ENOMEM;
+            *matches = m;
+            *size = new_size;
+        }
+        (*matches)[(*count)++] = node;
+    }
     return 0;
 }
 
 void fixup_sys_perms(const char *upath)
 {
+    static struct perm_node **matches;
+    static int matches_size;
     char buf[512];
-    struct listnode *node;
+    struct perm_trie *trie = &sys_perms;
     struct perms_ *dp;
     char *secontext;
+    const char *p = upath;
+    int count = 0;
+    int i;
 
-        /* upaths omit the "/sys" that paths in this list
-         * contain, so we add 4 when comparing...
-         */
-    list_for_each(node, &sys_perms) {
-        dp = &(node_to_item(node, struct perm_node, plist))->dp;
-        if (dp->prefix) {
-            if (strncmp(upath, dp->name + 4, strlen(dp->name + 4)))
-                continue;
-        } else {
-            if (strcmp(upath, dp->name + 4))
-                continue;
+    /* every rule that matches is applied, in rc file order */
+    while (trie) {
+        if (perm_matches_add(&matches, &count, &matches_size, trie->prefix))
+            return;
+        if (!*p) {
+            if (perm_matches_add(&matches, &count, &matches_size, trie->exact))
+                return;
+            break;
         }
+        trie = perm_trie_child(trie, *p++, 0);
+    }
+    if (count > 1)
+        qsort(matches, count, sizeof(*matches), perm_node_cmp);
+
+    for (i = 0; i < count; i++) {
+        dp = &matches[i]->dp;
 
         if ((strlen(upath) + strlen(dp->attr) + 6) > sizeof(buf))
             return;
@@ -162,28 +260,28 @@ void fixup_sys_perms(const char *upath)
 
 static mode_t get_device_perm(const char *path, unsigned *uid, unsigned *gid)
 {
-    mode_t perm;
-    struct listnode *node;
-    struct perm_node *perm_node;
-    struct perms_ *dp;
+    struct perm_trie *trie = &dev_perms;
+    struct perm_node *best = NULL;
+    const char *p = path;
 
-    /* search the perms list in reverse so that ueventd.$hardware can
+    /* the last matching rule wins so that ueventd.$hardware can
      * override ueventd.rc
      */
-    list_for_each_reverse(node, &dev_perms) {
-        perm_node = node_to_item(node, struct perm_node, plist);
-        dp = &perm_node->dp;
-
-        if (dp->prefix) {
-            if (strncmp(path, dp->name, strlen(dp->name)))
-                continue;
-        } else {
-            if (strcmp(path, dp->name))
-                continue;
+    while (trie) {
+        if (trie->prefix && (!best || trie->prefix->seq > best->seq))
+            best = trie->prefix;
+        if (!*p) {
+            if (trie->exact && (!best || trie->exact->seq > best->seq))
+                best = trie->exact;
+            break;
         }
-        *uid = dp->uid;
-        *gid = dp->gid;
-        return dp->perm;
+        trie = perm_trie_child(trie, *p++, 0);
+    }
+
+    if (best) {
+        *uid = best->dp.uid;
+        *gid = best->dp.gid;
+        return best->dp.perm;
     }
     /* Default if nothing found. */
     *uid = 0;
@@ -661,41 +759,181 @@ static void handle_device_event(struct uevent *uevent)
     }
 }
 
-static int load_firmware(int fw_fd, int loading_fd, int data_fd)
+/* Firmware requests are served by a few worker threads, so that a large
+** blob, or one whose filesystem is not mounted yet, does not hold up the
+** handling of other uevents.  The blob goes to the kernel with sendfile(),
+** or from a read-only mapping where that is not supported, so its bytes
+** are never copied through a buffer in ueventd.
+*/
+
+#define FIRMWARE_MAX_THREADS    4
+#define FIRMWARE_RETRY_US       100000
+#define FIRMWARE_CACHE_SIZE     32
+
+static const char *firmware_dirs[] = {
+    FIRMWARE_DIR1, FIRMWARE_DIR2, FIRMWARE_DIR3,
+};
+
+struct firmware_request {
+    struct listnode list;
+    long long queued;           /* usecs when the uevent arrived */
+    char *root;                 /* sysfs directory of the loading device */
+    char *firmware;
+};
+
+/* the directory a recently requested blob was found in */
+struct firmware_location {
+    char *name;
+    int dir;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct listnode requests;
+    int queued;
+    int threads;
+    int idle;
+    int dirs_resolved;          /* set once booting is over */
+    unsigned dirs_present;      /* bit per firmware_dirs entry */
+    struct firmware_location cache[FIRMWARE_CACHE_SIZE];
+    int cache_next;
+} fw = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .requests = { &fw.requests, &fw.requests },
+};
+
+static long long firmware_usecs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int is_booting(void)
+{
+    return access("/dev/.booting", F_OK) == 0;
+}
+
+/* Once every filesystem is mounted, the missing directories can be
+ * skipped for good.
+ */
+static void firmware_resolve_dirs(void)
 {
     struct stat st;
-    long len_to_copy;
-    int ret = 0;
+    unsigned present = 0;
+    unsigned i;
 
-    if(fstat(fw_fd, &st) < 0)
-        return -1;
-    len_to_copy = st.st_size;
+    if (fw.dirs_resolved)
+        return;
+    for (i = 0; i < ARRAY_SIZE(firmware_dirs); i++) {
+        if (stat(firmware_dirs[i], &st) == 0 && S_ISDIR(st.st_mode))
+            present |= 1u << i;
+    }
 
-    write(loading_fd, "1", 1);  /* start transfer */
+    pthread_mutex_lock(&fw.lock);
+    fw.dirs_present = present;
+    fw.dirs_resolved = 1;
+    pthread_mutex_unlock(&fw.lock);
+}
 
-    while (len_to_copy > 0) {
-        char buf[PAGE_SIZE];
-        ssize_t nr;
+static void firmware_remember(const char *name, int dir)
+{
+    struct firmware_location *loc;
+    char *copy = strdup(name);
 
-        nr = read(fw_fd, buf, sizeof(buf));
-        if(!nr)
-            break;
-        if(nr < 0) {
-            ret = -1;
+    if (!copy)
+        return;
+    pthread_mutex_lock(&fw.lock);
+    loc = &fw.cache[fw.cache_next];
+    fw.cache_next = (fw.cache_next + 1) % FIRMWARE_CACHE_SIZE;
+    free(loc->name);
+    loc->name = copy;
+    loc->dir = dir;
+    pthread_mutex_unlock(&fw.lock);
+}
+
+/* Opens the blob from the first firmware directory that has it, trying
+ * the directory it was found in last time before searching again.
+ */
+static int firmware_open(const char *name, int *dir)
+{
+    char path[PATH_MAX];
+    unsigned present;
+    int cached = -1;
+    int i, fd;
+
+    pthread_mutex_lock(&fw.lock);
+    for (i = 0; i < FIRMWARE_CACHE_SIZE; i++) {
+        if (fw.cache[i].name && !strcmp(fw.cache[i].name, name)) {
+            cached = fw.cache[i].dir;
             break;
         }
+    }
+    present = fw.dirs_resolved ? fw.dirs_present : ~0u;
+    pthread_mutex_unlock(&fw.lock);
+
+    if (cached >= 0) {
+        snprintf(path, sizeof(path), "%s/%s", firmware_dirs[cached], name);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            *dir = cached;
+            return fd;
+        }
+    }
 
-        len_to_copy -= nr;
-        while (nr > 0) {
-            ssize_t nw = 0;
+    for (i = 0; i < (int) ARRAY_SIZE(firmware_dirs); i++) {
+        if (i == cached || !(present & (1u << i)))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", firmware_dirs[i], name);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            firmware_remember(name, i);
+            *dir = i;
+            return fd;
+        }
+    }
+    return -1;
+}
+
+static int load_firmware(int fw_fd, int loading_fd, int data_fd,
+                         off_t size, const char **how)
+{
+    off_t off = 0;
+    ssize_t n;
+    char *map;
+    int ret = 0;
 
-            nw = write(data_fd, buf + nw, nr);
-            if(nw <= 0) {
+    write(loading_fd, "1", 1);  /* start transfer */
+
+    *how = "sendfile";
+    while (off < size) {
+        n = sendfile(data_fd, fw_fd, &off, size - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+    }
+
+    if (off < size) {
+        /* not every kernel can splice into the data attribute; write the
+         * rest straight from the page cache instead */
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fw_fd, 0);
+        if (map == MAP_FAILED) {
+            ret = -1;
+            goto out;
+        }
+        *how = "mmap";
+        while (off < size) {
+            n = TEMP_FAILURE_RETRY(write(data_fd, map + off, size - off));
+            if (n <= 0) {
                 ret = -1;
-                goto out;
+                break;
             }
-            nr -= nw;
+            off += n;
         }
+        munmap(map, size);
     }
 
 out:
@@ -707,100 +945,97 @@ out:
     return ret;
 }
 
-static int is_booting(void)
+static void process_firmware_request(struct firmware_request *req)
 {
-    return access("/dev/.booting", F_OK) == 0;
-}
-
-static void process_firmware_event(struct uevent *uevent)
-{
-    char *root, *loading, *data, *file1 = NULL, *file2 = NULL, *file3 = NULL;
-    int l, loading_fd, data_fd, fw_fd;
+    char loading[PATH_MAX], data[PATH_MAX];
+    struct stat st;
+    const char *how = "";
+    long long start;
+    int loading_fd, data_fd, fw_fd, dir;
     int booting = is_booting();
 
-    INFO("firmware: loading '%s' for '%s'\n",
-         uevent->firmware, uevent->path);
+    start = firmware_usecs();
+    INFO("firmware: loading '%s' for '%s'\n", req->firmware, req->root);
 
-    l = asprintf(&root, SYSFS_PREFIX"%s/", uevent->path);
-    if (l == -1)
-        return;
+    snprintf(loading, sizeof(loading), "%sloading", req->root);
+    snprintf(data, sizeof(data), "%sdata", req->root);
 
-    l = asprintf(&loading, "%sloading", root);
-    if (l == -1)
-        goto root_free_out;
-
-    l = asprintf(&data, "%sdata", root);
-    if (l == -1)
-        goto loading_free_out;
-
-    l = asprintf(&file1, FIRMWARE_DIR1"/%s", uevent->firmware);
-    if (l == -1)
-        goto data_free_out;
-
-    l = asprintf(&file2, FIRMWARE_DIR2"/%s", uevent->firmware);
-    if (l == -1)
-        goto data_free_out;
-
-    l = asprintf(&file3, FIRMWARE_DIR3"/%s", uevent->firmware);
-    if (l == -1)
-        goto data_free_out;
-
-    loading_fd = open(loading, O_WRONLY);
+    loading_fd = open(loading, O_WRONLY | O_CLOEXEC);
     if(loading_fd < 0)
-        goto file_free_out;
+        return;
 
-    data_fd = open(data, O_WRONLY);
+    data_fd = open(data, O_WRONLY | O_CLOEXEC);
     if(data_fd < 0)
         goto loading_close_out;
 
-try_loading_again:
-    fw_fd = open(file1, O_RDONLY);
-    if(fw_fd < 0) {
-        fw_fd = open(file2, O_RDONLY);
-        if (fw_fd < 0) {
-            fw_fd = open(file3, O_RDONLY);
-            if (fw_fd < 0) {
-                if (booting) {
-                        /* If we're not fully booted, we may be missing
-                         * filesystems needed for firmware, wait and retry.
-                         */
-                    usleep(100000);
-                    booting = is_booting();
-                    goto try_loading_again;
-                }
-                INFO("firmware: could not open '%s' %d\n", uevent->firmware, errno);
-                write(loading_fd, "-1", 2);
-                goto data_close_out;
-            }
-        }
+    for (;;) {
+        if (!booting)
+            firmware_resolve_dirs();
+        fw_fd = firmware_open(req->firmware, &dir);
+        if (fw_fd >= 0 || !booting)
+            break;
+        /* If we're not fully booted, we may be missing
+         * filesystems needed for firmware, wait and retry.
+         */
+        usleep(FIRMWARE_RETRY_US);
+        booting = is_booting();
+    }
+    if (fw_fd < 0) {
+        INFO("firmware: could not open '%s' %d\n", req->firmware, errno);
+        write(loading_fd, "-1", 2);
+        goto data_close_out;
     }
 
-    if(!load_firmware(fw_fd, loading_fd, data_fd))
-        INFO("firmware: copy success { '%s', '%s' }\n", root, uevent->firmware);
-    else
-        INFO("firmware: copy failure { '%s', '%s' }\n", root, uevent->firmware);
+    if (fstat(fw_fd, &st) < 0 ||
+        load_firmware(fw_fd, loading_fd, data_fd, st.st_size, &how)) {
+        INFO("firmware: copy failure { '%s', '%s' }\n", req->root, req->firmware);
+    } else {
+        long long end = firmware_usecs();
+        INFO("firmware: copy success { '%s', '%s' }\n", req->root, req->firmware);
+        INFO("firmware: '%s' from %s, %lld bytes by %s in %lld uS (%lld uS after the event)\n",
+             req->firmware, firmware_dirs[dir], (long long) st.st_size, how,
+             end - start, end - req->queued);
+    }
 
     close(fw_fd);
 data_close_out:
     close(data_fd);
 loading_close_out:
     close(loading_fd);
-file_free_out:
-    free(file1);
-    free(file2);
-    free(file3);
-data_free_out:
-    free(data);
-loading_free_out:
-    free(loading);
-root_free_out:
-    free(root);
+}
+
+static void *firmware_worker(void *arg)
+{
+    struct listnode *node;
+    struct firmware_request *req;
+
+    pthread_mutex_lock(&fw.lock);
+    for (;;) {
+        while (list_empty(&fw.requests)) {
+            fw.idle++;
+            pthread_cond_wait(&fw.cond, &fw.lock);
+            fw.idle--;
+        }
+        node = list_head(&fw.requests);
+        list_remove(node);
+        fw.queued--;
+        pthread_mutex_unlock(&fw.lock);
+
+        req = node_to_item(node, struct firmware_request, list);
+        process_firmware_request(req);
+        free(req);
+
+        pthread_mutex_lock(&fw.lock);
+    }
+    return NULL;
 }
 
 static void handle_firmware_event(struct uevent *uevent)
 {
-    pid_t pid;
-    int ret;
+    struct firmware_request *req;
+    pthread_attr_t attr;
+    pthread_t thread;
+    size_t root_len, fw_len;
 
     if(strcmp(uevent->subsystem, "firmware"))
         return;
@@ -808,15 +1043,56 @@ static void handle_firmware_event(struct uevent *uevent)
     if(strcmp(uevent->action, "add"))
         return;
 
-    /* we fork, to avoid making large memory allocations in init proper */
-    pid = fork();
-    if (!pid) {
-        process_firmware_event(uevent);
-        exit(EXIT_SUCCESS);
+    /* the strings live in the uevent message, so copy them along */
+    root_len = strlen(SYSFS_PREFIX) + strlen(uevent->path) + 2;
+    fw_len = strlen(uevent->firmware) + 1;
+    req = malloc(sizeof(*req) + root_len + fw_len);
+    if (!req)
+        return;
+    req->queued = firmware_usecs();
+    req->root = (char *) (req + 1);
+    req->firmware = req->root + root_len;
+    snprintf(req->root, root_len, SYSFS_PREFIX"%s/", uevent->path);
+    memcpy(req->firmware, uevent->firmware, fw_len);
+
+    pthread_mutex_lock(&fw.lock);
+    list_add_tail(&fw.requests, &req->list);
+    fw.queued++;
+    if (fw.queued > fw.idle && fw.threads < FIRMWARE_MAX_THREADS) {
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (!pthread_create(&thread, &attr, firmware_worker, NULL))
+            fw.threads++;
+        pthread_attr_destroy(&attr);
     }
+    if (!fw.threads) {
+        /* no worker could be started, serve it here */
+        list_remove(&req->list);
+        fw.queued--;
+        pthread_mutex_unlock(&fw.lock);
+        process_firmware_request(req);
+        free(req);
+        return;
+    }
+    pthread_cond_signal(&fw.cond);
+    pthread_mutex_unlock(&fw.lock);
 }
 
 #define UEVENT_MSG_LEN  1024
+
+static void handle_device_msg(char *msg, int n)
+{
+    struct uevent uevent;
+
+    msg[n] = '\0';
+    msg[n+1] = '\0';
+
+    parse_event(msg, &uevent);
+
+    handle_device_event(&uevent); // ļ 
+    handle_firmware_event(&uevent);
+}
+
 void handle_device_fd()
 {
     char msg[UEVENT_MSG_LEN+2];
@@ -825,14 +1101,7 @@ void handle_device_fd()
         if(n >= UEVENT_MSG_LEN)   /* overflow -- discard */
             continue;
 
-        msg[n] = '\0';
-        msg[n+1] = '\0';
-
-        struct uevent uevent;
-        parse_event(msg, &uevent);
-
-        handle_device_event(&uevent); // ļ 
-        handle_firmware_event(&uevent);
+        handle_device_msg(msg, n);
     }
 }
 
@@ -889,6 +1158,292 @@ static void coldboot(const char *path)
     }
 }
 
+/* Parallel coldboot splits the work in two: a pool of walker threads
+** pokes the uevent files of a sysfs subtree, while the calling thread
+** is the only consumer of the netlink socket and handles the resulting
+** events in batches.  Device handling therefore stays single threaded.
+**
+** A parent directory is always poked before its children are queued,
+** so the kernel emits a parent's event before any of its children's.
+** That is the only ordering guaranteed: walkers on different subtrees
+** interleave freely, unlike the serial walk.
+** Walkers stop poking once COLDBOOT_MAX_INFLIGHT events may be sitting
+** in the socket, to avoid overrunning its buffer.  A poke counts as in
+** flight until its event has been received, or until the socket has
+** been found empty after its write returned (the kernel queues the
+** event before write() returns, and filters some devices entirely).
+*/
+
+#define COLDBOOT_MAX_THREADS    8
+#define COLDBOOT_MAX_INFLIGHT   64
+#define COLDBOOT_BATCH          32
+#define COLDBOOT_POLL_MS        100
+
+struct coldboot_dir {
+    struct listnode list;
+    char *path;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   /* dirs queued, or walk finished */
+    pthread_cond_t drain_cond;  /* consumer made room in the socket */
+    struct listnode dirs;
+    int pending;                /* dirs queued or being visited */
+    int poked;                  /* uevent writes started */
+    int written;                /* uevent writes finished */
+    int seen;                   /* events received by the consumer */
+    int settled;                /* writes known to have been drained */
+    int exiting;
+    int wake_fd[2];             /* wakes the consumer when a walk ends */
+} cb = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .drain_cond = PTHREAD_COND_INITIALIZER,
+    .dirs = { &cb.dirs, &cb.dirs },
+};
+
+/* called with cb.lock held */
+static int coldboot_inflight(void)
+{
+    int drained = cb.seen > cb.settled ? cb.seen : cb.settled;
+
+    return cb.poked - drained;
+}
+
+/* called with cb.lock held */
+static void coldboot_queue_dir(char *path)
+{
+    struct coldboot_dir *dir = malloc(sizeof(*dir));
+    if (!dir) {
+        free(path);
+        return;
+    }
+    dir->path = path;
+    list_add_tail(&cb.dirs, &dir->list);
+    cb.pending++;
+    pthread_cond_signal(&cb.work_cond);
+}
+
+static void coldboot_poke(int dfd)
+{
+    int fd = openat(dfd, "uevent", O_WRONLY);
+    if (fd < 0)
+        return;
+
+    pthread_mutex_lock(&cb.lock);
+    while (coldboot_inflight() >= COLDBOOT_MAX_INFLIGHT)
+        pthread_cond_wait(&cb.drain_cond, &cb.lock);
+    cb.poked++;
+    pthread_mutex_unlock(&cb.lock);
+
+    write(fd, "add\n", 4);
+    close(fd);
+
+    pthread_mutex_lock(&cb.lock);
+    cb.written++;
+    pthread_mutex_unlock(&cb.lock);
+}
+
+static void coldboot_visit(const char *path)
+{
+    struct dirent *de;
+    DIR *d;
+    char *child;
+
+    d = opendir(path);
+    if (!d)
+        return;
+
+    coldboot_poke(dirfd(d));
+
+    while ((de = readdir(d))) {
+        if (de->d_type != DT_DIR || de->d_name[0] == '.')
+            continue;
+        if (asprintf(&child, "%s/%s", path, de->d_name) < 0)
+            continue;
+        pthread_mutex_lock(&cb.lock);
+        coldboot_queue_dir(child);
+        pthread_mutex_unlock(&cb.lock);
+    }
+    closedir(d);
+}
+
+static void *coldboot_walker(void *arg)
+{
+    struct listnode *node;
+    struct coldboot_dir *dir;
+
+    pthread_mutex_lock(&cb.lock);
+    for (;;) {
+        while (list_empty(&cb.dirs) && !cb.exiting)
+            pthread_cond_wait(&cb.work_cond, &cb.lock);
+        if (cb.exiting)
+            break;
+
+        node = list_head(&cb.dirs);
+        list_remove(node);
+        dir = node_to_item(node, struct coldboot_dir, list);
+        pthread_mutex_unlock(&cb.lock);
+
+        coldboot_visit(dir->path);
+        free(dir->path);
+        free(dir);
+
+        pthread_mutex_lock(&cb.lock);
+        if (--cb.pending == 0)
+            write(cb.wake_fd[1], "", 1);
+    }
+    pthread_mutex_unlock(&cb.lock);
+    return NULL;
+}
+
+/* Receives at most COLDBOOT_BATCH events and then handles them together,
+ * adding the number handled to *nevents.  Returns 1 once the socket has
+ * been found empty, or could not be read, and 0 if there may be more.
+ */
+static int coldboot_drain_batch(int *nevents)
+{
+    static char msgs[COLDBOOT_BATCH][UEVENT_MSG_LEN+2];
+    int lens[COLDBOOT_BATCH];
+    int count = 0, received = 0, empty = 0, stop = 0, written, i, n;
+
+    /* writes finished by now have queued their events, if any */
+    pthread_mutex_lock(&cb.lock);
+    written = cb.written;
+    pthread_mutex_unlock(&cb.lock);
+
+    while (count < COLDBOOT_BATCH) {
+        n = uevent_kernel_multicast_recv(device_fd, msgs[count], UEVENT_MSG_LEN);
+        if (n < 0 && errno == EAGAIN) {
+            empty = 1;
+            break;
+        }
+        if (n < 0 && errno != EIO && errno != EINTR) {
+            ERROR("coldboot: could not read uevents: %s\n", strerror(errno));
+            stop = 1;
+            break;
+        }
+        /* EIO is a message libcutils rejected as not from the kernel */
+        if (n <= 0)
+            continue;
+        received++;
+        if (n >= UEVENT_MSG_LEN)   /* overflow -- discard */
+            continue;
+        lens[count++] = n;
+    }
+
+    pthread_mutex_lock(&cb.lock);
+    cb.seen += received;
+    if (empty && written > cb.settled) {
+        /* the socket is empty, so nothing is left of those writes */
+        cb.settled = written;
+    }
+    pthread_cond_broadcast(&cb.drain_cond);
+    pthread_mutex_unlock(&cb.lock);
+
+    for (i = 0; i < count; i++)
+        handle_device_msg(msgs[i], lens[i]);
+    *nevents += count;
+
+    return empty || stop;
+}
+
+/* Walks one sysfs subtree with the walker pool and consumes its events
+ * until the walk is finished and the socket has been drained.
+ */
+static void coldboot_parallel_phase(const char *path, int *nevents)
+{
+    struct pollfd ufds[2];
+    int done;
+    char dummy[16];
+    char *root = strdup(path);
+
+    if (!root)
+        return;
+
+    pthread_mutex_lock(&cb.lock);
+    coldboot_queue_dir(root);
+    pthread_mutex_unlock(&cb.lock);
+
+    ufds[0].fd = device_fd;
+    ufds[0].events = POLLIN;
+    ufds[1].fd = cb.wake_fd[0];
+    ufds[1].events = POLLIN;
+    do {
+        /* sample before draining: every poke of a finished walk has
+         * already queued its event, so the last drain picks it up */
+        pthread_mutex_lock(&cb.lock);
+        done = (cb.pending == 0);
+        pthread_mutex_unlock(&cb.lock);
+
+        ufds[0].revents = ufds[1].revents = 0;
+        poll(ufds, 2, done ? 0 : COLDBOOT_POLL_MS);
+        if (ufds[1].revents & POLLIN)
+            read(cb.wake_fd[0], dummy, sizeof(dummy));
+        while (!coldboot_drain_batch(nevents))
+            ;
+    } while (!done);
+}
+
+static void coldboot_parallel(const char **paths, int npaths, int nthreads)
+{
+    pthread_t threads[COLDBOOT_MAX_THREADS];
+    suseconds_t t0, t1;
+    int started = 0, nevents, i;
+
+    if (nthreads > COLDBOOT_MAX_THREADS)
+        nthreads = COLDBOOT_MAX_THREADS;
+
+    if (pipe(cb.wake_fd) < 0) {
+        ERROR("coldboot: could not create wake pipe, walking serially\n");
+        for (i = 0; i < npaths; i++)
+            coldboot(paths[i]);
+        return;
+    }
+    fcntl(cb.wake_fd[0], F_SETFL, O_NONBLOCK);
+    fcntl(cb.wake_fd[1], F_SETFL, O_NONBLOCK);
+
+    cb.exiting = 0;
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_create(&threads[started], NULL, coldboot_walker, NULL))
+            break;
+        started++;
+    }
+
+    if (!started) {
+        ERROR("coldboot: could not start walker threads, walking serially\n");
+        close(cb.wake_fd[0]);
+        close(cb.wake_fd[1]);
+        for (i = 0; i < npaths; i++)
+            coldboot(paths[i]);
+        return;
+    }
+
+    for (i = 0; i < npaths; i++) {
+        nevents = 0;
+        t0 = get_usecs();
+        coldboot_parallel_phase(paths[i], &nevents);
+        t1 = get_usecs();
+        log_event_print("coldboot %s %ld uS, %d events\n", paths[i],
+                        ((long) (t1 - t0)), nevents);
+    }
+
+    pthread_mutex_lock(&cb.lock);
+    cb.exiting = 1;
+    pthread_cond_broadcast(&cb.work_cond);
+    pthread_mutex_unlock(&cb.lock);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    close(cb.wake_fd[0]);
+    close(cb.wake_fd[1]);
+}
+
+void device_set_coldboot_threads(int nthreads)
+{
+    coldboot_threads = nthreads;
+}
+
 void device_init(void)
 {
     suseconds_t t0, t1;
@@ -912,9 +1467,16 @@ void device_init(void)
     // 豸ʼ 
     if (stat(coldboot_done, &info) < 0) {
         t0 = get_usecs();
-        coldboot("/sys/class");
-        coldboot("/sys/block");
-        coldboot("/sys/devices");
+        if (coldboot_threads > 0) {
+            static const char *paths[] = {
+                "/sys/class", "/sys/block", "/sys/devices",
+            };
+            coldboot_parallel(paths, ARRAY_SIZE(paths), coldboot_threads);
+        } else {
+            coldboot("/sys/class");
+            coldboot("/sys/block");
+            coldboot("/sys/devices");
+        }
         t1 = get_usecs();
         fd = open(coldboot_done, O_WRONLY|O_CREAT, 0000);
         close(fd);
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * What the rc parser needs from the rest of init when it is built for
+ * the host: builtins that are never run, a property table that is
+ * filled in by the caller and kernel log messages on stderr. The
+ * headers under host/sys stand in for bionic's.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/klog.h>
+
+#include "init.h"
+#include "keywords.h"
+#include "property_service.h"
+
+struct selabel_handle *sehandle;
+
+#define HOST_BUILTIN(func) \
+    int func(int nargs, char **args) { return -1; }
+
+HOST_BUILTIN(do_chroot)
+HOST_BUILTIN(do_chdir)
+HOST_BUILTIN(do_class_start)
+HOST_BUILTIN(do_class_stop)
+HOST_BUILTIN(do_class_reset)
+HOST_BUILTIN(do_domainname)
+HOST_BUILTIN(do_exec)
+HOST_BUILTIN(do_export)
+HOST_BUILTIN(do_hostname)
+HOST_BUILTIN(do_ifup)
+HOST_BUILTIN(do_insmod)
+HOST_BUILTIN(do_mkdir)
+HOST_BUILTIN(do_mount_all)
+HOST_BUILTIN(do_mount)
+HOST_BUILTIN(do_powerctl)
+HOST_BUILTIN(do_restart)
+HOST_BUILTIN(do_restorecon)
+HOST_BUILTIN(do_restorecon_recursive)
+HOST_BUILTIN(do_rm)
+HOST_BUILTIN(do_rmdir)
+HOST_BUILTIN(do_setcon)
+HOST_BUILTIN(do_setenforce)
+HOST_BUILTIN(do_setkey)
+HOST_BUILTIN(do_setprop)
+HOST_BUILTIN(do_setrlimit)
+HOST_BUILTIN(do_setsebool)
+HOST_BUILTIN(do_start)
+HOST_BUILTIN(do_stop)
+HOST_BUILTIN(do_swapon_all)
+HOST_BUILTIN(do_trigger)
+HOST_BUILTIN(do_symlink)
+HOST_BUILTIN(do_sysclktz)
+HOST_BUILTIN(do_write)
+HOST_BUILTIN(do_copy)
+HOST_BUILTIN(do_chown)
+HOST_BUILTIN(do_chmod)
+HOST_BUILTIN(do_loglevel)
+HOST_BUILTIN(do_load_persist_props)
+HOST_BUILTIN(do_wait)
+
+struct host_property {
+    struct host_property *next;
+    char name[PROP_NAME_MAX];
+    char value[PROP_VALUE_MAX];
+};
+
+static struct host_property *host_properties;
+
+int property_set(const char *name, const char *value)
+{
+    struct host_property *p;
+
+    if (strlen(name) >= PROP_NAME_MAX || strlen(value) >= PROP_VALUE_MAX)
+        return -1;
+
+    for (p = host_properties; p; p = p->next) {
+        if (!strcmp(p->name, name))
+            break;
+    }
+    if (!p) {
+        p = calloc(1, sizeof(*p));
+        if (!p)
+            return -1;
+        strcpy(p->name, name);
+        p->next = host_properties;
+        host_properties = p;
+    }
+    strcpy(p->value, value);
+    return 0;
+}
+
+int __property_get(const char *name, char *value)
+{
+    struct host_property *p;
+
+    for (p = host_properties; p; p = p->next) {
+        if (!strcmp(p->name, name)) {
+            strcpy(value, p->value);
+            return strlen(value);
+        }
+    }
+    value[0] = 0;
+    return 0;
+}
+
+void klog_write(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (level > KLOG_ERROR_LEVEL)
+        return;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compiles /init.rc.cache at build time from the root directory that
+ * becomes the ramdisk:
+ *
+ *   init_rc_compile [-p name=value]... <root> <cache>
+ *
+ * The rc files are read from under <root> but recorded by the paths
+ * init sees at boot, so the cache is found up to date there. Imports
+ * are expanded with the properties given with -p; if one of them turns
+ * out different on the device the cache is stale and init parses the
+ * rc files as before.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "property_service.h"
+
+/* every rc file init_parser.c and init_cache.c open goes through these */
+#define read_file util_read_file
+#include "../util.c"
+#undef read_file
+
+void *read_file(const char *fn, unsigned *_sz);
+
+static int rc_access(const char *path, int mode);
+
+#define access rc_access
+#include "../init_cache.c"
+#undef access
+
+static const char *root;
+
+static int rooted(char *buf, size_t len, const char *path)
+{
+    if (path[0] != '/' || snprintf(buf, len, "%s%s", root, path) >= (int) len) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+void *read_file(const char *fn, unsigned *_sz)
+{
+    char path[PATH_MAX];
+
+    if (rooted(path, sizeof(path), fn))
+        return NULL;
+    return util_read_file(path, _sz);
+}
+
+static int rc_access(const char *path, int mode)
+{
+    char buf[PATH_MAX];
+
+    if (rooted(buf, sizeof(buf), path))
+        return -1;
+    return access(buf, mode);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-p name=value]... <root> <cache>\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    char *eq;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        switch (opt) {
+        case 'p':
+            eq = strchr(optarg, '=');
+            if (!eq)
+                usage(argv[0]);
+            *eq = 0;
+            if (property_set(optarg, eq + 1)) {
+                fprintf(stderr, "bad property '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2)
+        usage(argv[0]);
+
+    root = argv[optind];
+    return init_cache_compile(argv[optind + 1], "/init.rc");
+}
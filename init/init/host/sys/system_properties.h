@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for bionic's <sys/system_properties.h>. The rc parser
+ * only needs the limits; the property service tests also use the
+ * functions, which host/system_properties.c implements without a
+ * shared property area.
+ */
+
+#ifndef _INIT_HOST_SYS_SYSTEM_PROPERTIES_H
+#define _INIT_HOST_SYS_SYSTEM_PROPERTIES_H
+
+typedef struct prop_info prop_info;
+
+#define PROP_NAME_MAX   32
+#define PROP_VALUE_MAX  92
+
+int __system_property_get(const char *name, char *value);
+const prop_info *__system_property_find(const char *name);
+int __system_property_read(const prop_info *pi, char *name, char *value);
+int __system_property_foreach(void (*propfn)(const prop_info *pi, void *cookie),
+                              void *cookie);
+
+#endif
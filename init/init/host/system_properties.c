@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The bionic property calls init makes, for host builds of the property
+ * service. Properties live in a table private to the process; nothing
+ * is shared and there are no serial wakeups.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
+#include <sys/_system_properties.h>
+
+#define HOST_PROP_MAX 1024
+
+struct prop_info {
+    char name[PROP_NAME_MAX];
+    char value[PROP_VALUE_MAX];
+    unsigned serial;
+};
+
+static prop_info *props[HOST_PROP_MAX];
+static unsigned nprops;
+
+int __system_property_area_init(void)
+{
+    while (nprops)
+        free(props[--nprops]);
+    return 0;
+}
+
+const prop_info *__system_property_find(const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < nprops; i++) {
+        if (!strcmp(props[i]->name, name))
+            return props[i];
+    }
+    return NULL;
+}
+
+int __system_property_read(const prop_info *pi, char *name, char *value)
+{
+    if (name)
+        strcpy(name, pi->name);
+    strcpy(value, pi->value);
+    return strlen(value);
+}
+
+int __system_property_get(const char *name, char *value)
+{
+    const prop_info *pi = __system_property_find(name);
+
+    if (!pi) {
+        value[0] = 0;
+        return 0;
+    }
+    return __system_property_read(pi, NULL, value);
+}
+
+int __system_property_add(const char *name, unsigned int namelen,
+                          const char *value, unsigned int valuelen)
+{
+    prop_info *pi;
+
+    if (namelen >= PROP_NAME_MAX || valuelen >= PROP_VALUE_MAX ||
+            nprops == HOST_PROP_MAX)
+        return -1;
+    pi = calloc(1, sizeof(*pi));
+    if (!pi)
+        return -1;
+    memcpy(pi->name, name, namelen);
+    memcpy(pi->value, value, valuelen);
+    props[nprops++] = pi;
+    return 0;
+}
+
+int __system_property_update(prop_info *pi, const char *value, unsigned int len)
+{
+    if (len >= PROP_VALUE_MAX)
+        return -1;
+    memcpy(pi->value, value, len);
+    pi->value[len] = 0;
+    pi->serial += 2;
+    return 0;
+}
+
+unsigned int __system_property_serial(const prop_info *pi)
+{
+    return pi->serial;
+}
+
+int __system_property_foreach(void (*propfn)(const prop_info *pi, void *cookie),
+                              void *cookie)
+{
+    unsigned i;
+
+    for (i = 0; i < nprops; i++)
+        propfn(props[i], cookie);
+    return 0;
+}
@@ -24,7 +24,10 @@
 #include <sys/wait.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <mtd/mtd-user.h>
@@ -52,10 +55,13 @@
 #include "init.h"
 #include "log.h"
 #include "property_service.h"
+#include "property_watch.h"
 #include "bootchart.h"
 #include "signal_handler.h"
 #include "keychords.h"
 #include "init_parser.h"
+#include "init_cache.h"
+#include "arena.h"
 #include "util.h"
 #include "ueventd.h"
 #include "watchdogd.h"
@@ -67,6 +73,7 @@ static int property_triggers_enabled = 0;
 
 #if BOOTCHART
 static int   bootchart_count;
+static long long bootchart_next;
 #endif
 
 static char console[32];
@@ -79,6 +86,30 @@ static struct action *cur_action = NULL;
 static struct command *cur_command = NULL;
 static struct listnode *command_queue = NULL;
 
+/* The main loop runs queued commands in batches: at most
+ * INIT_CMD_BATCH_MAX commands or INIT_CMD_BUDGET_MS of work per wakeup,
+ * after which pending property sets, signals and keychords get a turn.
+ */
+#define INIT_CMD_BATCH_MAX      32
+#define INIT_CMD_BUDGET_MS      20
+/* init.stats.* are republished at most this often */
+#define INIT_STATS_PUBLISH_MS   1000
+#define INIT_MAX_EVENTS         8
+
+static int epoll_fd = -1;
+static int restart_timer_fd = -1;
+
+/* main loop counters, published as init.stats.* after the queue drains */
+static struct {
+    unsigned wakeups;           /* returns from a blocking epoll_wait */
+    unsigned batches;           /* wakeups that ran at least one command */
+    unsigned commands;
+    unsigned max_batch;         /* most commands run in one wakeup */
+    unsigned max_queue_depth;   /* most actions waiting in action_queue */
+} loop_stats, loop_stats_published;
+static int loop_stats_dirty;
+static long long loop_stats_next_publish;
+
 void notify_service_state(const char *name, const char *state)
 {
     char pname[PROP_NAME_MAX];
@@ -151,8 +182,148 @@ static void publish_socket(const char *name, int fd)
     fcntl(fd, F_SETFD, 0);
 }
 
+/* bumped whenever the result of security_compute_create() may change */
+static unsigned exec_con_gen = 1;
+static unsigned exec_con_hits, exec_con_misses;
+
+void invalidate_exec_contexts(void)
+{
+    exec_con_gen++;
+}
+
+/* Returns the context a service without a seclabel will run in, computed
+ * from init's own context and the label on its executable ('st').
+ */
+static int service_exec_context(struct service *svc, const struct stat *st,
+                                char **scon)
+{
+    char *mycon = NULL, *fcon = NULL;
+    int rc;
+
+    if (svc->exec_con && svc->exec_con_gen == exec_con_gen &&
+        svc->exec_dev == st->st_dev && svc->exec_ino == st->st_ino &&
+        svc->exec_ctime == st->st_ctime) {
+        exec_con_hits++;
+        *scon = strdup(svc->exec_con);
+        return *scon ? 0 : -1;
+    }
+
+    INFO("computing context for service '%s'\n", svc->args[0]);
+    exec_con_misses++;
+    rc = getcon(&mycon);
+    if (rc < 0)
+        return rc;
+
+    rc = getfilecon(svc->args[0], &fcon);
+    if (rc < 0) {
+        freecon(mycon);
+        return rc;
+    }
+
+    rc = security_compute_create(mycon, fcon, string_to_security_class("process"), scon);
+    freecon(mycon);
+    freecon(fcon);
+    if (rc < 0)
+        return rc;
+
+    free(svc->exec_con);
+    svc->exec_con = strdup(*scon);
+    svc->exec_dev = st->st_dev;
+    svc->exec_ino = st->st_ino;
+    svc->exec_ctime = st->st_ctime;
+    svc->exec_con_gen = exec_con_gen;
+    return 0;
+}
+
+/*
+ * Fork to exec latency. Each service gets a slot in a shared anonymous
+ * mapping; the parent stamps the fork time there and the child fills in
+ * how long it took to get to execve(). The parent folds completed slots
+ * into the service's histogram on its next start or when stats are
+ * dumped, so nothing has to wait for the child.
+ */
+struct svc_start_stamp {
+    long long fork_us;
+    volatile unsigned exec_us;  /* since fork_us, 0 until the child gets there */
+    unsigned pending;
+};
+
+#define START_STAMP_PAGE 4096
+
+static struct svc_start_stamp *start_stamps;
+static unsigned start_stamps_left;
+
+static long long uptime_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static struct svc_start_stamp *service_start_stamp(struct service *svc)
+{
+    if (svc->start_stamp)
+        return svc->start_stamp;
+
+    if (!start_stamps_left) {
+        void *page = mmap(NULL, START_STAMP_PAGE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (page == MAP_FAILED)
+            return NULL;
+        start_stamps = page;
+        start_stamps_left = START_STAMP_PAGE / sizeof(*start_stamps);
+    }
+    start_stamps_left--;
+    svc->start_stamp = start_stamps++;
+    return svc->start_stamp;
+}
+
+static void service_collect_start(struct service *svc)
+{
+    struct svc_start_stamp *stamp = svc->start_stamp;
+    unsigned us, bucket;
+
+    if (!stamp || !stamp->pending || !stamp->exec_us)
+        return;
+    us = stamp->exec_us;
+    stamp->pending = 0;
+
+    for (bucket = 0; bucket < SVC_START_HIST_BUCKETS - 1; bucket++) {
+        if (us < (250u << bucket))
+            break;
+    }
+    svc->start_hist[bucket]++;
+    svc->start_count++;
+    if (us > svc->start_max_us)
+        svc->start_max_us = us;
+}
+
+static void service_log_start_stats(struct service *svc)
+{
+    char hist[SVC_START_HIST_BUCKETS * 11 + 1];
+    int i, len = 0;
+
+    service_collect_start(svc);
+    if (!svc->start_count)
+        return;
+    for (i = 0; i < SVC_START_HIST_BUCKETS; i++)
+        len += snprintf(hist + len, sizeof(hist) - len, " %u", svc->start_hist[i]);
+    NOTICE("start '%s': %u starts, max %uus, hist%s\n",
+           svc->name, svc->start_count, svc->start_max_us, hist);
+}
+
+/* "setprop debug.init.svc_start 1" dumps the fork to exec histograms */
+static void dump_service_start_stats(void)
+{
+    NOTICE("start: exec context cache %u hits, %u misses; buckets < 250us "
+           "doubling to >= 64ms\n", exec_con_hits, exec_con_misses);
+    service_for_each(service_log_start_stats);
+}
+
 void service_start(struct service *svc, const char *dynamic_args)
 {
+    struct svc_start_stamp *stamp;
     struct stat s;
     pid_t pid;
     int needs_console;
@@ -204,25 +375,7 @@ void service_start(struct service *svc, const char *dynamic_args)
                 return;
             }
         } else {
-            char *mycon = NULL, *fcon = NULL;
-
-            INFO("computing context for service '%s'\n", svc->args[0]);
-            rc = getcon(&mycon);
-            if (rc < 0) {
-                ERROR("could not get context while starting '%s'\n", svc->name);
-                return;
-            }
-
-            rc = getfilecon(svc->args[0], &fcon);
-            if (rc < 0) {
-                ERROR("could not get context while starting '%s'\n", svc->name);
-                freecon(mycon);
-                return;
-            }
-
-            rc = security_compute_create(mycon, fcon, string_to_security_class("process"), &scon);
-            freecon(mycon);
-            freecon(fcon);
+            rc = service_exec_context(svc, &s, &scon);
             if (rc < 0) {
                 ERROR("could not get context while starting '%s'\n", svc->name);
                 return;
@@ -232,6 +385,14 @@ void service_start(struct service *svc, const char *dynamic_args)
 
     NOTICE("starting '%s'\n", svc->name);
 
+    service_collect_start(svc);
+    stamp = service_start_stamp(svc);
+    if (stamp) {
+        stamp->exec_us = 0;
+        stamp->pending = 1;
+        stamp->fork_us = uptime_us();
+    }
+
     pid = fork();
 
     if (pid == 0) {
@@ -318,6 +479,11 @@ void service_start(struct service *svc, const char *dynamic_args)
             }
         }
 
+        if (stamp) {
+            long long us = uptime_us() - stamp->fork_us;
+            stamp->exec_us = us > 0 ? us : 1;
+        }
+
         if (!dynamic_args) {
             if (execve(svc->args[0], (char**) svc->args, (char**) ENV) < 0) {
                 ERROR("cannot execve('%s'): %s\n", svc->args[0], strerror(errno));
@@ -346,6 +512,8 @@ void service_start(struct service *svc, const char *dynamic_args)
     freecon(scon);
 
     if (pid < 0) {
+        if (stamp)
+            stamp->pending = 0;
         ERROR("failed to start '%s'\n", svc->name);
         svc->pid = 0;
         return;
@@ -409,10 +577,49 @@ void service_restart(struct service *svc)
     } /* else: Service is restarting anyways. */
 }
 
+/* "setprop debug.init.memory 1" reports what the rc data costs */
+static void publish_memory_stats(void)
+{
+    struct arena_stats st;
+    char tmp[16];
+
+    arena_get_stats(&st);
+    NOTICE("arena: %u objects, %u bytes requested, %u bytes in %u blocks; "
+           "separate allocations would use %u bytes\n",
+           st.objects, (unsigned) st.requested, (unsigned) st.reserved,
+           st.blocks, (unsigned) st.heap_estimate);
+    NOTICE("arena: %u strings interned, %u duplicates saving %u bytes\n",
+           st.strings, st.string_hits, (unsigned) st.string_saved);
+
+    snprintf(tmp, sizeof(tmp), "%u", st.objects);
+    property_set("init.memory.objects", tmp);
+    snprintf(tmp, sizeof(tmp), "%u", (unsigned) st.requested);
+    property_set("init.memory.requested", tmp);
+    snprintf(tmp, sizeof(tmp), "%u", (unsigned) st.heap_estimate);
+    property_set("init.memory.heap", tmp);
+    snprintf(tmp, sizeof(tmp), "%u", (unsigned) st.reserved);
+    property_set("init.memory.arena", tmp);
+    snprintf(tmp, sizeof(tmp), "%u", st.blocks);
+    property_set("init.memory.blocks", tmp);
+    /* unused block tails and alignment padding, as a percentage */
+    snprintf(tmp, sizeof(tmp), "%u", st.reserved ?
+             (unsigned) ((st.reserved - st.requested) * 100 / st.reserved) : 0);
+    property_set("init.memory.waste_pct", tmp);
+    snprintf(tmp, sizeof(tmp), "%u", st.strings);
+    property_set("init.memory.strings", tmp);
+    snprintf(tmp, sizeof(tmp), "%u", (unsigned) st.string_saved);
+    property_set("init.memory.string_saved", tmp);
+}
+
 void property_changed(const char *name, const char *value)
 {
     if (property_triggers_enabled)
         queue_property_triggers(name, value);
+    property_watch_notify(name, value);
+    if (!strcmp(name, "debug.init.memory") && !strcmp(value, "1"))
+        publish_memory_stats();
+    if (!strcmp(name, "debug.init.svc_start") && !strcmp(value, "1"))
+        dump_service_start_stats();
 }
 
 static void restart_service_if_needed(struct service *svc)
@@ -431,11 +638,27 @@ static void restart_service_if_needed(struct service *svc)
     }
 }
 
+/* Arms the restart timer for the earliest service restart deadline, or
+ * disarms it when no service is waiting to be restarted.
+ */
+static void arm_restart_timer(void)
+{
+    struct itimerspec its;
+
+    if (restart_timer_fd < 0)
+        return;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = process_needs_restart;
+    timerfd_settime(restart_timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
 static void restart_processes()
 {
     process_needs_restart = 0;
     service_for_each_flags(SVC_RESTARTING,
                            restart_service_if_needed);
+    arm_restart_timer();
 }
 
 static void msg_start(const char *name)
@@ -528,7 +751,8 @@ static int is_last_command(struct action *act, struct command *cmd)
     return (list_tail(&act->commands) == &cmd->clist);
 }
 
-void execute_one_command(void)
+/* returns 1 if a command was run, 0 otherwise */
+int execute_one_command(void)
 {
     int ret;
 
@@ -537,7 +761,7 @@ void execute_one_command(void)
         cur_action = action_remove_queue_head();
         cur_command = NULL;
         if (!cur_action)
-            return;
+            return 0;
         INFO("processing action %p (%s)\n", cur_action, cur_action->name);
         // 获取 cur_action->commands 命令行参数  
         cur_command = get_first_command(cur_action);
@@ -546,11 +770,103 @@ void execute_one_command(void)
     }
 
     if (!cur_command)
-        return;
+        return 0;
     
     // 执行 action 指定的程序，传入指定的命令行参数  
     ret = cur_command->func(cur_command->nargs, cur_command->args);
     INFO("command '%s' r=%d\n", cur_command->args[0], ret);
+    return 1;
+}
+
+static long long uptime_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void publish_loop_stat(const char *name, unsigned value,
+                              unsigned *published)
+{
+    char tmp[16];
+
+    if (value == *published)
+        return;
+    snprintf(tmp, sizeof(tmp), "%u", value);
+    property_set(name, tmp);
+    *published = value;
+}
+
+/* Publishes the counters that changed since the last call, but no more
+ * often than INIT_STATS_PUBLISH_MS: every property_set goes through
+ * trigger matching and the watch path.
+ * Returns the ms until the next call is due, or -1 if nothing is pending.
+ */
+static int publish_loop_stats(void)
+{
+    long long now;
+
+    if (!loop_stats_dirty)
+        return -1;
+    now = uptime_ms();
+    if (now < loop_stats_next_publish)
+        return loop_stats_next_publish - now;
+
+    publish_loop_stat("init.stats.wakeups", loop_stats.wakeups,
+                      &loop_stats_published.wakeups);
+    publish_loop_stat("init.stats.batches", loop_stats.batches,
+                      &loop_stats_published.batches);
+    publish_loop_stat("init.stats.commands", loop_stats.commands,
+                      &loop_stats_published.commands);
+    publish_loop_stat("init.stats.max_batch", loop_stats.max_batch,
+                      &loop_stats_published.max_batch);
+    publish_loop_stat("init.stats.max_queue_depth", loop_stats.max_queue_depth,
+                      &loop_stats_published.max_queue_depth);
+    loop_stats_dirty = 0;
+    loop_stats_next_publish = now + INIT_STATS_PUBLISH_MS;
+    return -1;
+}
+
+/* Runs queued commands until the queue is empty, INIT_CMD_BATCH_MAX
+ * commands have run or INIT_CMD_BUDGET_MS has passed.
+ * Returns the number of commands run.
+ */
+static int execute_command_batch(void)
+{
+    long long deadline = uptime_ms() + INIT_CMD_BUDGET_MS;
+    unsigned depth = action_queue_depth();
+    int count = 0;
+
+    if (depth > loop_stats.max_queue_depth)
+        loop_stats.max_queue_depth = depth;
+
+    while (count < INIT_CMD_BATCH_MAX &&
+            (cur_action || !action_queue_empty())) {
+        count += execute_one_command();
+        if (uptime_ms() >= deadline)
+            break;
+    }
+
+    if (count) {
+        loop_stats.batches++;
+        loop_stats.commands += count;
+        if ((unsigned) count > loop_stats.max_batch)
+            loop_stats.max_batch = count;
+        if (!cur_action && action_queue_empty() && properties_inited())
+            loop_stats_dirty = 1;
+    }
+    return count;
+}
+
+static void epoll_add_fd(int fd)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        ERROR("epoll_ctl(%d) failed: %s\n", fd, strerror(errno));
 }
 
 static int wait_for_coldboot_done_action(int nargs, char **args)
@@ -803,6 +1119,7 @@ static int property_service_init_action(int nargs, char **args)
      * that /data/local.prop cannot interfere with them.
      */
     start_property_service();
+    start_property_watch();
     return 0;
 }
 
@@ -843,7 +1160,8 @@ static int bootchart_init_action(int nargs, char **args)
     if (bootchart_count < 0) {
         ERROR("bootcharting init failure\n");
     } else if (bootchart_count > 0) {
-        NOTICE("bootcharting started (period=%d ms)\n", bootchart_count*BOOTCHART_POLLING_MS);
+        NOTICE("bootcharting started (period=%d ms, %d samples)\n",
+               bootchart_period_ms(), bootchart_count);
     } else {
         NOTICE("bootcharting ignored\n");
     }
@@ -945,6 +1263,7 @@ int selinux_reload_policy(void)
         selabel_close(sehandle_prop);
 
     selinux_init_all_handles();
+    invalidate_exec_contexts();
     return 0;
 }
 
@@ -978,15 +1297,18 @@ static void selinux_initialize(void)
 
 int main(int argc, char **argv)
 {
-    int fd_count = 0;
-    struct pollfd ufds[4];
+    struct epoll_event events[INIT_MAX_EVENTS];
     char *tmpdev;
     char* debuggable;
     char tmp[32];
     int property_set_fd_init = 0;
+    int property_conn_fd_init = 0;
+    int property_watch_fd_init = 0;
     int signal_fd_init = 0;
     int keychord_fd_init = 0;
+    int persist_flush_fd_init = 0;
     bool is_charger = false;
+    long long config_start;
 
     if (!strcmp(basename(argv[0]), "ueventd"))
         return ueventd_main(argc, argv);
@@ -994,6 +1316,17 @@ int main(int argc, char **argv)
     if (!strcmp(basename(argv[0]), "watchdogd"))
         return watchdogd_main(argc, argv);
 
+    /* init --compile-rc|--verify-rc <cache> [<rc>] */
+    if (argc > 2 && !strcmp(argv[1], "--compile-rc"))
+        return init_cache_compile(argv[2], argc > 3 ? argv[3] : "/init.rc");
+    if (argc > 2 && !strcmp(argv[1], "--verify-rc"))
+        return init_cache_verify(argv[2], argc > 3 ? argv[3] : "/init.rc");
+#if BOOTCHART
+    /* init --bootchart-convert <bootchart.bin> [<dir>] */
+    if (argc > 2 && !strcmp(argv[1], "--bootchart-convert"))
+        return bootchart_convert(argv[2], argc > 3 ? argv[3] : ".") ? 1 : 0;
+#endif
+
     /* clear the umask */
     umask(0);
 
@@ -1083,7 +1416,13 @@ int main(int argc, char **argv)
     // 递归解析rc文件，生成服务列表与动作列表：
     // 动作列表与服务列表会以列表的形式注册到（全局结构体）service_list 与 action_list 中 
     INFO("reading config file\n");
-    init_parse_config_file("/init.rc");
+    config_start = uptime_ms();
+    if (!init_cache_load(INIT_RC_CACHE, "/init.rc")) {
+        INFO("loaded %s in %lldms\n", INIT_RC_CACHE, uptime_ms() - config_start);
+    } else {
+        init_parse_config_file("/init.rc");
+        INFO("parsed /init.rc in %lldms\n", uptime_ms() - config_start);
+    }
 
     /*
      * action 命令优先顺序：
@@ -1145,6 +1484,20 @@ int main(int argc, char **argv)
     queue_builtin_action(bootchart_init_action, "bootchart_init");
 #endif
 
+    epoll_fd = epoll_create(INIT_MAX_EVENTS);
+    if (epoll_fd < 0) {
+        ERROR("epoll_create failed: %s\n", strerror(errno));
+        return 1;
+    }
+    fcntl(epoll_fd, F_SETFD, FD_CLOEXEC);
+
+    /* one timer for all service restarts, armed at the earliest deadline */
+    restart_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (restart_timer_fd >= 0)
+        epoll_add_fd(restart_timer_fd);
+    else
+        ERROR("timerfd_create failed: %s\n", strerror(errno));
+
     // 进入无限循环，建立init的子进程（init是所有进程的父进程） 
     for(;;) {
         int nr, i, timeout = -1;
@@ -1154,81 +1507,111 @@ int main(int argc, char **argv)
          * 如果不为空则，从 action_queue 列表上移除头结点(action),
          * 并执行摘取的 action 命令（子进程对应的命令） 
          */  
-        execute_one_command();
-        
-        /*
-         * 遍历 service_list 列表，
-         * 如果列表中服务 flags 标记为 SVC_RESTARTING(进程已经死去标志), 
-         * 则重新启动该 action 命令
-         */
-        restart_processes();
+        /* commands may reap children (signal_init), so pick up any
+         * service that now needs restarting */
+        if (execute_command_batch())
+            restart_processes();
 
-        // 注册init进程监控的文件描述符 
-        // 获取prop信号句柄 
+        // 注册init进程监控的文件描述符，每个只注册一次 
         if (!property_set_fd_init && get_property_set_fd() > 0) {
-            ufds[fd_count].fd = get_property_set_fd();
-            ufds[fd_count].events = POLLIN;
-            ufds[fd_count].revents = 0;
-            fd_count++;
+            epoll_add_fd(get_property_set_fd());
             property_set_fd_init = 1;
         }
-        // 获取子进程监控信号句柄 
+        if (!property_conn_fd_init && get_property_conn_fd() > 0) {
+            epoll_add_fd(get_property_conn_fd());
+            property_conn_fd_init = 1;
+        }
+        if (!property_watch_fd_init && get_property_watch_fd() > 0) {
+            epoll_add_fd(get_property_watch_fd());
+            property_watch_fd_init = 1;
+        }
         if (!signal_fd_init && get_signal_fd() > 0) {
-            ufds[fd_count].fd = get_signal_fd();
-            ufds[fd_count].events = POLLIN;
-            ufds[fd_count].revents = 0;
-            fd_count++;
+            epoll_add_fd(get_signal_fd());
             signal_fd_init = 1;
         }
-        // 
         if (!keychord_fd_init && get_keychord_fd() > 0) {
-            ufds[fd_count].fd = get_keychord_fd();
-            ufds[fd_count].events = POLLIN;
-            ufds[fd_count].revents = 0;
-            fd_count++;
+            epoll_add_fd(get_keychord_fd());
             keychord_fd_init = 1;
         }
+        if (!persist_flush_fd_init && get_persist_flush_fd() > 0) {
+            epoll_add_fd(get_persist_flush_fd());
+            persist_flush_fd_init = 1;
+        }
 
-        if (process_needs_restart) {
+        if (!action_queue_empty() || cur_action) {
+            timeout = 0;
+        } else {
+            int stats_ms = publish_loop_stats();
+            if (stats_ms >= 0)
+                timeout = stats_ms;
+        }
+
+        /* without a restart timer, fall back to waking up for restarts */
+        if (restart_timer_fd < 0 && process_needs_restart && timeout != 0) {
             timeout = (process_needs_restart - gettime()) * 1000;
             if (timeout < 0)
                 timeout = 0;
         }
 
-        if (!action_queue_empty() || cur_action)
-            timeout = 0;
-
 #if BOOTCHART
+        /* sample once per period, not on every pass of the loop */
         if (bootchart_count > 0) {
-            if (timeout < 0 || timeout > BOOTCHART_POLLING_MS)
-                timeout = BOOTCHART_POLLING_MS;
-            if (bootchart_step() < 0 || --bootchart_count == 0) {
-                bootchart_finish();
-                bootchart_count = 0;
+            long long now = uptime_ms();
+            if (now >= bootchart_next) {
+                bootchart_next = now + bootchart_period_ms();
+                if (bootchart_step() < 0 || --bootchart_count == 0) {
+                    bootchart_finish();
+                    bootchart_count = 0;
+                }
             }
+            if (bootchart_count > 0 &&
+                (timeout < 0 || timeout > bootchart_next - now))
+                timeout = bootchart_next - now;
         }
 #endif
 
-        // 监听三种事件 （prop服务，子进程signal，keychord ） 
-        nr = poll(ufds, fd_count, timeout);
-        if (nr <= 0)
+        /* push this pass's property changes to subscribers in one go */
+        property_watch_flush();
+
+        // 监听事件 （prop服务，子进程signal，keychord，服务重启定时器） 
+        nr = epoll_wait(epoll_fd, events, INIT_MAX_EVENTS, timeout);
+        if (timeout != 0)
+            loop_stats.wakeups++;
+        if (nr <= 0) {
+            if (restart_timer_fd < 0 && process_needs_restart)
+                restart_processes();
             continue;
+        }
 
-        for (i = 0; i < fd_count; i++) {
-            if (ufds[i].revents == POLLIN) {
-                if (ufds[i].fd == get_property_set_fd())
-                    // 有进程请求修改prop属性 
-                    // 1. 先检查属性的访问权限 
-                    // 2. 在更改值(__system_property_update/__system_property_add) 
-                    // 3. 最后再出发更改以后的触发器 
-                    handle_property_set_fd();
-                else if (ufds[i].fd == get_keychord_fd())
-                    // adbd 相关服务 
-                    handle_keychord();
-                else if (ufds[i].fd == get_signal_fd())
-                    // 如果是子进程有退出 
-                    // 则调用 handle_signal 设置服务为 SVC_RESTARTING 标志 
-                    handle_signal();
+        for (i = 0; i < nr; i++) {
+            int fd = events[i].data.fd;
+
+            if (!(events[i].events & EPOLLIN))
+                continue;
+            if (fd == get_property_set_fd()) {
+                // 有进程请求修改prop属性 
+                // 1. 先检查属性的访问权限 
+                // 2. 在更改值(__system_property_update/__system_property_add) 
+                // 3. 最后再出发更改以后的触发器 
+                handle_property_set_fd();
+            } else if (fd == get_property_conn_fd()) {
+                handle_property_conn_fd();
+            } else if (fd == get_property_watch_fd()) {
+                handle_property_watch_fd();
+            } else if (fd == get_keychord_fd()) {
+                // adbd 相关服务 
+                handle_keychord();
+            } else if (fd == get_signal_fd()) {
+                // 如果是子进程有退出 
+                // 则调用 handle_signal 设置服务为 SVC_RESTARTING 标志 
+                handle_signal();
+                restart_processes();
+            } else if (fd == get_persist_flush_fd()) {
+                handle_persist_flush_fd();
+            } else if (fd == restart_timer_fd) {
+                uint64_t expirations;
+                read(restart_timer_fd, &expirations, sizeof(expirations));
+                restart_processes();
             }
         }
     }
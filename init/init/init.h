@@ -41,7 +41,10 @@ struct action {
         /* node in list of actions for a trigger */
     struct listnode tlist;
 
+        /* hash of the property trigger, see prop_trigger_index_add() */
     unsigned hash;
+        /* position in action_list, used to keep trigger order */
+    unsigned seq;
     const char *name;
     
     struct listnode commands;
@@ -78,6 +81,11 @@ struct svcenvinfo {
 
 #define COMMAND_RETRY_TIMEOUT 5
 
+/* fork to exec latency buckets: < 250us, < 500us, ... < 64ms, >= 64ms */
+#define SVC_START_HIST_BUCKETS 10
+
+struct svc_start_stamp;
+
 struct service {
         /* list of all services */
     struct listnode slist;
@@ -111,6 +119,20 @@ struct service {
     int ioprio_class;
     int ioprio_pri;
 
+        /* exec context computed for services without a seclabel, valid
+         * while the executable (including its label, hence ctime) and
+         * the policy generation are unchanged */
+    char *exec_con;
+    dev_t exec_dev;
+    ino_t exec_ino;
+    time_t exec_ctime;
+    unsigned exec_con_gen;
+
+    struct svc_start_stamp *start_stamp;
+    unsigned start_hist[SVC_START_HIST_BUCKETS];
+    unsigned start_count;
+    unsigned start_max_us;
+
     int nargs;
     /* "MUST BE AT THE END OF THE STRUCT" */
     char *args[1];
@@ -139,5 +161,6 @@ int load_565rle_image( char *file_name );
 extern struct selabel_handle *sehandle;
 extern struct selabel_handle *sehandle_prop;
 extern int selinux_reload_policy(void);
+void invalidate_exec_contexts(void);
 
 #endif	/* _INIT_INIT_H */
@@ -0,0 +1,892 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compiled init.rc cache.
+ *
+ * The image is a header followed by fixed size records that only hold
+ * 32 bit words: counts, flags, offsets from the start of the image and
+ * references into a string table at the end (0 is NULL, n is the string
+ * at n - 1). Commands are stored by keyword rather than by function so
+ * nothing in the image depends on where init was loaded.
+ *
+ * It is keyed by a hash over the path, size and contents of every rc
+ * file the parser read, in order, plus the expansion of every import.
+ * At boot the image is mapped, the inputs are hashed again and, if they
+ * still match, the service and action lists are built from it in one
+ * allocation with the strings left in the mapping.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cutils/list.h>
+
+#include "arena.h"
+#include "init.h"
+#include "init_cache.h"
+#include "init_parser.h"
+#include "log.h"
+#include "util.h"
+
+#define CACHE_MAGIC     0x31435243  /* "CRC1" */
+#define CACHE_VERSION   1
+
+struct cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t keywords;          /* keyword_table_hash() of the writer */
+    uint32_t hash_lo;
+    uint32_t hash_hi;
+    uint32_t ninputs, inputs;   /* string refs, parse order */
+    uint32_t nimports, imports;
+    uint32_t nservices, services;
+    uint32_t nactions, actions;
+    uint32_t strings, strings_size;
+};
+
+struct cache_import {
+    uint32_t raw;
+    uint32_t path;
+};
+
+struct cache_service {
+    uint32_t name;
+    uint32_t classname;
+    uint32_t seclabel;
+    uint32_t flags;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t nr_supp_gids;
+    uint32_t supp_gids[NR_SVC_SUPP_GIDS];
+    uint32_t ioprio_class;
+    uint32_t ioprio_pri;
+    uint32_t nargs, args;       /* array of string refs */
+    uint32_t nsockets, sockets;
+    uint32_t nenvvars, envvars;
+    uint32_t nkeycodes, keycodes;
+    uint32_t ncommands, onrestart;
+};
+
+struct cache_socket {
+    uint32_t name;
+    uint32_t type;
+    uint32_t perm;
+    uint32_t uid;
+    uint32_t gid;
+};
+
+struct cache_env {
+    uint32_t name;
+    uint32_t value;
+};
+
+struct cache_action {
+    uint32_t name;
+    uint32_t ncommands, commands;
+};
+
+/* commands are packed back to back as { keyword, nargs, args[nargs] } */
+
+/* what the parser read, for the writer */
+struct rc_input {
+    char *path;
+};
+
+struct rc_import {
+    char *raw;
+    char *path;
+};
+
+static struct rc_input *inputs;
+static struct rc_import *imports;
+static unsigned ninputs, nimports;
+static uint64_t input_hash = 14695981039346656037ULL;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len--) {
+        hash ^= *p++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_input(uint64_t hash, const char *fn,
+                           const char *data, unsigned len)
+{
+    uint32_t size = len;
+
+    hash = fnv1a(hash, fn, strlen(fn) + 1);
+    hash = fnv1a(hash, &size, sizeof(size));
+    return fnv1a(hash, data, len);
+}
+
+void init_cache_add_input(const char *fn, const char *data, unsigned len)
+{
+    struct rc_input *n;
+
+    n = realloc(inputs, sizeof(*inputs) * (ninputs + 1));
+    if (!n)
+        return;
+    inputs = n;
+    inputs[ninputs++].path = strdup(fn);
+    input_hash = hash_input(input_hash, fn, data, len);
+}
+
+void init_cache_add_import(const char *raw, const char *path)
+{
+    struct rc_import *n;
+
+    n = realloc(imports, sizeof(*imports) * (nimports + 1));
+    if (!n)
+        return;
+    imports = n;
+    imports[nimports].raw = strdup(raw);
+    imports[nimports].path = strdup(path);
+    nimports++;
+}
+
+/*
+ * Writer. Records go into one growable buffer and are addressed by
+ * offset since the buffer moves; strings are deduplicated into a
+ * second buffer that is appended at the end.
+ */
+
+#define STRING_HASH_SIZE 1024
+
+struct cache_writer {
+    char *buf;
+    uint32_t len;
+    uint32_t cap;
+
+    char *strings;
+    uint32_t strings_len;
+    uint32_t strings_cap;
+    uint32_t *string_ref;       /* ref of the first string in each chain */
+    uint32_t *string_next;      /* next ref in the chain, by ref */
+    uint32_t string_next_cap;
+
+    uint32_t next_service;
+    uint32_t next_action;
+    int error;
+};
+
+static struct cache_writer *writer;
+
+static uint32_t cache_reserve(struct cache_writer *w, uint32_t size)
+{
+    uint32_t off = w->len;
+
+    size = (size + 3) & ~3;
+    if (w->len + size > w->cap) {
+        uint32_t cap = w->cap ? w->cap : 16384;
+        char *n;
+
+        while (w->len + size > cap)
+            cap *= 2;
+        n = realloc(w->buf, cap);
+        if (!n) {
+            w->error = 1;
+            return 0;
+        }
+        w->buf = n;
+        w->cap = cap;
+    }
+    memset(w->buf + off, 0, size);
+    w->len += size;
+    return off;
+}
+
+#define cache_at(w, off) ((void *) ((w)->buf + (off)))
+
+static uint32_t cache_string(struct cache_writer *w, const char *s)
+{
+    unsigned hash = 0;
+    uint32_t len, ref;
+    const char *p;
+
+    if (!s)
+        return 0;
+    for (p = s; *p; p++)
+        hash = hash * 31 + (unsigned char) *p;
+    len = p - s + 1;
+
+    for (ref = w->string_ref[hash & (STRING_HASH_SIZE - 1)]; ref;
+         ref = w->string_next[ref]) {
+        if (!strcmp(w->strings + ref - 1, s))
+            return ref;
+    }
+
+    if (w->strings_len + len > w->strings_cap) {
+        uint32_t cap = w->strings_cap ? w->strings_cap : 16384;
+        char *n;
+
+        while (w->strings_len + len > cap)
+            cap *= 2;
+        n = realloc(w->strings, cap);
+        if (!n) {
+            w->error = 1;
+            return 0;
+        }
+        w->strings = n;
+        w->strings_cap = cap;
+    }
+    /* string_next is indexed by ref, which is at most strings_len + 1 */
+    if (w->strings_len + 2 > w->string_next_cap) {
+        uint32_t cap = w->strings_cap + 2;
+        uint32_t *n = realloc(w->string_next, sizeof(*n) * cap);
+
+        if (!n) {
+            w->error = 1;
+            return 0;
+        }
+        w->string_next = n;
+        w->string_next_cap = cap;
+    }
+
+    ref = w->strings_len + 1;
+    memcpy(w->strings + w->strings_len, s, len);
+    w->strings_len += len;
+    w->string_next[ref] = w->string_ref[hash & (STRING_HASH_SIZE - 1)];
+    w->string_ref[hash & (STRING_HASH_SIZE - 1)] = ref;
+    return ref;
+}
+
+static uint32_t cache_put_commands(struct cache_writer *w,
+                                   struct listnode *commands, uint32_t *count)
+{
+    struct listnode *node;
+    uint32_t first = w->len;
+
+    *count = 0;
+    list_for_each(node, commands) {
+        struct command *cmd = node_to_item(node, struct command, clist);
+        int kw = command_keyword(cmd->func);
+        uint32_t off, ref;
+        int i;
+
+        if (!kw) {
+            ERROR("cannot cache builtin command '%s'\n", cmd->args[0]);
+            w->error = 1;
+            return 0;
+        }
+        off = cache_reserve(w, sizeof(uint32_t) * (2 + cmd->nargs));
+        if (w->error)
+            return 0;
+        ((uint32_t *) cache_at(w, off))[0] = kw;
+        ((uint32_t *) cache_at(w, off))[1] = cmd->nargs;
+        for (i = 0; i < cmd->nargs; i++) {
+            ref = cache_string(w, cmd->args[i]);
+            ((uint32_t *) cache_at(w, off))[2 + i] = ref;
+        }
+        (*count)++;
+    }
+    return *count ? first : 0;
+}
+
+static void cache_put_service(struct service *svc)
+{
+    struct cache_writer *w = writer;
+    struct cache_service *cs;
+    struct socketinfo *si;
+    struct svcenvinfo *ei;
+    uint32_t off = w->next_service;
+    uint32_t n, ref, i, count;
+
+    w->next_service += sizeof(*cs);
+    if (w->error)
+        return;
+
+        /* fields are written one at a time, anything below can move buf */
+#define CS ((struct cache_service *) cache_at(w, off))
+    CS->name = cache_string(w, svc->name);
+    CS->classname = cache_string(w, svc->classname);
+    CS->seclabel = cache_string(w, svc->seclabel);
+    CS->flags = svc->flags;
+    CS->uid = svc->uid;
+    CS->gid = svc->gid;
+    CS->nr_supp_gids = svc->nr_supp_gids;
+    for (i = 0; i < NR_SVC_SUPP_GIDS; i++)
+        CS->supp_gids[i] = svc->supp_gids[i];
+    CS->ioprio_class = svc->ioprio_class;
+    CS->ioprio_pri = svc->ioprio_pri;
+
+    n = cache_reserve(w, sizeof(uint32_t) * svc->nargs);
+    CS->nargs = svc->nargs;
+    CS->args = n;
+    for (i = 0; i < (uint32_t) svc->nargs && !w->error; i++) {
+        ref = cache_string(w, svc->args[i]);
+        ((uint32_t *) cache_at(w, n))[i] = ref;
+    }
+
+    for (count = 0, si = svc->sockets; si; si = si->next)
+        count++;
+    n = cache_reserve(w, sizeof(struct cache_socket) * count);
+    CS->nsockets = count;
+    CS->sockets = n;
+    for (i = 0, si = svc->sockets; si && !w->error; si = si->next, i++) {
+        struct cache_socket cso;
+
+        cso.name = cache_string(w, si->name);
+        cso.type = cache_string(w, si->type);
+        cso.perm = si->perm;
+        cso.uid = si->uid;
+        cso.gid = si->gid;
+        memcpy(cache_at(w, n + i * sizeof(cso)), &cso, sizeof(cso));
+    }
+
+    for (count = 0, ei = svc->envvars; ei; ei = ei->next)
+        count++;
+    n = cache_reserve(w, sizeof(struct cache_env) * count);
+    CS->nenvvars = count;
+    CS->envvars = n;
+    for (i = 0, ei = svc->envvars; ei && !w->error; ei = ei->next, i++) {
+        struct cache_env ce;
+
+        ce.name = cache_string(w, ei->name);
+        ce.value = cache_string(w, ei->value);
+        memcpy(cache_at(w, n + i * sizeof(ce)), &ce, sizeof(ce));
+    }
+
+    n = cache_reserve(w, sizeof(uint32_t) * svc->nkeycodes);
+    CS->nkeycodes = svc->nkeycodes;
+    CS->keycodes = n;
+    for (i = 0; i < (uint32_t) svc->nkeycodes && !w->error; i++)
+        ((uint32_t *) cache_at(w, n))[i] = svc->keycodes[i];
+
+    n = cache_put_commands(w, &svc->onrestart.commands, &count);
+    if (w->error)
+        return;
+    CS->ncommands = count;
+    CS->onrestart = n;
+#undef CS
+}
+
+static void cache_put_action(struct action *act)
+{
+    struct cache_writer *w = writer;
+    uint32_t off = w->next_action;
+    uint32_t name, commands, count;
+
+    w->next_action += sizeof(struct cache_action);
+    if (w->error)
+        return;
+
+    name = cache_string(w, act->name);
+    commands = cache_put_commands(w, &act->commands, &count);
+    if (w->error)
+        return;
+    ((struct cache_action *) cache_at(w, off))->name = name;
+    ((struct cache_action *) cache_at(w, off))->ncommands = count;
+    ((struct cache_action *) cache_at(w, off))->commands = commands;
+}
+
+static unsigned count_services, count_actions;
+
+static void count_service(struct service *svc)
+{
+    count_services++;
+}
+
+static void count_action(struct action *act)
+{
+    count_actions++;
+}
+
+int init_cache_save(const char *fn)
+{
+    struct cache_writer w;
+    struct cache_header *hdr;
+    char tmp[PATH_MAX];
+    uint32_t off, ref;
+    unsigned i;
+    int fd, ret = -1;
+
+    memset(&w, 0, sizeof(w));
+    w.string_ref = calloc(STRING_HASH_SIZE, sizeof(*w.string_ref));
+    if (!w.string_ref)
+        return -1;
+
+    count_services = count_actions = 0;
+    service_for_each(count_service);
+    action_for_each(count_action);
+
+    cache_reserve(&w, sizeof(*hdr));
+    if (w.error)
+        goto out;
+    off = cache_reserve(&w, sizeof(uint32_t) * ninputs);
+    for (i = 0; i < ninputs && !w.error; i++) {
+        ref = cache_string(&w, inputs[i].path);
+        ((uint32_t *) cache_at(&w, off))[i] = ref;
+    }
+    hdr = cache_at(&w, 0);
+    hdr->ninputs = ninputs;
+    hdr->inputs = off;
+
+    off = cache_reserve(&w, sizeof(struct cache_import) * nimports);
+    for (i = 0; i < nimports && !w.error; i++) {
+        struct cache_import ci;
+
+        ci.raw = cache_string(&w, imports[i].raw);
+        ci.path = cache_string(&w, imports[i].path);
+        memcpy(cache_at(&w, off + i * sizeof(ci)), &ci, sizeof(ci));
+    }
+    hdr = cache_at(&w, 0);
+    hdr->nimports = nimports;
+    hdr->imports = off;
+
+    w.next_service = cache_reserve(&w, sizeof(struct cache_service) * count_services);
+    w.next_action = cache_reserve(&w, sizeof(struct cache_action) * count_actions);
+    hdr = cache_at(&w, 0);
+    hdr->nservices = count_services;
+    hdr->services = w.next_service;
+    hdr->nactions = count_actions;
+    hdr->actions = w.next_action;
+
+    writer = &w;
+    service_for_each(cache_put_service);
+    action_for_each(cache_put_action);
+    writer = NULL;
+
+    if (w.error)
+        goto out;
+
+    hdr = cache_at(&w, 0);
+    hdr->magic = CACHE_MAGIC;
+    hdr->version = CACHE_VERSION;
+    hdr->keywords = keyword_table_hash();
+    hdr->hash_lo = (uint32_t) input_hash;
+    hdr->hash_hi = (uint32_t) (input_hash >> 32);
+    hdr->strings = w.len;
+    hdr->strings_size = w.strings_len;
+    hdr->size = w.len + w.strings_len;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", fn);
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ERROR("could not create '%s': %s\n", tmp, strerror(errno));
+        goto out;
+    }
+    if (write(fd, w.buf, w.len) != (ssize_t) w.len ||
+        write(fd, w.strings, w.strings_len) != (ssize_t) w.strings_len ||
+        fsync(fd)) {
+        ERROR("could not write '%s': %s\n", tmp, strerror(errno));
+        close(fd);
+        unlink(tmp);
+        goto out;
+    }
+    close(fd);
+    if (rename(tmp, fn)) {
+        ERROR("could not rename '%s': %s\n", tmp, strerror(errno));
+        unlink(tmp);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    free(w.buf);
+    free(w.strings);
+    free(w.string_ref);
+    free(w.string_next);
+    return ret;
+}
+
+/*
+ * Reader. The image is walked twice: once without a destination to
+ * check every offset and reference and size the allocation, then again
+ * to fill it in. Nothing can fail on the second walk, so the lists are
+ * only modified once the whole image is known to be good.
+ */
+
+struct cache_image {
+    char *base;
+    size_t size;
+    const struct cache_header *hdr;
+};
+
+struct cache_walk {
+    const struct cache_image *img;
+    char *block;
+    size_t used;
+    int error;
+};
+
+#define CACHE_ALIGN(n) (((n) + 7) & ~7)
+
+static const void *cache_array(struct cache_walk *w, uint32_t off,
+                               uint32_t count, size_t size)
+{
+    if (!count)
+        return NULL;
+    if (off < sizeof(struct cache_header) || off & 3 ||
+        off > w->img->hdr->strings ||
+        count > (w->img->hdr->strings - off) / size) {
+        w->error = 1;
+        return NULL;
+    }
+    return w->img->base + off;
+}
+
+static char *cache_str(struct cache_walk *w, uint32_t ref)
+{
+    if (!ref)
+        return NULL;
+    if (ref > w->img->hdr->strings_size) {
+        w->error = 1;
+        return NULL;
+    }
+    return w->img->base + w->img->hdr->strings + ref - 1;
+}
+
+static void *carve(struct cache_walk *w, size_t size)
+{
+    void *p = w->block ? w->block + w->used : NULL;
+
+    w->used += CACHE_ALIGN(size);
+    return p;
+}
+
+static void walk_commands(struct cache_walk *w, struct listnode *list,
+                          uint32_t off, uint32_t count)
+{
+    const uint32_t *words;
+    uint32_t i, j, nargs;
+
+    for (i = 0; i < count && !w->error; i++) {
+        struct command *cmd;
+        int (*func)(int nargs, char **args);
+
+        words = cache_array(w, off, 2, sizeof(uint32_t));
+        if (!words)
+            return;
+        nargs = words[1];
+        func = command_func(words[0], nargs);
+        words = cache_array(w, off, 2 + nargs, sizeof(uint32_t));
+        if (!words || !func || nargs > INIT_PARSER_MAXARGS) {
+            w->error = 1;
+            return;
+        }
+        off += sizeof(uint32_t) * (2 + nargs);
+
+        cmd = carve(w, sizeof(*cmd) + sizeof(char *) * nargs);
+        if (cmd) {
+            cmd->func = func;
+            cmd->nargs = nargs;
+        }
+        for (j = 0; j < nargs; j++) {
+            char *arg = cache_str(w, words[2 + j]);
+            if (cmd)
+                cmd->args[j] = arg;
+        }
+        if (cmd)
+            list_add_tail(list, &cmd->clist);
+    }
+}
+
+static void walk_service(struct cache_walk *w, const struct cache_service *cs)
+{
+    const uint32_t *refs, *keycodes;
+    const struct cache_socket *cso;
+    const struct cache_env *ce;
+    struct service *svc;
+    struct socketinfo **sip = NULL;
+    struct svcenvinfo **eip = NULL;
+    uint32_t i;
+
+    if (!cs->nargs || cs->nargs > INIT_PARSER_MAXARGS ||
+        cs->nr_supp_gids > NR_SVC_SUPP_GIDS) {
+        w->error = 1;
+        return;
+    }
+
+    svc = carve(w, sizeof(*svc) + sizeof(char *) * cs->nargs);
+    refs = cache_array(w, cs->args, cs->nargs, sizeof(uint32_t));
+    if (svc) {
+        svc->name = cache_str(w, cs->name);
+        svc->classname = cache_str(w, cs->classname);
+        svc->seclabel = cache_str(w, cs->seclabel);
+        svc->flags = cs->flags;
+        svc->uid = cs->uid;
+        svc->gid = cs->gid;
+        svc->nr_supp_gids = cs->nr_supp_gids;
+        for (i = 0; i < NR_SVC_SUPP_GIDS; i++)
+            svc->supp_gids[i] = cs->supp_gids[i];
+        svc->ioprio_class = cs->ioprio_class;
+        svc->ioprio_pri = cs->ioprio_pri;
+        svc->nargs = cs->nargs;
+        for (i = 0; i < cs->nargs; i++)
+            svc->args[i] = cache_str(w, refs[i]);
+        svc->args[cs->nargs] = 0;
+        svc->onrestart.name = "onrestart";
+        list_init(&svc->onrestart.commands);
+        sip = &svc->sockets;
+        eip = &svc->envvars;
+    } else if (refs) {
+        if (!cache_str(w, cs->name) || !cache_str(w, cs->classname))
+            w->error = 1;
+        cache_str(w, cs->seclabel);
+        for (i = 0; i < cs->nargs; i++)
+            cache_str(w, refs[i]);
+    }
+
+    cso = cache_array(w, cs->sockets, cs->nsockets, sizeof(*cso));
+    for (i = 0; cso && i < cs->nsockets; i++) {
+        struct socketinfo *si = carve(w, sizeof(*si));
+        char *name = cache_str(w, cso[i].name);
+        char *type = cache_str(w, cso[i].type);
+
+        if (si) {
+            si->name = name;
+            si->type = type;
+            si->perm = cso[i].perm;
+            si->uid = cso[i].uid;
+            si->gid = cso[i].gid;
+            *sip = si;
+            sip = &si->next;
+        }
+    }
+
+    ce = cache_array(w, cs->envvars, cs->nenvvars, sizeof(*ce));
+    for (i = 0; ce && i < cs->nenvvars; i++) {
+        struct svcenvinfo *ei = carve(w, sizeof(*ei));
+        char *name = cache_str(w, ce[i].name);
+        char *value = cache_str(w, ce[i].value);
+
+        if (ei) {
+            ei->name = name;
+            ei->value = value;
+            *eip = ei;
+            eip = &ei->next;
+        }
+    }
+
+    keycodes = cache_array(w, cs->keycodes, cs->nkeycodes, sizeof(uint32_t));
+    if (keycodes) {
+        int *k = carve(w, sizeof(int) * cs->nkeycodes);
+        if (k) {
+            for (i = 0; i < cs->nkeycodes; i++)
+                k[i] = keycodes[i];
+            svc->keycodes = k;
+            svc->nkeycodes = cs->nkeycodes;
+        }
+    }
+
+    walk_commands(w, svc ? &svc->onrestart.commands : NULL,
+                  cs->onrestart, cs->ncommands);
+    if (svc)
+        service_list_add(svc);
+}
+
+static void walk_action(struct cache_walk *w, const struct cache_action *ca)
+{
+    struct action *act = carve(w, sizeof(*act));
+    char *name = cache_str(w, ca->name);
+
+    if (!act && !name)
+        w->error = 1;
+    if (act) {
+        act->name = name;
+        list_init(&act->commands);
+        list_init(&act->qlist);
+    }
+    walk_commands(w, act ? &act->commands : NULL, ca->commands, ca->ncommands);
+    if (act)
+        action_list_add(act);
+}
+
+static void walk_image(struct cache_walk *w)
+{
+    const struct cache_header *hdr = w->img->hdr;
+    const struct cache_service *cs;
+    const struct cache_action *ca;
+    uint32_t i;
+
+    cs = cache_array(w, hdr->services, hdr->nservices, sizeof(*cs));
+    for (i = 0; cs && i < hdr->nservices && !w->error; i++)
+        walk_service(w, &cs[i]);
+
+    ca = cache_array(w, hdr->actions, hdr->nactions, sizeof(*ca));
+    for (i = 0; ca && i < hdr->nactions && !w->error; i++)
+        walk_action(w, &ca[i]);
+}
+
+static int cache_inputs_match(struct cache_walk *w, const char *rc)
+{
+    const struct cache_header *hdr = w->img->hdr;
+    const struct cache_import *ci;
+    const uint32_t *refs;
+    uint64_t hash = 14695981039346656037ULL;
+    char conf_file[PATH_MAX];
+    uint32_t i, j;
+
+    refs = cache_array(w, hdr->inputs, hdr->ninputs, sizeof(uint32_t));
+    if (!refs || !cache_str(w, refs[0]) || strcmp(cache_str(w, refs[0]), rc))
+        return 0;
+
+    for (i = 0; i < hdr->ninputs; i++) {
+        const char *fn = cache_str(w, refs[i]);
+        unsigned len;
+        char *data;
+
+        if (!fn)
+            return 0;
+        data = read_file(fn, &len);
+        if (!data)
+            return 0;
+        hash = hash_input(hash, fn, data, len);
+        free(data);
+    }
+    if ((uint32_t) hash != hdr->hash_lo || (uint32_t) (hash >> 32) != hdr->hash_hi)
+        return 0;
+
+    /* imports may depend on properties, and may name missing files */
+    ci = cache_array(w, hdr->imports, hdr->nimports, sizeof(*ci));
+    for (i = 0; ci && i < hdr->nimports; i++) {
+        const char *raw = cache_str(w, ci[i].raw);
+        const char *path = cache_str(w, ci[i].path);
+
+        if (!raw || !path || expand_props(conf_file, raw, sizeof(conf_file)) ||
+            strcmp(conf_file, path))
+            return 0;
+        for (j = 0; j < hdr->ninputs; j++) {
+            if (!strcmp(cache_str(w, refs[j]), path))
+                break;
+        }
+        if (j == hdr->ninputs && !access(path, F_OK))
+            return 0;
+    }
+    return !w->error;
+}
+
+static int cache_map(struct cache_image *img, const char *fn)
+{
+    const struct cache_header *hdr;
+    struct stat st;
+    int fd;
+
+    fd = open(fn, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) || st.st_size < (off_t) sizeof(*hdr)) {
+        close(fd);
+        return -1;
+    }
+    /* private and writable: commands are free to scribble on their args */
+    img->size = st.st_size;
+    img->base = mmap(NULL, img->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (img->base == MAP_FAILED)
+        return -1;
+
+    hdr = img->hdr = (const struct cache_header *) img->base;
+    if (hdr->magic != CACHE_MAGIC || hdr->version != CACHE_VERSION ||
+        hdr->keywords != keyword_table_hash() || hdr->size != img->size ||
+        hdr->strings < sizeof(*hdr) || hdr->strings > hdr->size ||
+        hdr->strings_size != hdr->size - hdr->strings ||
+        !hdr->strings_size || img->base[hdr->size - 1] != '\0') {
+        munmap(img->base, img->size);
+        return -1;
+    }
+    return 0;
+}
+
+static int cache_open(struct cache_image *img, struct cache_walk *w,
+                      const char *fn, const char *rc)
+{
+    if (cache_map(img, fn))
+        return -1;
+
+    memset(w, 0, sizeof(*w));
+    w->img = img;
+    if (!cache_inputs_match(w, rc)) {
+        INFO("init.rc cache '%s' is stale\n", fn);
+        munmap(img->base, img->size);
+        return -1;
+    }
+
+    walk_image(w);
+    if (w->error) {
+        ERROR("init.rc cache '%s' is corrupt\n", fn);
+        munmap(img->base, img->size);
+        return -1;
+    }
+    return 0;
+}
+
+int init_cache_load(const char *fn, const char *rc)
+{
+    struct cache_image img;
+    struct cache_walk w;
+    size_t size;
+
+    if (cache_open(&img, &w, fn, rc))
+        return -1;
+
+    size = w.used;
+    w.block = arena_alloc(&arena_nodes, size);
+    if (!w.block) {
+        munmap(img.base, img.size);
+        return -1;
+    }
+    w.used = 0;
+    walk_image(&w);
+
+    INFO("loaded %u services and %u actions from '%s'\n",
+         img.hdr->nservices, img.hdr->nactions, fn);
+    return 0;
+}
+
+int init_cache_compile(const char *fn, const char *rc)
+{
+    if (init_parse_config_file(rc)) {
+        fprintf(stderr, "could not read '%s'\n", rc);
+        return 1;
+    }
+    if (init_cache_save(fn)) {
+        fprintf(stderr, "could not write '%s'\n", fn);
+        return 1;
+    }
+    printf("%s: %u input files, %u imports\n", fn, ninputs, nimports);
+    return init_cache_verify(fn, rc);
+}
+
+int init_cache_verify(const char *fn, const char *rc)
+{
+    struct cache_image img;
+    struct cache_walk w;
+
+    if (cache_open(&img, &w, fn, rc)) {
+        fprintf(stderr, "%s: missing, stale or corrupt for '%s'\n", fn, rc);
+        return 1;
+    }
+    printf("%s: %u services, %u actions, %u bytes mapped, %u bytes allocated\n",
+           fn, img.hdr->nservices, img.hdr->nactions,
+           (unsigned) img.size, (unsigned) w.used);
+    munmap(img.base, img.size);
+    return 0;
+}
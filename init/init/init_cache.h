@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _INIT_INIT_CACHE_H_
+#define _INIT_INIT_CACHE_H_
+
+#define INIT_RC_CACHE "/init.rc.cache"
+
+/* called by the parser for every rc file read and every import seen */
+void init_cache_add_input(const char *fn, const char *data, unsigned len);
+void init_cache_add_import(const char *raw, const char *path);
+
+/*
+ * Populate the service and action lists from a compiled cache of the
+ * rc files rooted at 'rc'. Fails without touching the lists if the
+ * cache is missing, malformed or any of its inputs changed.
+ */
+int init_cache_load(const char *fn, const char *rc);
+int init_cache_save(const char *fn);
+
+/* entry points for "init --compile-rc" and "init --verify-rc" */
+int init_cache_compile(const char *fn, const char *rc);
+int init_cache_verify(const char *fn, const char *rc);
+
+#endif
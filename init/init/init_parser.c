@@ -22,8 +22,11 @@
 #include <string.h>
 #include <stddef.h>
 #include <ctype.h>
+#include <limits.h>
 
+#include "arena.h"
 #include "init.h"
+#include "init_cache.h"
 #include "parser.h"
 #include "init_parser.h"
 #include "log.h"
@@ -39,6 +42,22 @@
 static list_declare(service_list);
 static list_declare(action_list);
 static list_declare(action_queue);
+static unsigned action_queue_len = 0;
+
+/*
+ * Property triggers ("on property:<name>=<value>") are indexed at parse
+ * time so that property_changed() only has to look at the actions that
+ * can actually match. Triggers with an explicit value are hashed on
+ * "<name>=<value>", wildcard ("*") triggers on "<name>" alone. Within a
+ * bucket, actions are kept in parse order and carry a sequence number so
+ * that the two buckets can be merged back into action_list order.
+ */
+#define PROP_TRIGGER_HASH_SIZE 256  /* must be a power of two */
+
+static struct listnode prop_trigger_exact[PROP_TRIGGER_HASH_SIZE];
+static struct listnode prop_trigger_wild[PROP_TRIGGER_HASH_SIZE];
+static int prop_trigger_index_inited = 0;
+static unsigned action_seq = 0;
 
 struct import {
     struct listnode list;
@@ -50,6 +69,7 @@ static void parse_line_service(struct parse_state *state, int nargs, char **args
 
 static void *parse_action(struct parse_state *state, int nargs, char **args);
 static void parse_line_action(struct parse_state *state, int nargs, char **args);
+static void prop_trigger_index_add(struct action *act);
 
 #define SECTION 0x01
 #define COMMAND 0x02
@@ -135,6 +155,7 @@ int lookup_keyword(const char *s)
     case 'r':
         if (!strcmp(s, "estart")) return K_restart;
         if (!strcmp(s, "estorecon")) return K_restorecon;
+        if (!strcmp(s, "estorecon_recursive")) return K_restorecon_recursive;
         if (!strcmp(s, "mdir")) return K_rmdir;
         if (!strcmp(s, "m")) return K_rm;
         break;
@@ -310,9 +331,10 @@ void parse_import(struct parse_state *state, int nargs, char **args)
               state->line, state->filename);
         return;
     }
+    init_cache_add_import(args[1], conf_file);
 
-    import = calloc(1, sizeof(struct import));
-    import->filename = strdup(conf_file);
+    import = arena_alloc(&arena_data, sizeof(struct import));
+    import->filename = arena_intern(conf_file);
     list_add_tail(import_list, &import->list);
     INFO("found import '%s', adding to import list", import->filename);
 }
@@ -419,15 +441,66 @@ int init_parse_config_file(const char *fn)
 {
     // ȡļ 
     char *data;
-    data = read_file(fn, 0);
+    unsigned sz;
+    data = read_file(fn, &sz);
     if (!data) return -1;
+    init_cache_add_input(fn, data, sz);
 
     // ļ 
     parse_config(fn, data);
     DUMP();
+
+    /* everything kept from the text was copied into the arena */
+    free(data);
     return 0;
 }
 
+void service_list_add(struct service *svc)
+{
+    list_add_tail(&service_list, &svc->slist);
+}
+
+void action_list_add(struct action *act)
+{
+    list_add_tail(&action_list, &act->alist);
+    prop_trigger_index_add(act);
+}
+
+int command_keyword(int (*func)(int nargs, char **args))
+{
+    int kw;
+
+    for (kw = 1; kw < KEYWORD_COUNT; kw++) {
+        if (kw_is(kw, COMMAND) && kw_func(kw) == func)
+            return kw;
+    }
+    return K_UNKNOWN;
+}
+
+int (*command_func(int kw, int nargs))(int nargs, char **args)
+{
+    if (kw <= K_UNKNOWN || kw >= KEYWORD_COUNT || !kw_is(kw, COMMAND) ||
+        nargs < kw_nargs(kw))
+        return 0;
+    return kw_func(kw);
+}
+
+/* changes whenever a keyword is added, removed or renumbered */
+unsigned keyword_table_hash(void)
+{
+    unsigned hash = KEYWORD_COUNT;
+    const char *p;
+    int kw;
+
+    for (kw = 0; kw < KEYWORD_COUNT; kw++) {
+        for (p = kw_name(kw); *p; p++)
+            hash = hash * 31 + (unsigned char) *p;
+        hash = hash * 31 + kw_nargs(kw);
+        hash = hash * 31 + keyword_info[kw].flags;
+    }
+    return hash;
+}
+
 static int valid_name(const char *name)
 {
     if (strlen(name) > 16) {
@@ -517,6 +590,16 @@ void service_for_each_flags(unsigned matchflags,
     }
 }
 
+void action_for_each(void (*func)(struct action *act))
+{
+    struct listnode *node;
+    struct action *act;
+    list_for_each(node, &action_list) {
+        act = node_to_item(node, struct action, alist);
+        func(act);
+    }
+}
+
 void action_for_each_trigger(const char *trigger,
                              void (*func)(struct action *act))
 {
@@ -530,22 +613,107 @@ void action_for_each_trigger(const char *trigger,
     }
 }
 
+static unsigned prop_trigger_hash(unsigned hash, const char *s, size_t len)
+{
+    while (len--)
+        hash = hash * 31 + (unsigned char) *s++;
+    return hash;
+}
+
+static void prop_trigger_index_init(void)
+{
+    int i;
+
+    for (i = 0; i < PROP_TRIGGER_HASH_SIZE; i++) {
+        list_init(&prop_trigger_exact[i]);
+        list_init(&prop_trigger_wild[i]);
+    }
+    prop_trigger_index_inited = 1;
+}
+
+static void prop_trigger_index_add(struct action *act)
+{
+    const char *test;
+    const char *equals;
+    struct listnode *bucket;
+
+    if (!prop_trigger_index_inited)
+        prop_trigger_index_init();
+
+    act->seq = action_seq++;
+    list_init(&act->tlist);
+
+    if (strncmp(act->name, "property:", strlen("property:")))
+        return;
+    test = act->name + strlen("property:");
+    equals = strchr(test, '=');
+    if (!equals)
+        return;
+
+    if (!strcmp(equals + 1, "*")) {
+        act->hash = prop_trigger_hash(0, test, equals - test);
+        bucket = &prop_trigger_wild[act->hash & (PROP_TRIGGER_HASH_SIZE - 1)];
+    } else {
+        act->hash = prop_trigger_hash(0, test, strlen(test));
+        bucket = &prop_trigger_exact[act->hash & (PROP_TRIGGER_HASH_SIZE - 1)];
+    }
+    list_add_tail(bucket, &act->tlist);
+}
+
+static int prop_trigger_matches(struct action *act, const char *name,
+                                int name_length, const char *value)
+{
+    const char *test = act->name + strlen("property:");
+
+    return !strncmp(name, test, name_length) &&
+            test[name_length] == '=' &&
+            (!strcmp(test + name_length + 1, value) ||
+             !strcmp(test + name_length + 1, "*"));
+}
+
 void queue_property_triggers(const char *name, const char *value)
 {
-    struct listnode *node;
+    struct listnode *exact, *wild;
+    struct listnode *enode, *wnode;
     struct action *act;
-    list_for_each(node, &action_list) {
-        act = node_to_item(node, struct action, alist);
-        if (!strncmp(act->name, "property:", strlen("property:"))) {
-            const char *test = act->name + strlen("property:");
-            int name_length = strlen(name);
-
-            if (!strncmp(name, test, name_length) &&
-                    test[name_length] == '=' &&
-                    (!strcmp(test + name_length + 1, value) ||
-                     !strcmp(test + name_length + 1, "*"))) {
-                action_add_queue_tail(act);
-            }
+    unsigned exact_hash, wild_hash;
+    int name_length = strlen(name);
+
+    if (!prop_trigger_index_inited)
+        return;
+
+    wild_hash = prop_trigger_hash(0, name, name_length);
+    exact_hash = prop_trigger_hash(wild_hash, "=", 1);
+    exact_hash = prop_trigger_hash(exact_hash, value, strlen(value));
+
+    exact = &prop_trigger_exact[exact_hash & (PROP_TRIGGER_HASH_SIZE - 1)];
+    wild = &prop_trigger_wild[wild_hash & (PROP_TRIGGER_HASH_SIZE - 1)];
+
+    /* merge both buckets so actions are queued in action_list order */
+    enode = exact->next;
+    wnode = wild->next;
+    while (enode != exact || wnode != wild) {
+        struct action *eact = NULL, *wact = NULL;
+        unsigned hash;
+
+        if (enode != exact)
+            eact = node_to_item(enode, struct action, tlist);
+        if (wnode != wild)
+            wact = node_to_item(wnode, struct action, tlist);
+
+        if (eact && (!wact || eact->seq < wact->seq)) {
+            act = eact;
+            hash = exact_hash;
+            enode = enode->next;
+        } else {
+            act = wact;
+            hash = wild_hash;
+            wnode = wnode->next;
+        }
+
+        if (act->hash == hash &&
+                prop_trigger_matches(act, name, name_length, value)) {
+            action_add_queue_tail(act);
         }
     }
 }
@@ -587,12 +755,12 @@ void queue_builtin_action(int (*func)(int nargs, char **args), char *name)
     struct action *act;
     struct command *cmd;
 
-    act = calloc(1, sizeof(*act));
+    act = arena_alloc(&arena_nodes, sizeof(*act));
     act->name = name;
     list_init(&act->commands);
     list_init(&act->qlist);
 
-    cmd = calloc(1, sizeof(*cmd));
+    cmd = arena_alloc(&arena_data, sizeof(*cmd));
     cmd->func = func;
     cmd->args[0] = name;
     list_add_tail(&act->commands, &cmd->clist);
@@ -605,6 +773,7 @@ void action_add_queue_tail(struct action *act)
 {
     if (list_empty(&act->qlist)) {
         list_add_tail(&action_queue, &act->qlist);
+        action_queue_len++;
     }
 }
 
@@ -617,6 +786,7 @@ struct action *action_remove_queue_head(void)
         struct action *act = node_to_item(node, struct action, qlist);
         list_remove(node);
         list_init(node);
+        action_queue_len--;
         return act;
     }
 }
@@ -626,6 +796,20 @@ int action_queue_empty()
     return list_empty(&action_queue);
 }
 
+unsigned action_queue_depth(void)
+{
+    return action_queue_len;
+}
+
+/* copies args out of the rc text, which is freed once it has been parsed */
+static void intern_args(char **dst, char **args, int nargs)
+{
+    int i;
+
+    for (i = 0; i < nargs; i++)
+        dst[i] = (char *) arena_intern(args[i]);
+}
+
 static void *parse_service(struct parse_state *state, int nargs, char **args)
 {
     struct service *svc;
@@ -645,14 +829,14 @@ static void *parse_service(struct parse_state *state, int nargs, char **args)
     }
 
     nargs -= 2;
-    svc = calloc(1, sizeof(*svc) + sizeof(char*) * nargs);
+    svc = arena_alloc(&arena_nodes, sizeof(*svc) + sizeof(char*) * nargs);
     if (!svc) {
         parse_error(state, "out of memory\n");
         return 0;
     }
-    svc->name = args[1];
+    svc->name = arena_intern(args[1]);
     svc->classname = "default";
-    memcpy(svc->args, args + 2, sizeof(char*) * nargs);
+    intern_args(svc->args, args + 2, nargs);
     svc->args[nargs] = 0;
     svc->nargs = nargs;
     svc->onrestart.name = "onrestart";
@@ -681,7 +865,7 @@ static void parse_line_service(struct parse_state *state, int nargs, char **args
         if (nargs != 2) {
             parse_error(state, "class option requires a classname\n");
         } else {
-            svc->classname = args[1];
+            svc->classname = arena_intern(args[1]);
         }
         break;
     case K_console:
@@ -732,7 +916,7 @@ static void parse_line_service(struct parse_state *state, int nargs, char **args
         if (nargs < 2) {
             parse_error(state, "keycodes option requires atleast one keycode\n");
         } else {
-            svc->keycodes = malloc((nargs - 1) * sizeof(svc->keycodes[0]));
+            svc->keycodes = arena_alloc(&arena_data, (nargs - 1) * sizeof(svc->keycodes[0]));
             if (!svc->keycodes) {
                 parse_error(state, "could not allocate keycodes\n");
             } else {
@@ -761,10 +945,10 @@ static void parse_line_service(struct parse_state *state, int nargs, char **args
             break;
         }
 
-        cmd = malloc(sizeof(*cmd) + sizeof(char*) * nargs);
+        cmd = arena_alloc(&arena_data, sizeof(*cmd) + sizeof(char*) * nargs);
         cmd->func = kw_func(kw);
         cmd->nargs = nargs;
-        memcpy(cmd->args, args, sizeof(char*) * nargs);
+        intern_args(cmd->args, args, nargs);
         list_add_tail(&svc->onrestart.commands, &cmd->clist);
         break;
     case K_critical:
@@ -776,13 +960,13 @@ static void parse_line_service(struct parse_state *state, int nargs, char **args
             parse_error(state, "setenv option requires name and value arguments\n");
             break;
         }
-        ei = calloc(1, sizeof(*ei));
+        ei = arena_alloc(&arena_data, sizeof(*ei));
         if (!ei) {
             parse_error(state, "out of memory\n");
             break;
         }
-        ei->name = args[1];
-        ei->value = args[2];
+        ei->name = arena_intern(args[1]);
+        ei->value = arena_intern(args[2]);
         ei->next = svc->envvars;
         svc->envvars = ei;
         break;
@@ -798,13 +982,13 @@ static void parse_line_service(struct parse_state *state, int nargs, char **args
             parse_error(state, "socket type must be 'dgram', 'stream' or 'seqpacket'\n");
             break;
         }
-        si = calloc(1, sizeof(*si));
+        si = arena_alloc(&arena_data, sizeof(*si));
         if (!si) {
             parse_error(state, "out of memory\n");
             break;
         }
-        si->name = args[1];
-        si->type = args[2];
+        si->name = arena_intern(args[1]);
+        si->type = arena_intern(args[2]);
         si->perm = strtoul(args[3], 0, 8);
         if (nargs > 4)
             si->uid = decode_uid(args[4]);
@@ -825,7 +1009,7 @@ static void parse_line_service(struct parse_state *state, int nargs, char **args
         if (nargs != 2) {
             parse_error(state, "seclabel option requires a label string\n");
         } else {
-            svc->seclabel = args[1];
+            svc->seclabel = (char *) arena_intern(args[1]);
         }
         break;
 
@@ -845,12 +1029,12 @@ static void *parse_action(struct parse_state *state, int nargs, char **args)
         parse_error(state, "actions may not have extra parameters\n");
         return 0;
     }
-    act = calloc(1, sizeof(*act));
-    act->name = args[1];
+    act = arena_alloc(&arena_nodes, sizeof(*act));
+    act->name = arena_intern(args[1]);
     list_init(&act->commands);
     list_init(&act->qlist);
     list_add_tail(&action_list, &act->alist);
-        /* XXX add to hash */
+    prop_trigger_index_add(act);
     return act;
 }
 
@@ -877,9 +1061,9 @@ static void parse_line_action(struct parse_state* state, int nargs, char **args)
             n > 2 ? "arguments" : "argument");
         return;
     }
-    cmd = malloc(sizeof(*cmd) + sizeof(char*) * nargs);
+    cmd = arena_alloc(&arena_data, sizeof(*cmd) + sizeof(char*) * nargs);
     cmd->func = kw_func(kw);
     cmd->nargs = nargs;
-    memcpy(cmd->args, args, sizeof(char*) * nargs);
+    intern_args(cmd->args, args, nargs);
     list_add_tail(&act->commands, &cmd->clist);
 }
@@ -20,17 +20,27 @@
 #define INIT_PARSER_MAXARGS 64
 
 struct action;
+struct service;
 
 struct action *action_remove_queue_head(void);
 void action_add_queue_tail(struct action *act);
+void action_for_each(void (*func)(struct action *act));
 void action_for_each_trigger(const char *trigger,
                              void (*func)(struct action *act));
 int action_queue_empty(void);
+unsigned action_queue_depth(void);
 void queue_property_triggers(const char *name, const char *value);
 void queue_all_property_triggers();
 void queue_builtin_action(int (*func)(int nargs, char **args), char *name);
 
 int init_parse_config_file(const char *fn);
+
+/* used to rebuild the lists from a compiled cache */
+void service_list_add(struct service *svc);
+void action_list_add(struct action *act);
+int command_keyword(int (*func)(int nargs, char **args));
+int (*command_func(int kw, int nargs))(int nargs, char **args);
+unsigned keyword_table_hash(void);
 int expand_props(char *dst, const char *src, int len);
 
 #endif
@@ -38,6 +38,8 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
 #include <sys/atomics.h>
 #include <private/android_filesystem_config.h>
 
@@ -49,13 +51,43 @@
 #include "util.h"
 #include "log.h"
 
+#ifndef PERSISTENT_PROPERTY_DIR
 #define PERSISTENT_PROPERTY_DIR  "/data/property"
+#endif
+
+/*
+ * With PERSISTENT_PROPERTY_WRITEBACK, persist.* changes are not written
+ * one file per property. They only mark the set dirty, and all persist.*
+ * properties are written together into PERSISTENT_PROPERTY_FILE,
+ * PERSISTENT_PROPERTY_FLUSH_MS after the first unflushed change, on
+ * shutdown, or when PERSISTENT_PROPERTY_SYNC is set to "1".  A flush
+ * that fails is retried with backoff until it succeeds.
+ *
+ * The file is a sequence of records: a one byte name length, a one byte
+ * value length, then the name and value without terminators.  It is
+ * always read at boot, whichever mode init was built with.  Boards turn
+ * write-back on with INIT_PERSISTENT_PROPERTY_WRITEBACK := true.
+ */
+#ifndef PERSISTENT_PROPERTY_WRITEBACK
+#define PERSISTENT_PROPERTY_WRITEBACK 0
+#endif
+
+#define PERSISTENT_PROPERTY_FILE      PERSISTENT_PROPERTY_DIR "/persistent_properties"
+#define PERSISTENT_PROPERTY_FLUSH_MS  2000
+/* a failed flush is retried, doubling the delay up to this */
+#define PERSISTENT_PROPERTY_RETRY_MAX_MS  60000
+#define PERSISTENT_PROPERTY_SYNC      "sys.persist_props.sync"
 
 static int persistent_properties_loaded = 0;
 static int property_area_inited = 0;
 
 static int property_set_fd = -1;
 
+static int persist_flush_fd = -1;
+static int persist_dirty = 0;
+static int persist_retry_ms = 0;
+static int persist_legacy_files = 0;
+
 /* White list of permissions for setting property services. */
 struct {
     const char *prefix;
@@ -278,6 +310,173 @@ static void write_persistent_property(const char *name, const char *value)
     }
 }
 
+struct persist_buf {
+    char *data;
+    size_t len;
+    size_t size;
+    int error;
+};
+
+static void append_persistent_property(const prop_info *pi, void *cookie)
+{
+    struct persist_buf *buf = cookie;
+    char name[PROP_NAME_MAX];
+    char value[PROP_VALUE_MAX];
+    size_t namelen, valuelen;
+
+    if (buf->error)
+        return;
+    __system_property_read(pi, name, value);
+    if (strncmp("persist.", name, strlen("persist.")))
+        return;
+
+    namelen = strlen(name);
+    valuelen = strlen(value);
+    if (buf->len + 2 + namelen + valuelen > buf->size) {
+        size_t size = buf->size ? buf->size * 2 : 4096;
+        char *data = realloc(buf->data, size);
+        if (!data) {
+            buf->error = 1;
+            return;
+        }
+        buf->data = data;
+        buf->size = size;
+    }
+
+    buf->data[buf->len++] = namelen;
+    buf->data[buf->len++] = valuelen;
+    memcpy(buf->data + buf->len, name, namelen);
+    buf->len += namelen;
+    memcpy(buf->data + buf->len, value, valuelen);
+    buf->len += valuelen;
+}
+
+static void arm_persist_flush_timer(int ms)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = ms / 1000;
+    its.it_value.tv_nsec = (ms % 1000) * 1000000;
+    timerfd_settime(persist_flush_fd, 0, &its, NULL);
+}
+
+static void remove_legacy_persistent_files(void)
+{
+    DIR *dir = opendir(PERSISTENT_PROPERTY_DIR);
+    struct dirent *entry;
+
+    if (!dir)
+        return;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!strncmp("persist.", entry->d_name, strlen("persist.")))
+            unlinkat(dirfd(dir), entry->d_name, 0);
+    }
+    closedir(dir);
+}
+
+/*
+ * Writes every persist.* property into PERSISTENT_PROPERTY_FILE with a
+ * single write, replacing the previous file atomically.
+ */
+static int flush_persistent_properties(void)
+{
+    struct persist_buf buf = { NULL, 0, 0, 0 };
+    char tempPath[PATH_MAX];
+    int fd, ret = -1;
+
+    if (!persist_dirty)
+        return 0;
+
+    __system_property_foreach(append_persistent_property, &buf);
+    if (buf.error) {
+        /* a partial file would lose properties, keep the old one */
+        ERROR("Unable to buffer persistent properties\n");
+        goto out;
+    }
+
+    snprintf(tempPath, sizeof(tempPath), "%s/.temp.XXXXXX", PERSISTENT_PROPERTY_DIR);
+    fd = mkstemp(tempPath);
+    if (fd < 0) {
+        ERROR("Unable to write persistent properties to temp file %s errno: %d\n", tempPath, errno);
+        goto out;
+    }
+    if (TEMP_FAILURE_RETRY(write(fd, buf.data, buf.len)) != (ssize_t) buf.len ||
+            fsync(fd) < 0) {
+        ERROR("Unable to write persistent properties errno: %d\n", errno);
+        close(fd);
+        unlink(tempPath);
+        goto out;
+    }
+    close(fd);
+
+    if (rename(tempPath, PERSISTENT_PROPERTY_FILE)) {
+        unlink(tempPath);
+        ERROR("Unable to rename persistent property file %s to %s\n",
+              tempPath, PERSISTENT_PROPERTY_FILE);
+        goto out;
+    }
+
+    /* everything the per-property files held is now in the single file */
+    if (persist_legacy_files) {
+        remove_legacy_persistent_files();
+        persist_legacy_files = 0;
+    }
+
+    persist_dirty = 0;
+    ret = 0;
+out:
+    if (persist_flush_fd >= 0) {
+        if (ret) {
+            /* still dirty: try again later rather than at shutdown */
+            if (persist_retry_ms < PERSISTENT_PROPERTY_FLUSH_MS)
+                persist_retry_ms = PERSISTENT_PROPERTY_FLUSH_MS;
+            else if (persist_retry_ms < PERSISTENT_PROPERTY_RETRY_MAX_MS / 2)
+                persist_retry_ms *= 2;
+            else
+                persist_retry_ms = PERSISTENT_PROPERTY_RETRY_MAX_MS;
+            arm_persist_flush_timer(persist_retry_ms);
+        } else {
+            persist_retry_ms = 0;
+            arm_persist_flush_timer(0);
+        }
+    }
+    free(buf.data);
+    return ret;
+}
+
+static void queue_persistent_property_flush(const char *name, const char *value)
+{
+    if (persist_flush_fd < 0) {
+        /* no timer to defer with, keep the one-file-per-property scheme */
+        write_persistent_property(name, value);
+        return;
+    }
+
+    if (persist_dirty)
+        return;
+    persist_dirty = 1;
+    arm_persist_flush_timer(PERSISTENT_PROPERTY_FLUSH_MS);
+}
+
+/*
+ * Writes out any pending persist.* changes now.  Called on shutdown and
+ * whenever a client asks for a sync point.
+ */
+void property_sync_persistent(void)
+{
+    if (persist_dirty)
+        flush_persistent_properties();
+}
+
+void handle_persist_flush_fd(void)
+{
+    uint64_t expirations;
+
+    read(persist_flush_fd, &expirations, sizeof(expirations));
+    flush_persistent_properties();
+}
+
 static bool is_legal_property_name(const char* name, size_t namelen)
 {
     size_t i;
@@ -348,10 +547,16 @@ int property_set(const char *name, const char *value)
          * Don't write properties to disk until after we have read all default properties
          * to prevent them from being overwritten by default values.
          */
-        write_persistent_property(name, value);
+        if (PERSISTENT_PROPERTY_WRITEBACK)
+            queue_persistent_property_flush(name, value);
+        else
+            write_persistent_property(name, value);
     } else if (strcmp("selinux.reload_policy", name) == 0 &&
                strcmp("1", value) == 0) {
         selinux_reload_policy();
+    } else if (strcmp(PERSISTENT_PROPERTY_SYNC, name) == 0 &&
+               strcmp("1", value) == 0) {
+        property_sync_persistent();
     }
     // Ը֪ͨӦԴ 
     // (init.rcж壬磺
@@ -362,87 +567,296 @@ int property_set(const char *name, const char *value)
     return 0;
 }
 
-void handle_property_set_fd()
-{
-    prop_msg msg;
-    int s;
-    int r;
-    int res;
+/*
+ * Property set connections.
+ *
+ * Sockets accepted from property_set_fd are non-blocking and watched by
+ * their own epoll set, which init polls through get_property_conn_fd(),
+ * so a client that connects and then stalls only holds a slot; it can
+ * no longer keep init waiting in recv(). The peer's credentials and
+ * security context are fetched once, when the connection is accepted.
+ *
+ * A connection carries either one legacy PROP_MSG_SETPROP prop_msg, after
+ * which it is closed as bionic expects, or any number of
+ * PROP_MSG_SETPROP_BATCH messages, each answered with one prop_batch_ack
+ * once every property in it has been set.
+ */
+#define PROP_CONN_MAX       16
+#define PROP_BATCH_MAX      256
+#define PROP_BATCH_RECORD   2   /* name length, value length */
+#define PROP_BATCH_BUF      (sizeof(struct prop_batch_hdr) + \
+                             PROP_BATCH_MAX * (PROP_BATCH_RECORD + \
+                                               PROP_NAME_MAX + PROP_VALUE_MAX))
+
+struct prop_conn {
+    int fd;
+    unsigned seq;               /* accept order, the lowest is evicted first */
     struct ucred cr;
-    struct sockaddr_un addr;
-    socklen_t addr_size = sizeof(addr);
-    socklen_t cr_size = sizeof(cr);
-    char * source_ctx = NULL;
+    char *sctx;
+    char *buf;
+    size_t len;
+};
 
-    if ((s = accept(property_set_fd, (struct sockaddr *) &addr, &addr_size)) < 0) {
+static struct prop_conn prop_conns[PROP_CONN_MAX];
+static unsigned prop_conn_seq;
+static int property_conn_fd = -1;
+
+/* Drops the socket but keeps the peer's credentials around. */
+static void prop_conn_hangup(struct prop_conn *conn)
+{
+    if (conn->fd < 0)
         return;
+    epoll_ctl(property_conn_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+}
+
+static void prop_conn_close(struct prop_conn *conn)
+{
+    prop_conn_hangup(conn);
+    freecon(conn->sctx);
+    free(conn->buf);
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = -1;
+}
+
+/*
+ * Sets one property for the peer of 'conn', after checking it may.
+ * Returns 1 if the change was made, 0 if it was refused.
+ */
+static int prop_conn_set(struct prop_conn *conn, const char *name, const char *value)
+{
+    if (!is_legal_property_name(name, strlen(name))) {
+        ERROR("sys_prop: illegal property name. Got: \"%s\"\n", name);
+        return 0;
     }
 
-    /* Check socket options here */
-    // ucred cr ṹУ洢ŴϢĽ̵ uidpidgidֵ 
-    if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cr, &cr_size) < 0) {
-        close(s);
-        ERROR("Unable to receive socket options\n");
-        return;
+    // ctlͷϢϵͳֵϢֹϢ 
+    if (memcmp(name, "ctl.", 4) == 0) {
+        // Ȩ 
+        // system serverrootԼؽ̲ʹctlϢֹ 
+        if (check_control_perms(value, conn->cr.uid, conn->cr.gid, conn->sctx)) {
+            handle_control_message((char*) name + 4, (char*) value);
+            return 1;
+        }
+        ERROR("sys_prop: Unable to %s service ctl [%s] uid:%d gid:%d pid:%d\n",
+              name + 4, value, conn->cr.uid, conn->cr.gid, conn->cr.pid);
+        return 0;
     }
 
-    r = TEMP_FAILURE_RETRY(recv(s, &msg, sizeof(msg), 0));
-    if(r != sizeof(prop_msg)) {
-        ERROR("sys_prop: mis-match msg size received: %d expected: %d errno: %d\n",
-              r, sizeof(prop_msg), errno);
-        close(s);
-        return;
+    // ctlϢϵͳֵ 
+    // ޸ԵķȨ 
+    // ԵķȨ޲Linuxuid 
+    if (check_perms(name, conn->cr.uid, conn->cr.gid, conn->sctx)) {
+        return property_set(name, value) == 0;
+    }
+    ERROR("sys_prop: permission denied uid:%d  name:%s\n", conn->cr.uid, name);
+    return 0;
+}
+
+/*
+ * Returns the size of the complete batch at the start of the buffer, 0
+ * if more data is needed or -1 if the batch is malformed.
+ */
+static int prop_batch_size(const char *buf, size_t len)
+{
+    struct prop_batch_hdr hdr;
+    size_t pos = sizeof(hdr);
+    unsigned i;
+
+    if (len < sizeof(hdr))
+        return 0;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.count > PROP_BATCH_MAX)
+        return -1;
+
+    for (i = 0; i < hdr.count; i++) {
+        unsigned namelen, valuelen;
+
+        if (len < pos + PROP_BATCH_RECORD)
+            return 0;
+        namelen = (unsigned char) buf[pos];
+        valuelen = (unsigned char) buf[pos + 1];
+        if (namelen >= PROP_NAME_MAX || valuelen >= PROP_VALUE_MAX)
+            return -1;
+        pos += PROP_BATCH_RECORD + namelen + valuelen;
     }
+    return len < pos ? 0 : (int) pos;
+}
 
-    switch(msg.cmd) {
-    case PROP_MSG_SETPROP:
-        msg.name[PROP_NAME_MAX-1] = 0;
-        msg.value[PROP_VALUE_MAX-1] = 0;
+static int prop_conn_batch(struct prop_conn *conn, const char *buf)
+{
+    struct prop_batch_hdr hdr;
+    struct prop_batch_ack ack = { 0, 0 };
+    char name[PROP_NAME_MAX];
+    char value[PROP_VALUE_MAX];
+    size_t pos = sizeof(hdr);
+    unsigned i;
+
+    memcpy(&hdr, buf, sizeof(hdr));
+    for (i = 0; i < hdr.count; i++) {
+        size_t namelen = (unsigned char) buf[pos];
+        size_t valuelen = (unsigned char) buf[pos + 1];
+
+        pos += PROP_BATCH_RECORD;
+        memcpy(name, buf + pos, namelen);
+        name[namelen] = 0;
+        pos += namelen;
+        memcpy(value, buf + pos, valuelen);
+        value[valuelen] = 0;
+        pos += valuelen;
+
+        if (prop_conn_set(conn, name, value))
+            ack.set++;
+        else
+            ack.refused++;
+    }
 
-        if (!is_legal_property_name(msg.name, strlen(msg.name))) {
-            ERROR("sys_prop: illegal property name. Got: \"%s\"\n", msg.name);
-            close(s);
+    if (TEMP_FAILURE_RETRY(send(conn->fd, &ack, sizeof(ack),
+                                MSG_DONTWAIT | MSG_NOSIGNAL)) != sizeof(ack))
+        return -1;
+    return 0;
+}
+
+/* Reads whatever the peer has sent and handles every complete message. */
+static void prop_conn_read(struct prop_conn *conn)
+{
+    for (;;) {
+        ssize_t r;
+        int size;
+
+        r = TEMP_FAILURE_RETRY(recv(conn->fd, conn->buf + conn->len,
+                                    PROP_BATCH_BUF - conn->len, 0));
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (r <= 0) {
+            prop_conn_close(conn);
             return;
         }
+        conn->len += r;
+
+        while (conn->len >= sizeof(unsigned)) {
+            unsigned cmd;
+
+            memcpy(&cmd, conn->buf, sizeof(cmd));
+            if (cmd == PROP_MSG_SETPROP) {
+                prop_msg msg;
+
+                if (conn->len < sizeof(msg))
+                    break;
+                memcpy(&msg, conn->buf, sizeof(msg));
+                msg.name[PROP_NAME_MAX-1] = 0;
+                msg.value[PROP_VALUE_MAX-1] = 0;
+
+                // Keep the old close-socket-early behavior when handling
+                // ctl.* properties.
+                if (memcmp(msg.name, "ctl.", 4) == 0)
+                    prop_conn_hangup(conn);
+                prop_conn_set(conn, msg.name, msg.value);
+
+                // Note: bionic's property client code assumes that the
+                // property server will not close the socket until *AFTER*
+                // the property is written to memory.
+                prop_conn_close(conn);
+                return;
+            } else if (cmd == PROP_MSG_SETPROP_BATCH) {
+                size = prop_batch_size(conn->buf, conn->len);
+                if (size == 0)
+                    break;
+                if (size < 0 || prop_conn_batch(conn, conn->buf) < 0) {
+                    prop_conn_close(conn);
+                    return;
+                }
+                conn->len -= size;
+                memmove(conn->buf, conn->buf + size, conn->len);
+            } else {
+                ERROR("sys_prop: unknown message %u from pid %d\n", cmd, conn->cr.pid);
+                prop_conn_close(conn);
+                return;
+            }
+        }
+    }
+}
+
+static struct prop_conn *prop_conn_alloc(void)
+{
+    struct prop_conn *oldest = NULL;
+    int i;
+
+    for (i = 0; i < PROP_CONN_MAX; i++) {
+        if (prop_conns[i].fd < 0)
+            return &prop_conns[i];
+        if (!oldest || (int) (prop_conns[i].seq - oldest->seq) < 0)
+            oldest = &prop_conns[i];
+    }
+
+    ERROR("sys_prop: too many connections, dropping pid %d\n", oldest->cr.pid);
+    prop_conn_close(oldest);
+    return oldest;
+}
+
+void handle_property_set_fd()
+{
+    struct prop_conn *conn;
+    struct epoll_event ev;
+    struct ucred cr;
+    struct sockaddr_un addr;
+    socklen_t addr_size;
+    socklen_t cr_size;
+    int s;
 
-        getpeercon(s, &source_ctx);
+    for (;;) {
+        addr_size = sizeof(addr);
+        if ((s = accept(property_set_fd, (struct sockaddr *) &addr, &addr_size)) < 0) {
+            return;
+        }
+        fcntl(s, F_SETFD, FD_CLOEXEC);
+        fcntl(s, F_SETFL, O_NONBLOCK);
 
-        // ctlͷϢϵͳֵϢֹϢ 
-        if(memcmp(msg.name,"ctl.",4) == 0) {
-            // Keep the old close-socket-early behavior when handling
-            // ctl.* properties.
+        /* Check socket options here */
+        // ucred cr ṹУ洢ŴϢĽ̵ uidpidgidֵ 
+        cr_size = sizeof(cr);
+        if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cr, &cr_size) < 0) {
             close(s);
-            // Ȩ 
-            // system serverrootԼؽ̲ʹctlϢֹ 
-            if (check_control_perms(msg.value, cr.uid, cr.gid, source_ctx)) {
-                handle_control_message((char*) msg.name + 4, (char*) msg.value);
-            } else {
-                ERROR("sys_prop: Unable to %s service ctl [%s] uid:%d gid:%d pid:%d\n",
-                        msg.name + 4, msg.value, cr.uid, cr.gid, cr.pid);
-            }
-        } else {
-            // ctlϢϵͳֵ 
-            // ޸ԵķȨ 
-            // ԵķȨ޲Linuxuid 
-            if (check_perms(msg.name, cr.uid, cr.gid, source_ctx)) {
-                // Ȩ޿޸ģ޸Ĳ 
-                property_set((char*) msg.name, (char*) msg.value);
-            } else {
-                ERROR("sys_prop: permission denied uid:%d  name:%s\n",
-                      cr.uid, msg.name);
-            }
+            ERROR("Unable to receive socket options\n");
+            continue;
+        }
 
-            // Note: bionic's property client code assumes that the
-            // property server will not close the socket until *AFTER*
-            // the property is written to memory.
+        conn = prop_conn_alloc();
+        conn->buf = malloc(PROP_BATCH_BUF);
+        if (!conn->buf) {
             close(s);
+            continue;
+        }
+        conn->fd = s;
+        conn->seq = prop_conn_seq++;
+        conn->cr = cr;
+        getpeercon(s, &conn->sctx);
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(property_conn_fd, EPOLL_CTL_ADD, s, &ev) < 0) {
+            prop_conn_close(conn);
+            continue;
         }
-        freecon(source_ctx);
-        break;
 
-    default:
-        close(s);
-        break;
+        /* the request is usually already waiting */
+        prop_conn_read(conn);
+    }
+}
+
+void handle_property_conn_fd()
+{
+    struct epoll_event events[PROP_CONN_MAX];
+    int nr, i;
+
+    nr = epoll_wait(property_conn_fd, events, PROP_CONN_MAX, 0);
+    for (i = 0; i < nr; i++) {
+        struct prop_conn *conn = events[i].data.ptr;
+
+        /* closed by an earlier event in this round */
+        if (conn->fd >= 0)
+            prop_conn_read(conn);
     }
 }
 
@@ -492,6 +906,79 @@ static void load_properties_from_file(const char *fn)
     }
 }
 
+/*
+ * Loads PERSISTENT_PROPERTY_FILE with a single read().
+ */
+static void load_persistent_property_file(void)
+{
+    char name[PROP_NAME_MAX];
+    char value[PROP_VALUE_MAX];
+    struct stat sb;
+    char *data, *p, *end;
+    ssize_t length;
+    int fd;
+
+    fd = open(PERSISTENT_PROPERTY_FILE, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0)
+        return;
+
+    if (fstat(fd, &sb) < 0) {
+        ERROR("fstat on property file \"%s\" failed errno: %d\n", PERSISTENT_PROPERTY_FILE, errno);
+        close(fd);
+        return;
+    }
+
+    // Same rules as for the per-property files below.
+    if (((sb.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+            || (sb.st_uid != 0)
+            || (sb.st_gid != 0)
+            || (sb.st_nlink != 1)) {
+        ERROR("skipping insecure property file %s (uid=%lu gid=%lu nlink=%d mode=%o)\n",
+              PERSISTENT_PROPERTY_FILE, sb.st_uid, sb.st_gid, sb.st_nlink, sb.st_mode);
+        close(fd);
+        return;
+    }
+
+    data = malloc(sb.st_size);
+    if (!data) {
+        close(fd);
+        return;
+    }
+
+    length = TEMP_FAILURE_RETRY(read(fd, data, sb.st_size));
+    close(fd);
+    if (length != sb.st_size) {
+        ERROR("Unable to read persistent property file %s errno: %d\n",
+              PERSISTENT_PROPERTY_FILE, errno);
+        free(data);
+        return;
+    }
+
+    p = data;
+    end = data + length;
+    while (end - p >= 2) {
+        size_t namelen = (unsigned char) p[0];
+        size_t valuelen = (unsigned char) p[1];
+
+        p += 2;
+        if (namelen >= sizeof(name) || valuelen >= sizeof(value) ||
+                (size_t) (end - p) < namelen + valuelen) {
+            ERROR("persistent property file %s is corrupt\n", PERSISTENT_PROPERTY_FILE);
+            break;
+        }
+        memcpy(name, p, namelen);
+        name[namelen] = 0;
+        p += namelen;
+        memcpy(value, p, valuelen);
+        value[valuelen] = 0;
+        p += valuelen;
+
+        if (!strncmp("persist.", name, strlen("persist.")))
+            property_set(name, value);
+    }
+    free(data);
+}
+
 static void load_persistent_properties()
 {
     DIR* dir = opendir(PERSISTENT_PROPERTY_DIR);
@@ -501,6 +988,13 @@ static void load_persistent_properties()
     int fd, length;
     struct stat sb;
 
+    /*
+     * The single file and the per-property files may both exist while
+     * switching modes; whichever the current mode writes is newer.
+     */
+    if (!PERSISTENT_PROPERTY_WRITEBACK)
+        load_persistent_property_file();
+
     if (dir) {
         dir_fd = dirfd(dir);
         while ((entry = readdir(dir)) != NULL) {
@@ -539,6 +1033,7 @@ static void load_persistent_properties()
             if (length >= 0) {
                 value[length] = 0;
                 property_set(entry->d_name, value);
+                persist_legacy_files = 1;
             } else {
                 ERROR("Unable to read persistent property file %s errno: %d\n",
                       entry->d_name, errno);
@@ -550,6 +1045,15 @@ static void load_persistent_properties()
         ERROR("Unable to open persistent property directory %s errno: %d\n", PERSISTENT_PROPERTY_DIR, errno);
     }
 
+    if (PERSISTENT_PROPERTY_WRITEBACK) {
+        load_persistent_property_file();
+        /* fold any per-property files into the single file */
+        if (persist_legacy_files && persist_flush_fd >= 0) {
+            persist_dirty = 1;
+            flush_persistent_properties();
+        }
+    }
+
     persistent_properties_loaded = 1;
 }
 
@@ -595,7 +1099,13 @@ void load_persist_props(void)
 
 void start_property_service(void)
 {
-    int fd;
+    int fd, i;
+
+    if (PERSISTENT_PROPERTY_WRITEBACK) {
+        persist_flush_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (persist_flush_fd < 0)
+            ERROR("Unable to create persistent property timer errno: %d\n", errno);
+    }
 
     load_properties_from_file(PROP_PATH_SYSTEM_BUILD);  // ȡ /system/build.prop 
     load_properties_from_file(PROP_PATH_SYSTEM_DEFAULT);  // ȡ /system/default.prop 
@@ -610,9 +1120,28 @@ void start_property_service(void)
 
     listen(fd, 8);
     property_set_fd = fd;
+
+    property_conn_fd = epoll_create(PROP_CONN_MAX);
+    if (property_conn_fd < 0) {
+        ERROR("Unable to create property connection set errno: %d\n", errno);
+        return;
+    }
+    fcntl(property_conn_fd, F_SETFD, FD_CLOEXEC);
+    for (i = 0; i < PROP_CONN_MAX; i++)
+        prop_conns[i].fd = -1;
 }
 
 int get_property_set_fd()
 {
     return property_set_fd;
 }
+
+int get_property_conn_fd()
+{
+    return property_conn_fd;
+}
+
+int get_persist_flush_fd()
+{
+    return persist_flush_fd;
+}
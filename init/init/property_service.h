@@ -20,7 +20,28 @@
 #include <stdbool.h>
 #include <sys/system_properties.h>
 
+/*
+ * Batched property sets, on the same socket as PROP_MSG_SETPROP:
+ * a prop_batch_hdr followed by 'count' records, each a one byte name
+ * length, a one byte value length, then the name and value without
+ * terminators. init sets every property in order and answers with a
+ * prop_batch_ack; the connection stays open for further batches.
+ */
+#define PROP_MSG_SETPROP_BATCH 0x10
+
+struct prop_batch_hdr {
+    unsigned cmd;       /* PROP_MSG_SETPROP_BATCH */
+    unsigned count;     /* at most 256 */
+};
+
+struct prop_batch_ack {
+    unsigned set;
+    unsigned refused;
+};
+
 extern void handle_property_set_fd(void);
+extern void handle_property_conn_fd(void);
+int get_property_conn_fd(void);
 extern void property_init(void);
 extern void property_load_boot_defaults(void);
 extern void load_persist_props(void);
@@ -30,6 +51,9 @@ extern int __property_get(const char *name, char *value);
 extern int property_set(const char *name, const char *value);
 extern int properties_inited();
 int get_property_set_fd(void);
+extern void property_sync_persistent(void);
+extern void handle_persist_flush_fd(void);
+int get_persist_flush_fd(void);
 
 extern void __property_get_size_error()
     __attribute__((__error__("property_get called with too small buffer")));
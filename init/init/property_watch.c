@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <cutils/list.h>
+#include <cutils/sockets.h>
+
+#define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
+#include <sys/_system_properties.h>
+
+#include "property_watch.h"
+#include "util.h"
+#include "log.h"
+
+#define PROP_WATCH_MAX          256     /* subscribers */
+#define PROP_WATCH_PER_UID      16      /* subscribers per uid other than root */
+#define PROP_WATCH_PREFIXES     8       /* per subscriber */
+#define PROP_WATCH_QUEUE        32      /* events held per subscriber, power of two */
+#define PROP_WATCH_BATCH        16      /* events per packet */
+
+struct prop_watch {
+    struct listnode list;
+    int fd;
+    uid_t uid;
+    unsigned epoll_events;
+
+    char prefix[PROP_WATCH_PREFIXES][PROP_NAME_MAX];
+    size_t prefix_len[PROP_WATCH_PREFIXES];
+    int nprefixes;
+
+    /* events [head, tail) are waiting to be sent */
+    struct prop_watch_event queue[PROP_WATCH_QUEUE];
+    unsigned head;
+    unsigned tail;
+    int overflow;
+};
+
+static list_declare(watchers);
+static unsigned nwatchers;
+
+/* the listening socket and every subscriber, behind one fd for init */
+static int watch_listen_fd = -1;
+static int watch_epoll_fd = -1;
+
+/* set when some subscriber has events that were not tried yet */
+static int watch_pending;
+
+static int watch_set_events(struct prop_watch *w, unsigned events)
+{
+    struct epoll_event ev;
+
+    if (w->epoll_events == events)
+        return 0;
+    ev.events = events;
+    ev.data.ptr = w;
+    w->epoll_events = events;
+    return epoll_ctl(watch_epoll_fd, EPOLL_CTL_MOD, w->fd, &ev);
+}
+
+static void watch_close(struct prop_watch *w)
+{
+    epoll_ctl(watch_epoll_fd, EPOLL_CTL_DEL, w->fd, NULL);
+    close(w->fd);
+    list_remove(&w->list);
+    nwatchers--;
+    free(w);
+}
+
+/*
+ * Sends queued events until the queue is empty or the socket is full, in
+ * which case init waits for it to drain. Returns -1 if 'w' was closed.
+ */
+static int watch_send(struct prop_watch *w)
+{
+    struct prop_watch_event pkt[PROP_WATCH_BATCH];
+
+    while (w->head != w->tail) {
+        unsigned n = w->tail - w->head;
+        unsigned i;
+        ssize_t r;
+
+        if (n > PROP_WATCH_BATCH)
+            n = PROP_WATCH_BATCH;
+        for (i = 0; i < n; i++)
+            pkt[i] = w->queue[(w->head + i) & (PROP_WATCH_QUEUE - 1)];
+        if (w->overflow)
+            pkt[0].flags |= PROP_WATCH_OVERFLOW;
+
+        r = TEMP_FAILURE_RETRY(send(w->fd, pkt, sizeof(pkt[0]) * n,
+                                    MSG_DONTWAIT | MSG_NOSIGNAL));
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return watch_set_events(w, EPOLLIN | EPOLLOUT);
+        if (r < 0) {
+            watch_close(w);
+            return -1;
+        }
+        w->head += n;
+        w->overflow = 0;
+    }
+    return watch_set_events(w, EPOLLIN);
+}
+
+static void watch_read(struct prop_watch *w)
+{
+    struct prop_watch_req req;
+    ssize_t r;
+
+    for (;;) {
+        r = TEMP_FAILURE_RETRY(recv(w->fd, &req, sizeof(req), MSG_DONTWAIT));
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (r != sizeof(req) || req.cmd != PROP_WATCH_ADD ||
+            w->nprefixes == PROP_WATCH_PREFIXES) {
+            watch_close(w);
+            return;
+        }
+
+        req.prefix[PROP_NAME_MAX - 1] = 0;
+        strcpy(w->prefix[w->nprefixes], req.prefix);
+        w->prefix_len[w->nprefixes] = strlen(req.prefix);
+        w->nprefixes++;
+    }
+}
+
+static unsigned watch_count_uid(uid_t uid)
+{
+    struct listnode *node;
+    struct prop_watch *w;
+    unsigned n = 0;
+
+    list_for_each(node, &watchers) {
+        w = node_to_item(node, struct prop_watch, list);
+        if (w->uid == uid)
+            n++;
+    }
+    return n;
+}
+
+static void watch_accept(void)
+{
+    struct prop_watch *w;
+    struct epoll_event ev;
+    struct ucred cr;
+    socklen_t cr_size;
+    int s;
+
+    for (;;) {
+        s = accept(watch_listen_fd, NULL, NULL);
+        if (s < 0)
+            return;
+        fcntl(s, F_SETFD, FD_CLOEXEC);
+        fcntl(s, F_SETFL, O_NONBLOCK);
+
+        if (nwatchers == PROP_WATCH_MAX) {
+            ERROR("property_watch: too many subscribers\n");
+            close(s);
+            continue;
+        }
+        /* the socket is open to everyone, so no one uid may fill it up */
+        cr_size = sizeof(cr);
+        if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cr, &cr_size) < 0) {
+            close(s);
+            continue;
+        }
+        if (cr.uid != 0 && watch_count_uid(cr.uid) == PROP_WATCH_PER_UID) {
+            ERROR("property_watch: too many subscribers for uid %d\n", cr.uid);
+            close(s);
+            continue;
+        }
+        w = calloc(1, sizeof(*w));
+        if (!w) {
+            close(s);
+            continue;
+        }
+        w->fd = s;
+        w->uid = cr.uid;
+        w->epoll_events = EPOLLIN;
+        ev.events = EPOLLIN;
+        ev.data.ptr = w;
+        if (epoll_ctl(watch_epoll_fd, EPOLL_CTL_ADD, s, &ev) < 0) {
+            close(s);
+            free(w);
+            continue;
+        }
+        list_add_tail(&watchers, &w->list);
+        nwatchers++;
+    }
+}
+
+void start_property_watch(void)
+{
+    struct epoll_event ev;
+    int fd;
+
+    fd = create_socket(PROP_WATCH_SOCKET, SOCK_SEQPACKET, 0666, 0, 0);
+    if (fd < 0)
+        return;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    listen(fd, 8);
+
+    watch_epoll_fd = epoll_create(PROP_WATCH_MAX);
+    if (watch_epoll_fd < 0) {
+        ERROR("property_watch: epoll_create failed: %s\n", strerror(errno));
+        close(fd);
+        return;
+    }
+    fcntl(watch_epoll_fd, F_SETFD, FD_CLOEXEC);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(watch_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    watch_listen_fd = fd;
+}
+
+int get_property_watch_fd(void)
+{
+    return watch_epoll_fd;
+}
+
+void handle_property_watch_fd(void)
+{
+    struct epoll_event events[16];
+    int nr, i;
+
+    nr = epoll_wait(watch_epoll_fd, events, 16, 0);
+    for (i = 0; i < nr; i++) {
+        struct prop_watch *w = events[i].data.ptr;
+
+        if (!w) {
+            watch_accept();
+            continue;
+        }
+        if (events[i].events & EPOLLOUT) {
+            if (watch_send(w) < 0)
+                continue;
+        }
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            watch_read(w);
+    }
+}
+
+/* Queues a change for every subscriber watching a prefix of 'name'. */
+void property_watch_notify(const char *name, const char *value)
+{
+    struct listnode *node;
+    struct prop_watch *w;
+    struct prop_watch_event *ev;
+    int i;
+
+    list_for_each(node, &watchers) {
+        w = node_to_item(node, struct prop_watch, list);
+        for (i = 0; i < w->nprefixes; i++) {
+            if (!strncmp(name, w->prefix[i], w->prefix_len[i]))
+                break;
+        }
+        if (i == w->nprefixes)
+            continue;
+
+        /* full: drop the oldest and tell the client it missed some */
+        if (w->tail - w->head == PROP_WATCH_QUEUE) {
+            w->head++;
+            w->overflow = 1;
+        }
+        ev = &w->queue[w->tail++ & (PROP_WATCH_QUEUE - 1)];
+        ev->flags = 0;
+        strlcpy(ev->name, name, sizeof(ev->name));
+        strlcpy(ev->value, value, sizeof(ev->value));
+        watch_pending = 1;
+    }
+}
+
+/*
+ * Called once per pass of init's main loop, so changes made by a run of
+ * commands reach each subscriber together.
+ */
+void property_watch_flush(void)
+{
+    struct listnode *node, *next;
+    struct prop_watch *w;
+
+    if (!watch_pending)
+        return;
+    watch_pending = 0;
+
+    for (node = watchers.next; node != &watchers; node = next) {
+        next = node->next;
+        w = node_to_item(node, struct prop_watch, list);
+        /* blocked subscribers are resumed by EPOLLOUT */
+        if (w->head != w->tail && !(w->epoll_events & EPOLLOUT))
+            watch_send(w);
+    }
+}
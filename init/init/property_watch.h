@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _INIT_PROPERTY_WATCH_H
+#define _INIT_PROPERTY_WATCH_H
+
+#include <sys/system_properties.h>
+
+/*
+ * Property change subscriptions.
+ *
+ * Clients connect to the seqpacket socket PROP_WATCH_SOCKET and send
+ * prop_watch_req packets naming the prefixes they care about (an empty
+ * prefix matches everything). Every matching change is then pushed as a
+ * prop_watch_event; one packet carries as many events as have piled up,
+ * so a single wakeup can cover a burst of changes.
+ *
+ * Each subscriber has a bounded queue in init. If the client does not
+ * keep up, the oldest events are dropped and the next event delivered
+ * has PROP_WATCH_OVERFLOW set; the client should then re-read whatever
+ * it watches.
+ *
+ * A uid other than root can hold at most 16 subscriptions at a time;
+ * further connections are closed straight away.
+ */
+#define PROP_WATCH_SOCKET       "property_watch"
+
+#define PROP_WATCH_ADD          1
+
+#define PROP_WATCH_OVERFLOW     0x1
+
+struct prop_watch_req {
+    unsigned cmd;
+    char prefix[PROP_NAME_MAX];
+};
+
+struct prop_watch_event {
+    unsigned flags;
+    char name[PROP_NAME_MAX];
+    char value[PROP_VALUE_MAX];
+};
+
+void start_property_watch(void);
+int get_property_watch_fd(void);
+void handle_property_watch_fd(void);
+void property_watch_notify(const char *name, const char *value);
+void property_watch_flush(void);
+
+#endif
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+
+#include <selinux/selinux.h>
+#include <selinux/label.h>
+
+#include <cutils/list.h>
+
+#include "init.h"
+#include "log.h"
+#include "util.h"
+
+/*
+ * Recursive relabeling.
+ *
+ * The tree is split by directory across a few threads, the calling one
+ * included. An entry is only written when its current label differs from
+ * the one file_contexts gives it. selabel_lookup() is serialized, since
+ * libselinux compiles the spec regexes lazily during lookups.
+ *
+ * After a clean walk, a digest of the file_contexts lines that can apply
+ * to the tree is stored in an xattr on its root. A later walk of the tree
+ * with the same digest is skipped. Filesystems without xattr support, such
+ * as sysfs, are simply walked every time.
+ */
+
+#define RESTORECON_MAX_THREADS  4
+#define RESTORECON_XATTR        "security.restorecon_last"
+
+/* the files selinux_android_file_context_handle() loads, in its order */
+static const char *const file_contexts[] = {
+    "/data/security/current/file_contexts",
+    "/file_contexts",
+};
+
+struct relabel_dir {
+    struct listnode list;
+    char path[];
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct listnode dirs;
+    int pending;                /* dirs queued or being walked */
+    dev_t dev;                  /* the walk stays on the root's filesystem */
+    unsigned entries;
+    unsigned relabeled;
+    unsigned errors;
+} rc = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_mutex_t lookup_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len--) {
+        hash ^= *p++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * Hashes the file_contexts lines that can match something under 'tree':
+ * those whose literal stem, the part of the regex before the first
+ * metacharacter, leads to the tree or lies inside it.
+ */
+static int tree_digest(const char *tree, uint64_t *digest)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    size_t tree_len = strlen(tree);
+    char *data = NULL, *line, *next;
+    unsigned sz, i;
+
+    for (i = 0; i < ARRAY_SIZE(file_contexts) && !data; i++)
+        data = read_file(file_contexts[i], &sz);
+    if (!data)
+        return -1;
+
+    hash = fnv1a(hash, tree, tree_len + 1);
+    for (line = data; *line; line = next) {
+        size_t len, stem;
+
+        next = strchr(line, '\n');
+        if (next)
+            *next++ = 0;
+        else
+            next = line + strlen(line);
+
+        while (*line == ' ' || *line == '\t')
+            line++;
+        if (*line == 0 || *line == '#')
+            continue;
+
+        len = strlen(line);
+        stem = strcspn(line, ".^$?*+|[({\\ \t");
+        if (!strncmp(line, tree, stem < tree_len ? stem : tree_len))
+            hash = fnv1a(hash, line, len + 1);
+    }
+    free(data);
+
+    *digest = hash;
+    return 0;
+}
+
+/* Returns 1 if the label was changed, 0 if it was right, -1 on error. */
+static int relabel(const char *path, mode_t mode)
+{
+    char *want = NULL, *cur = NULL;
+    int ret;
+
+    pthread_mutex_lock(&lookup_lock);
+    ret = selabel_lookup(sehandle, &want, path, mode);
+    pthread_mutex_unlock(&lookup_lock);
+    if (ret < 0)
+        return -1;
+
+    ret = 0;
+    if (lgetfilecon(path, &cur) < 0 || strcmp(cur, want))
+        ret = lsetfilecon(path, want) < 0 ? -1 : 1;
+
+    if (cur)
+        freecon(cur);
+    freecon(want);
+    return ret;
+}
+
+static void count(int ret, unsigned *entries, unsigned *relabeled,
+                  unsigned *errors)
+{
+    (*entries)++;
+    if (ret > 0)
+        (*relabeled)++;
+    else if (ret < 0)
+        (*errors)++;
+}
+
+/* called with rc.lock held */
+static int queue_dir(const char *path)
+{
+    size_t len = strlen(path) + 1;
+    struct relabel_dir *dir = malloc(sizeof(*dir) + len);
+
+    if (!dir)
+        return -1;
+    memcpy(dir->path, path, len);
+    list_add_tail(&rc.dirs, &dir->list);
+    rc.pending++;
+    pthread_cond_signal(&rc.cond);
+    return 0;
+}
+
+/*
+ * Relabels a directory and its entries. Subdirectories on the same
+ * filesystem are queued for any thread to pick up; other mount points
+ * are left alone.
+ */
+static void visit_dir(const char *path, unsigned *entries,
+                      unsigned *relabeled, unsigned *errors)
+{
+    char child[PATH_MAX];
+    const char *sep = path[strlen(path) - 1] == '/' ? "" : "/";
+    struct dirent *de;
+    struct stat sb;
+    DIR *d;
+
+    count(relabel(path, S_IFDIR), entries, relabeled, errors);
+
+    d = opendir(path);
+    if (!d) {
+        (*errors)++;
+        return;
+    }
+
+    while ((de = readdir(d))) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+        if (snprintf(child, sizeof(child), "%s%s%s", path, sep, de->d_name)
+                >= (int) sizeof(child) ||
+            fstatat(dirfd(d), de->d_name, &sb, AT_SYMLINK_NOFOLLOW) < 0) {
+            (*errors)++;
+            continue;
+        }
+        if (sb.st_dev != rc.dev)
+            continue;
+
+        if (S_ISDIR(sb.st_mode)) {
+            pthread_mutex_lock(&rc.lock);
+            if (queue_dir(child) < 0)
+                (*errors)++;
+            pthread_mutex_unlock(&rc.lock);
+        } else {
+            count(relabel(child, sb.st_mode), entries, relabeled, errors);
+        }
+    }
+    closedir(d);
+}
+
+static void *relabel_worker(void *arg)
+{
+    struct listnode *node;
+    struct relabel_dir *dir;
+    unsigned entries, relabeled, errors;
+
+    pthread_mutex_lock(&rc.lock);
+    for (;;) {
+        while (list_empty(&rc.dirs) && rc.pending)
+            pthread_cond_wait(&rc.cond, &rc.lock);
+        if (!rc.pending)
+            break;
+
+        node = list_head(&rc.dirs);
+        list_remove(node);
+        pthread_mutex_unlock(&rc.lock);
+
+        dir = node_to_item(node, struct relabel_dir, list);
+        entries = relabeled = errors = 0;
+        visit_dir(dir->path, &entries, &relabeled, &errors);
+        free(dir);
+
+        pthread_mutex_lock(&rc.lock);
+        rc.entries += entries;
+        rc.relabeled += relabeled;
+        rc.errors += errors;
+        if (--rc.pending == 0)
+            pthread_cond_broadcast(&rc.cond);
+    }
+    pthread_mutex_unlock(&rc.lock);
+    return NULL;
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+int restorecon_recursive(const char *pathname)
+{
+    pthread_t threads[RESTORECON_MAX_THREADS - 1];
+    struct stat sb;
+    uint64_t digest, last;
+    long long start;
+    long ncpus;
+    int have_digest, started = 0, i;
+
+    if (is_selinux_enabled() <= 0 || !sehandle)
+        return 0;
+
+    if (lstat(pathname, &sb) < 0)
+        return -errno;
+    if (!S_ISDIR(sb.st_mode))
+        return relabel(pathname, sb.st_mode) < 0 ? -1 : 0;
+
+    have_digest = tree_digest(pathname, &digest) == 0;
+    if (have_digest &&
+        getxattr(pathname, RESTORECON_XATTR, &last, sizeof(last)) == sizeof(last) &&
+        last == digest) {
+        INFO("restorecon: %s is up to date\n", pathname);
+        return 0;
+    }
+
+    start = now_ms();
+    list_init(&rc.dirs);
+    rc.pending = 0;
+    rc.dev = sb.st_dev;
+    rc.entries = rc.relabeled = rc.errors = 0;
+    if (queue_dir(pathname) < 0)
+        return -ENOMEM;
+
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus > RESTORECON_MAX_THREADS)
+        ncpus = RESTORECON_MAX_THREADS;
+    for (i = 1; i < ncpus; i++) {
+        if (pthread_create(&threads[started], NULL, relabel_worker, NULL))
+            break;
+        started++;
+    }
+    relabel_worker(NULL);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    if (have_digest && !rc.errors)
+        setxattr(pathname, RESTORECON_XATTR, &digest, sizeof(digest), 0);
+
+    INFO("restorecon: %s: %u entries, %u relabeled, %u errors in %lldms "
+         "on %d threads\n", pathname, rc.entries, rc.relabeled, rc.errors,
+         now_ms() - start, started + 1);
+    return 0;
+}
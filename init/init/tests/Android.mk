@@ -0,0 +1,82 @@
+# Copyright 2014 The Android Open Source Project
+#
+# Harnesses and benchmarks for init; see the comment at the top of each
+# one for what it checks and how to run it. The host ones are built from
+# the init sources they exercise plus the glue in ../host.
+
+LOCAL_PATH:= $(call my-dir)
+
+init_host_src_files := \
+	../host/init_host.c \
+	../init_parser.c \
+	../init_cache.c \
+	../arena.c \
+	../parser.c \
+	../util.c
+
+init_host_static_libraries := \
+	libcutils \
+	liblog \
+	libselinux
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := init_trigger_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := trigger_bench.c $(init_host_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(LOCAL_PATH)/../host
+LOCAL_STATIC_LIBRARIES := $(init_host_static_libraries)
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := init_rc_cache_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := rc_cache_bench.c $(init_host_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(LOCAL_PATH)/../host
+LOCAL_STATIC_LIBRARIES := $(init_host_static_libraries)
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := init_coldboot_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := \
+	coldboot_test.c \
+	../host/init_host.c \
+	../arena.c \
+	../util.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(LOCAL_PATH)/../host
+LOCAL_STATIC_LIBRARIES := $(init_host_static_libraries)
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := init_persist_props_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -DPERSISTENT_PROPERTY_WRITEBACK=1
+LOCAL_SRC_FILES := \
+	persist_props_test.c \
+	../host/system_properties.c \
+	../util.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(LOCAL_PATH)/../host
+LOCAL_STATIC_LIBRARIES := $(init_host_static_libraries)
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := init_prop_set_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := \
+	prop_set_bench.c \
+	../host/system_properties.c \
+	../util.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(LOCAL_PATH)/../host
+LOCAL_STATIC_LIBRARIES := $(init_host_static_libraries)
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := init_prop_watch_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := \
+	prop_watch_test.c \
+	../util.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. $(LOCAL_PATH)/../host
+LOCAL_STATIC_LIBRARIES := $(init_host_static_libraries)
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs ueventd's coldboot against a fake sysfs tree. Writing "add" to
+ * one of its uevent files sends an event for that directory over a
+ * socketpair standing in for the netlink socket, optionally after a
+ * message from a non-kernel sender that has to be skipped.
+ *
+ *   init_coldboot_test [-t threads] [-f fanout] [-d depth]
+ *                      [-s spoof_every] [-w write_us]
+ *
+ * The serial walk is timed first, then the parallel one, which must
+ * handle every event exactly once, never let more than
+ * COLDBOOT_MAX_INFLIGHT events queue up in the socket and leave it
+ * empty.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/time.h>
+
+static ssize_t coldboot_test_write(int fd, const void *buf, size_t count);
+
+/* the uevent pokes in devices.c go to the fake kernel below */
+#define write coldboot_test_write
+#include "../devices.c"
+#undef write
+
+static int sock[2];
+static int spoof_every;
+static int write_us;
+
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+static int sent, delivered, spoofed, max_queued;
+
+static ssize_t coldboot_test_write(int fd, const void *buf, size_t count)
+{
+    char link[64], path[PATH_MAX], msg[UEVENT_MSG_LEN];
+    ssize_t len;
+    int n, queued;
+
+    if (count != 4 || memcmp(buf, "add\n", 4))
+        return write(fd, buf, count);
+
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    len = readlink(link, path, sizeof(path) - 1);
+    if (len < 0)
+        return -1;
+    path[len] = 0;
+    *strrchr(path, '/') = 0;
+
+    if (write_us)
+        usleep(write_us);
+
+    /* like the kernel, the event is queued before write() returns */
+    pthread_mutex_lock(&fake_lock);
+    if (spoof_every && sent % spoof_every == 0 &&
+            send(sock[1], "spoof", 6, 0) == 6)
+        spoofed++;
+    n = snprintf(msg, sizeof(msg), "add@%s%cACTION=add%cDEVPATH=%s%c"
+                 "SUBSYSTEM=coldboot_test%cSEQNUM=%d", path, 0, 0, path, 0, 0, sent);
+    if (send(sock[1], msg, n + 1, 0) != n + 1) {
+        pthread_mutex_unlock(&fake_lock);
+        return -1;
+    }
+    queued = ++sent - delivered;
+    if (queued > max_queued)
+        max_queued = queued;
+    pthread_mutex_unlock(&fake_lock);
+    return count;
+}
+
+ssize_t uevent_kernel_multicast_recv(int socket, void *buffer, size_t length)
+{
+    ssize_t n = recv(socket, buffer, length, MSG_DONTWAIT);
+
+    if (n <= 0)
+        return n;
+    /* what libcutils does with a message that is not from the kernel */
+    if (!strcmp(buffer, "spoof")) {
+        memset(buffer, 0, length);
+        errno = EIO;
+        return -1;
+    }
+    pthread_mutex_lock(&fake_lock);
+    delivered++;
+    pthread_mutex_unlock(&fake_lock);
+    return n;
+}
+
+int uevent_open_socket(int buf_sz, bool passcred)
+{
+    return -1;
+}
+
+struct selabel_handle *selinux_android_file_context_handle(void)
+{
+    return NULL;
+}
+
+static int make_tree(const char *path, int fanout, int depth)
+{
+    char child[PATH_MAX];
+    int fd, i, dirs = 1;
+
+    if (mkdir(path, 0755))
+        return -1;
+    snprintf(child, sizeof(child), "%s/uevent", path);
+    fd = open(child, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0)
+        return -1;
+    close(fd);
+
+    for (i = 0; depth > 0 && i < fanout; i++) {
+        int n;
+
+        snprintf(child, sizeof(child), "%s/dev%d", path, i);
+        n = make_tree(child, fanout, depth - 1);
+        if (n < 0)
+            return -1;
+        dirs += n;
+    }
+    return dirs;
+}
+
+static void remove_tree(const char *path)
+{
+    char cmd[PATH_MAX + 16];
+
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", path);
+    system(cmd);
+}
+
+static void reset_counts(void)
+{
+    char msg[UEVENT_MSG_LEN];
+
+    while (recv(sock[0], msg, sizeof(msg), MSG_DONTWAIT) >= 0)
+        ;
+    sent = delivered = spoofed = max_queued = 0;
+    cb.poked = cb.written = cb.seen = cb.settled = 0;
+}
+
+static long long now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+    char root[] = "/tmp/coldboot_test.XXXXXX";
+    char tree[PATH_MAX], msg[UEVENT_MSG_LEN];
+    const char *paths[1] = { tree };
+    int threads = 4, fanout = 4, depth = 5, dirs, opt, failed = 0;
+    int bufsz = 4 * 1024 * 1024;
+    long long t;
+
+    while ((opt = getopt(argc, argv, "t:f:d:s:w:")) != -1) {
+        switch (opt) {
+        case 't': threads = atoi(optarg); break;
+        case 'f': fanout = atoi(optarg); break;
+        case 'd': depth = atoi(optarg); break;
+        case 's': spoof_every = atoi(optarg); break;
+        case 'w': write_us = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-t threads] [-f fanout] [-d depth] "
+                    "[-s spoof_every] [-w write_us]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!mkdtemp(root)) {
+        perror(root);
+        return 1;
+    }
+    snprintf(tree, sizeof(tree), "%s/devices", root);
+    dirs = make_tree(tree, fanout, depth);
+    if (dirs < 0) {
+        perror(tree);
+        remove_tree(root);
+        return 1;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sock)) {
+        perror("socketpair");
+        remove_tree(root);
+        return 1;
+    }
+    setsockopt(sock[1], SOL_SOCKET, SO_SNDBUF, &bufsz, sizeof(bufsz));
+    setsockopt(sock[0], SOL_SOCKET, SO_RCVBUF, &bufsz, sizeof(bufsz));
+    device_fd = sock[0];
+
+    t = now_us();
+    coldboot(tree);
+    t = now_us() - t;
+    printf("serial:     %6d dirs %8lld us, %d events, %d spoofed\n",
+           dirs, t, delivered, spoofed);
+
+    reset_counts();
+    t = now_us();
+    coldboot_parallel(paths, 1, threads);
+    t = now_us() - t;
+    printf("%d threads:  %6d dirs %8lld us, %d events, %d spoofed, "
+           "%d queued at most\n", threads, dirs, t, delivered, spoofed, max_queued);
+
+    if (cb.poked != dirs || cb.written != dirs) {
+        fprintf(stderr, "FAIL: %d pokes, %d writes for %d dirs\n",
+                cb.poked, cb.written, dirs);
+        failed = 1;
+    }
+    if (delivered != dirs || cb.seen != dirs) {
+        fprintf(stderr, "FAIL: %d events delivered, %d seen for %d dirs\n",
+                delivered, cb.seen, dirs);
+        failed = 1;
+    }
+    if (max_queued > COLDBOOT_MAX_INFLIGHT) {
+        fprintf(stderr, "FAIL: %d events queued, limit is %d\n",
+                max_queued, COLDBOOT_MAX_INFLIGHT);
+        failed = 1;
+    }
+    if (recv(sock[0], msg, sizeof(msg), MSG_DONTWAIT) >= 0) {
+        fprintf(stderr, "FAIL: socket not drained\n");
+        failed = 1;
+    }
+
+    close(sock[0]);
+    close(sock[1]);
+    remove_tree(root);
+    if (!failed)
+        printf("PASS\n");
+    return failed;
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Exercises the persistent property write-back of a property service
+ * built with PERSISTENT_PROPERTY_WRITEBACK, in a scratch directory:
+ * folding per-property files into the single file, coalescing a burst
+ * of sets into one write, the sync property, a flush that runs out of
+ * memory and reading the file back.
+ *
+ *   init_persist_props_test
+ *
+ * The files it creates belong to whoever runs it, so the ownership
+ * check on load is told they are root's.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+
+#if !PERSISTENT_PROPERTY_WRITEBACK
+#error build with -DPERSISTENT_PROPERTY_WRITEBACK=1
+#endif
+
+static int test_fstat(int fd, struct stat *sb);
+static void *test_realloc(void *ptr, size_t size);
+static int test_mkstemp(char *template);
+
+#define PERSISTENT_PROPERTY_DIR "persist_props_test"
+#define fstat test_fstat
+#define realloc test_realloc
+#define mkstemp test_mkstemp
+#include "../property_service.c"
+#undef fstat
+#undef realloc
+#undef mkstemp
+
+struct selabel_handle *sehandle;
+struct selabel_handle *sehandle_prop;
+
+static int fail_realloc;
+static int flushes;
+static int failed;
+
+static int test_fstat(int fd, struct stat *sb)
+{
+    int ret = fstat(fd, sb);
+
+    sb->st_uid = 0;
+    sb->st_gid = 0;
+    return ret;
+}
+
+static void *test_realloc(void *ptr, size_t size)
+{
+    if (fail_realloc) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(ptr, size);
+}
+
+static int test_mkstemp(char *template)
+{
+    flushes++;
+    return mkstemp(template);
+}
+
+void klog_write(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+void handle_control_message(const char *msg, const char *arg)
+{
+}
+
+void property_changed(const char *name, const char *value)
+{
+}
+
+int selinux_reload_policy(void)
+{
+    return 0;
+}
+
+#define CHECK(cond, what)                                           \
+    do {                                                            \
+        if (cond) {                                                 \
+            printf("ok   %s\n", what);                              \
+        } else {                                                    \
+            printf("FAIL %s (%s:%d)\n", what, __FILE__, __LINE__);  \
+            failed = 1;                                             \
+        }                                                           \
+    } while (0)
+
+static int write_file(const char *path, const char *data)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+    if (fd < 0)
+        return -1;
+    write(fd, data, strlen(data));
+    return close(fd);
+}
+
+static char *slurp(const char *path, size_t *len)
+{
+    static char data[4096];
+    int fd = open(path, O_RDONLY);
+    ssize_t n;
+
+    if (fd < 0)
+        return NULL;
+    n = read(fd, data, sizeof(data));
+    close(fd);
+    if (n < 0)
+        return NULL;
+    *len = n;
+    return data;
+}
+
+/* looks a property up in the single file */
+static int file_has(const char *name, const char *value)
+{
+    size_t len, namelen = strlen(name), valuelen = strlen(value);
+    char *p = slurp(PERSISTENT_PROPERTY_FILE, &len);
+    char *end = p + len;
+
+    if (!p)
+        return 0;
+    while (end - p >= 2) {
+        size_t n = (unsigned char) p[0], v = (unsigned char) p[1];
+
+        p += 2;
+        if ((size_t) (end - p) < n + v)
+            return 0;
+        if (n == namelen && !memcmp(p, name, n))
+            return v == valuelen && !memcmp(p + n, value, v);
+        p += n + v;
+    }
+    return 0;
+}
+
+static int prop_is(const char *name, const char *value)
+{
+    char v[PROP_VALUE_MAX];
+
+    __system_property_get(name, v);
+    return !strcmp(v, value);
+}
+
+static int timer_armed(void)
+{
+    struct itimerspec its;
+
+    return !timerfd_gettime(persist_flush_fd, &its) &&
+           (its.it_value.tv_sec || its.it_value.tv_nsec);
+}
+
+int main(void)
+{
+    char root[] = "/tmp/persist_props_test.XXXXXX";
+    char before[4096], *after, value[PROP_VALUE_MAX];
+    size_t before_len, after_len;
+    char *data;
+    int i;
+
+    if (!mkdtemp(root) || chdir(root) || mkdir(PERSISTENT_PROPERTY_DIR, 0700)) {
+        perror(root);
+        return 1;
+    }
+    persist_flush_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (persist_flush_fd < 0) {
+        perror("timerfd_create");
+        return 1;
+    }
+
+    /* per-property files from a build without write-back */
+    write_file(PERSISTENT_PROPERTY_DIR "/persist.test.legacy", "old");
+    write_file(PERSISTENT_PROPERTY_DIR "/persist.test.both", "legacy");
+    load_persistent_properties();
+    CHECK(prop_is("persist.test.legacy", "old"), "per-property files are loaded");
+    CHECK(file_has("persist.test.legacy", "old"), "and folded into the single file");
+    CHECK(access(PERSISTENT_PROPERTY_DIR "/persist.test.legacy", F_OK) < 0,
+          "and then removed");
+
+    flushes = 0;
+    for (i = 0; i < 100; i++) {
+        snprintf(value, sizeof(value), "%d", i);
+        property_set("persist.test.burst", value);
+    }
+    property_set("test.not_persistent", "1");
+    CHECK(flushes == 0 && timer_armed(), "a burst of sets only arms the timer");
+    CHECK(!file_has("persist.test.burst", "99"), "and writes nothing yet");
+    property_sync_persistent();
+    CHECK(flushes == 1 && file_has("persist.test.burst", "99"),
+          "a sync writes the burst once");
+    CHECK(!file_has("test.not_persistent", "1"), "only persist.* is written");
+
+    property_set("persist.test.sync", "1");
+    property_set(PERSISTENT_PROPERTY_SYNC, "1");
+    CHECK(file_has("persist.test.sync", "1"), PERSISTENT_PROPERTY_SYNC " is a sync point");
+
+    /* a flush that cannot buffer the properties must not touch any file */
+    data = slurp(PERSISTENT_PROPERTY_FILE, &before_len);
+    memcpy(before, data, before_len);
+    write_file(PERSISTENT_PROPERTY_DIR "/persist.test.legacy", "old");
+    persist_legacy_files = 1;
+    property_set("persist.test.nomem", "1");
+    fail_realloc = 1;
+    flushes = 0;
+    CHECK(flush_persistent_properties() < 0, "a flush without memory fails");
+    fail_realloc = 0;
+    after = slurp(PERSISTENT_PROPERTY_FILE, &after_len);
+    CHECK(flushes == 0 && after_len == before_len &&
+          !memcmp(before, after, after_len), "and leaves the single file alone");
+    CHECK(access(PERSISTENT_PROPERTY_DIR "/persist.test.legacy", F_OK) == 0,
+          "and the per-property files");
+    CHECK(persist_dirty && timer_armed() &&
+          persist_retry_ms == PERSISTENT_PROPERTY_FLUSH_MS, "and is retried");
+    CHECK(flush_persistent_properties() == 0 && file_has("persist.test.nomem", "1") &&
+          access(PERSISTENT_PROPERTY_DIR "/persist.test.legacy", F_OK) < 0,
+          "the retry writes everything");
+    unlink(PERSISTENT_PROPERTY_DIR "/persist.test.legacy");
+
+    /* next boot */
+    __system_property_area_init();
+    persistent_properties_loaded = 0;
+    load_persistent_properties();
+    CHECK(prop_is("persist.test.burst", "99") && prop_is("persist.test.sync", "1") &&
+          prop_is("persist.test.nomem", "1") && prop_is("persist.test.both", "legacy"),
+          "everything is read back");
+
+    chdir("/");
+    snprintf(before, sizeof(before), "rm -rf '%s'", root);
+    system(before);
+    printf("%s\n", failed ? "FAILED" : "PASS");
+    return failed;
+}
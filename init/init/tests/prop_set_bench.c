@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures property sets per second through the property service
+ * socket, for clients that connect once per set the way bionic's
+ * __system_property_set() does and for clients that send
+ * PROP_MSG_SETPROP_BATCH messages over one connection. The service
+ * runs in this process, polled the way init polls it; the clients are
+ * child processes.
+ *
+ *   init_prop_set_bench [-c clients] [-n sets] [-b batch]
+ *
+ * Every client sets 'sets' properties, 'batch' to a message in the
+ * batched run.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+static int bench_create_socket(const char *name, int type, mode_t perm,
+                               uid_t uid, gid_t gid);
+
+/* the service socket and persistent properties go into a scratch directory */
+#define PERSISTENT_PROPERTY_DIR "persist"
+#define create_socket bench_create_socket
+#include "../property_service.c"
+#undef create_socket
+
+struct selabel_handle *sehandle;
+struct selabel_handle *sehandle_prop;
+
+static char socket_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+
+static int bench_create_socket(const char *name, int type, mode_t perm,
+                               uid_t uid, gid_t gid)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(PF_UNIX, type, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void klog_write(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (level > KLOG_ERROR_LEVEL)
+        return;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+void handle_control_message(const char *msg, const char *arg)
+{
+}
+
+void property_changed(const char *name, const char *value)
+{
+}
+
+int selinux_reload_policy(void)
+{
+    return 0;
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int connect_service(void)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(AF_LOCAL, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_LOCAL;
+    strcpy(addr.sun_path, socket_path);
+    if (TEMP_FAILURE_RETRY(connect(fd, (struct sockaddr *) &addr, sizeof(addr)))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void bench_name(char *name, unsigned client, unsigned i)
+{
+    snprintf(name, PROP_NAME_MAX, "bench.client%u.prop%u", client, i % 8);
+}
+
+/* what __system_property_set() does for every property */
+static int client_single(unsigned client, unsigned sets)
+{
+    struct pollfd pollfd;
+    prop_msg msg;
+    unsigned i;
+    int fd;
+
+    for (i = 0; i < sets; i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.cmd = PROP_MSG_SETPROP;
+        bench_name(msg.name, client, i);
+        snprintf(msg.value, sizeof(msg.value), "%u", i);
+
+        fd = connect_service();
+        if (fd < 0)
+            return -1;
+        if (TEMP_FAILURE_RETRY(send(fd, &msg, sizeof(msg), 0)) != sizeof(msg)) {
+            close(fd);
+            return -1;
+        }
+        /* the service closes the socket once the property is set */
+        pollfd.fd = fd;
+        pollfd.events = 0;
+        TEMP_FAILURE_RETRY(poll(&pollfd, 1, 250));
+        close(fd);
+    }
+    return 0;
+}
+
+static int client_batched(unsigned client, unsigned sets, unsigned batch)
+{
+    char buf[PROP_BATCH_BUF], name[PROP_NAME_MAX], value[PROP_VALUE_MAX];
+    struct prop_batch_hdr hdr;
+    struct prop_batch_ack ack;
+    unsigned i = 0, n;
+    size_t len;
+    int fd;
+
+    fd = connect_service();
+    if (fd < 0)
+        return -1;
+    while (i < sets) {
+        hdr.cmd = PROP_MSG_SETPROP_BATCH;
+        hdr.count = 0;
+        len = sizeof(hdr);
+        for (n = 0; n < batch && i < sets; n++, i++) {
+            bench_name(name, client, i);
+            snprintf(value, sizeof(value), "%u", i);
+            buf[len++] = strlen(name);
+            buf[len++] = strlen(value);
+            memcpy(buf + len, name, strlen(name));
+            len += strlen(name);
+            memcpy(buf + len, value, strlen(value));
+            len += strlen(value);
+            hdr.count++;
+        }
+        memcpy(buf, &hdr, sizeof(hdr));
+
+        if (TEMP_FAILURE_RETRY(send(fd, buf, len, 0)) != (ssize_t) len ||
+            TEMP_FAILURE_RETRY(recv(fd, &ack, sizeof(ack), MSG_WAITALL)) != sizeof(ack) ||
+            ack.set != hdr.count) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+/* serves the clients until they are all gone, returns how many failed */
+static int serve(unsigned clients)
+{
+    struct epoll_event ev, events[2];
+    int epoll_fd, failed = 0, status, nr, i;
+    pid_t pid;
+
+    epoll_fd = epoll_create(2);
+    ev.events = EPOLLIN;
+    ev.data.fd = get_property_set_fd();
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    ev.data.fd = get_property_conn_fd();
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+
+    while (clients) {
+        nr = epoll_wait(epoll_fd, events, 2, 10);
+        for (i = 0; i < nr; i++) {
+            if (events[i].data.fd == get_property_set_fd())
+                handle_property_set_fd();
+            else
+                handle_property_conn_fd();
+        }
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            if (!WIFEXITED(status) || WEXITSTATUS(status))
+                failed++;
+            clients--;
+        }
+    }
+    close(epoll_fd);
+    return failed;
+}
+
+static int run(const char *what, unsigned clients, unsigned sets, unsigned batch)
+{
+    long long t = now_ns();
+    unsigned i;
+    int failed;
+
+    for (i = 0; i < clients; i++) {
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0)
+            _exit((batch ? client_batched(i, sets, batch) : client_single(i, sets)) ? 1 : 0);
+    }
+    failed = serve(clients);
+    t = now_ns() - t;
+
+    if (failed) {
+        fprintf(stderr, "%s: %d clients failed\n", what, failed);
+        return -1;
+    }
+    printf("%-8s %u clients x %u sets: %8.2f ms, %9.0f sets/s\n", what,
+           clients, sets, t / 1e6, (double) clients * sets * 1e9 / t);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned clients = 4, sets = 2000, batch = 64;
+    char dir[] = "/tmp/prop_set_bench.XXXXXX";
+    char label[32];
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "c:n:b:")) != -1) {
+        switch (opt) {
+        case 'c': clients = atoi(optarg); break;
+        case 'n': sets = atoi(optarg); break;
+        case 'b': batch = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-c clients] [-n sets] [-b batch]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (batch < 1 || batch > PROP_BATCH_MAX) {
+        fprintf(stderr, "batch must be between 1 and %d\n", PROP_BATCH_MAX);
+        return 1;
+    }
+
+    if (!mkdtemp(dir) || chdir(dir) || mkdir(PERSISTENT_PROPERTY_DIR, 0700)) {
+        perror(dir);
+        return 1;
+    }
+    snprintf(socket_path, sizeof(socket_path), "%s/%s", dir, PROP_SERVICE_NAME);
+
+    property_init();
+    start_property_service();
+    if (get_property_set_fd() < 0 || get_property_conn_fd() < 0) {
+        fprintf(stderr, "could not start the property service\n");
+        return 1;
+    }
+
+    snprintf(label, sizeof(label), "batch%u", batch);
+    ret = run("single", clients, sets, 0) || run(label, clients, sets, batch);
+
+    unlink(socket_path);
+    rmdir(PERSISTENT_PROPERTY_DIR);
+    chdir("/");
+    rmdir(dir);
+    return ret ? 1 : 0;
+}
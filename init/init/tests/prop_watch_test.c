@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the property watch service against a few hundred subscribers in
+ * one process: every subscriber must get exactly the changes its
+ * prefixes match, in order and in one packet per flush; a subscriber
+ * that falls behind must see PROP_WATCH_OVERFLOW, one whose socket is
+ * full must be resumed once it reads again, and no uid other than root
+ * may hold more than its share of subscriptions. Also reports how long
+ * a notify and flush takes with every subscriber connected.
+ *
+ *   init_prop_watch_test [-s subscribers] [-n changes]
+ *
+ * The subscribers are told apart by the uid the service sees, which the
+ * test makes up.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int test_create_socket(const char *name, int type, mode_t perm,
+                              uid_t uid, gid_t gid);
+static int test_getsockopt(int fd, int level, int name, void *val, socklen_t *len);
+
+#define create_socket test_create_socket
+#define getsockopt test_getsockopt
+#include "../property_watch.c"
+#undef create_socket
+#undef getsockopt
+
+struct selabel_handle *sehandle;
+
+static char socket_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+static uid_t peer_uid;  /* what the next accepted subscriber runs as */
+static int failed;
+
+static int test_create_socket(const char *name, int type, mode_t perm,
+                              uid_t uid, gid_t gid)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(PF_UNIX, type, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int test_getsockopt(int fd, int level, int name, void *val, socklen_t *len)
+{
+    int ret = getsockopt(fd, level, name, val, len);
+
+    if (!ret && level == SOL_SOCKET && name == SO_PEERCRED)
+        ((struct ucred *) val)->uid = peer_uid;
+    return ret;
+}
+
+void klog_write(int level, const char *fmt, ...)
+{
+}
+
+#define CHECK(cond, what)                                           \
+    do {                                                            \
+        if (cond) {                                                 \
+            printf("ok   %s\n", what);                              \
+        } else {                                                    \
+            printf("FAIL %s (%s:%d)\n", what, __FILE__, __LINE__);  \
+            failed = 1;                                             \
+        }                                                           \
+    } while (0)
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* runs the service until it has nothing left to do, as init's loop would */
+static void pump(void)
+{
+    struct pollfd pfd = { get_property_watch_fd(), POLLIN, 0 };
+
+    while (poll(&pfd, 1, 0) > 0)
+        handle_property_watch_fd();
+}
+
+static int subscribe(uid_t uid, const char *prefix)
+{
+    struct prop_watch_req req;
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    peer_uid = uid;
+    pump();
+
+    memset(&req, 0, sizeof(req));
+    req.cmd = PROP_WATCH_ADD;
+    strcpy(req.prefix, prefix);
+    send(fd, &req, sizeof(req), 0);
+    pump();
+    return fd;
+}
+
+/* whether init is waiting for the socket of the subscriber 'uid' to drain */
+static int blocked(uid_t uid)
+{
+    struct listnode *node;
+    struct prop_watch *w;
+
+    list_for_each(node, &watchers) {
+        w = node_to_item(node, struct prop_watch, list);
+        if (w->uid == uid)
+            return !!(w->epoll_events & EPOLLOUT);
+    }
+    return 0;
+}
+
+/* reads whatever is waiting on 'fd', returns the number of packets */
+static unsigned drain(int fd)
+{
+    struct prop_watch_event ev[PROP_WATCH_QUEUE];
+    unsigned n = 0;
+
+    while (recv(fd, ev, sizeof(ev), MSG_DONTWAIT) > 0)
+        n++;
+    return n;
+}
+
+/* a connection the service closed reads as end of file */
+static int hung_up(int fd)
+{
+    char c;
+
+    return recv(fd, &c, 1, MSG_DONTWAIT) == 0;
+}
+
+static const char *prefix_of(int i)
+{
+    static const char *prefixes[] = { "", "sys.", "net.", "sys.watch.3" };
+
+    return prefixes[i % 4];
+}
+
+static void change(unsigned i, char *name, char *value)
+{
+    static const char *names[] = { "sys.watch.", "net.watch.", "dev.watch." };
+
+    sprintf(name, "%s%u", names[i % 3], i % 7);
+    sprintf(value, "%u", i);
+}
+
+/* the changes out of 'count' that a subscriber to 'prefix' gets */
+static unsigned matching(const char *prefix, unsigned count)
+{
+    char name[PROP_NAME_MAX], value[PROP_VALUE_MAX];
+    unsigned i, n = 0;
+
+    for (i = 0; i < count; i++) {
+        change(i, name, value);
+        n += !strncmp(name, prefix, strlen(prefix));
+    }
+    return n;
+}
+
+/* reads one packet and checks it holds exactly the matching changes */
+static int received_in_order(int fd, const char *prefix, unsigned count)
+{
+    struct prop_watch_event ev[PROP_WATCH_QUEUE];
+    char name[PROP_NAME_MAX], value[PROP_VALUE_MAX];
+    unsigned i, n = 0, want = matching(prefix, count);
+    ssize_t r;
+
+    r = recv(fd, ev, sizeof(ev), MSG_DONTWAIT);
+    if (want == 0)
+        return r < 0 && errno == EAGAIN;
+    if (r != (ssize_t) (sizeof(ev[0]) * want))
+        return 0;
+    for (i = 0; i < count; i++) {
+        change(i, name, value);
+        if (strncmp(name, prefix, strlen(prefix)))
+            continue;
+        if (ev[n].flags || strcmp(ev[n].name, name) || strcmp(ev[n].value, value))
+            return 0;
+        n++;
+    }
+    /* and nothing more */
+    return recv(fd, ev, sizeof(ev), MSG_DONTWAIT) < 0 && errno == EAGAIN;
+}
+
+int main(int argc, char **argv)
+{
+    char dir[] = "/tmp/prop_watch_test.XXXXXX";
+    char name[PROP_NAME_MAX], value[PROP_VALUE_MAX];
+    struct prop_watch_event ev[PROP_WATCH_QUEUE];
+    unsigned subscribers = 230, changes = 12, i, got, bad;
+    int *fds, extra[PROP_WATCH_PER_UID + 1], opt, fd;
+    long long t;
+    ssize_t r;
+
+    while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+        switch (opt) {
+        case 's': subscribers = atoi(optarg); break;
+        case 'n': changes = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-s subscribers] [-n changes]\n", argv[0]);
+            return 1;
+        }
+    }
+    /* room is left for the ones the checks below add */
+    if (subscribers < 2 || subscribers > PROP_WATCH_MAX - PROP_WATCH_PER_UID - 2 ||
+        changes > PROP_WATCH_BATCH) {
+        fprintf(stderr, "2 to %d subscribers and at most %d changes\n",
+                PROP_WATCH_MAX - PROP_WATCH_PER_UID - 2, PROP_WATCH_BATCH);
+        return 1;
+    }
+
+    if (!mkdtemp(dir)) {
+        perror(dir);
+        return 1;
+    }
+    snprintf(socket_path, sizeof(socket_path), "%s/%s", dir, PROP_WATCH_SOCKET);
+    start_property_watch();
+    if (get_property_watch_fd() < 0) {
+        fprintf(stderr, "could not start the property watch service\n");
+        return 1;
+    }
+
+    /* ten subscribers per app uid, under the cap */
+    fds = malloc(sizeof(*fds) * subscribers);
+    for (i = 0; i < subscribers; i++) {
+        fds[i] = subscribe(10000 + i / 10, prefix_of(i));
+        if (fds[i] < 0) {
+            perror("subscribe");
+            return 1;
+        }
+    }
+    CHECK(nwatchers == subscribers, "every subscriber is accepted");
+
+    for (i = 0; i < changes; i++) {
+        change(i, name, value);
+        property_watch_notify(name, value);
+    }
+    property_watch_flush();
+    for (i = 0, bad = 0; i < subscribers; i++)
+        bad += !received_in_order(fds[i], prefix_of(i), changes);
+    CHECK(bad == 0, "each gets its changes in order, in one packet");
+
+    /* more changes than a queue holds, before anyone reads */
+    for (i = 0; i < PROP_WATCH_QUEUE + 8; i++)
+        property_watch_notify("sys.watch.burst", "x");
+    property_watch_flush();
+    r = recv(fds[0], ev, sizeof(ev), MSG_DONTWAIT);
+    CHECK(r > 0 && (ev[0].flags & PROP_WATCH_OVERFLOW),
+          "a subscriber that falls behind sees PROP_WATCH_OVERFLOW");
+    for (i = 1; i < subscribers; i++)
+        drain(fds[i]);
+
+    /* fill a subscriber's socket, then let it read */
+    fd = subscribe(30000, "fill.");
+    for (i = 0; i < 4000 && !blocked(30000); i++) {
+        property_watch_notify("fill.watch", "x");
+        property_watch_flush();
+    }
+    CHECK(blocked(30000), "a full socket makes init wait for EPOLLOUT");
+    got = 0;
+    do {
+        while ((r = recv(fd, ev, sizeof(ev), MSG_DONTWAIT)) > 0)
+            got += r / sizeof(ev[0]);
+        pump();
+    } while (blocked(30000));
+    while ((r = recv(fd, ev, sizeof(ev), MSG_DONTWAIT)) > 0)
+        got += r / sizeof(ev[0]);
+    CHECK(got == i,  "and resumes sending once it reads");
+    close(fd);
+    /* the ones watching everything got those too */
+    do {
+        for (i = 0, got = 0; i < subscribers; i++)
+            got += drain(fds[i]);
+        pump();
+    } while (got);
+
+    /* one uid may not take more than its share */
+    for (i = 0; i <= PROP_WATCH_PER_UID; i++)
+        extra[i] = subscribe(20000, "");
+    for (i = 0, bad = 0; i < PROP_WATCH_PER_UID; i++)
+        bad += hung_up(extra[i]);
+    CHECK(bad == 0 && hung_up(extra[PROP_WATCH_PER_UID]),
+          "a uid is limited to PROP_WATCH_PER_UID subscribers");
+    for (i = 0; i <= PROP_WATCH_PER_UID; i++)
+        close(extra[i]);
+    pump();
+    fd = subscribe(0, "");
+    CHECK(!hung_up(fd), "root is not");
+    close(fd);
+    pump();
+
+    t = now_ns();
+    for (i = 0; i < changes; i++) {
+        change(i, name, value);
+        property_watch_notify(name, value);
+    }
+    property_watch_flush();
+    t = now_ns() - t;
+    printf("%u changes to %u subscribers: %lld us\n", changes, subscribers, t / 1000);
+
+    for (i = 0; i < subscribers; i += 2)
+        close(fds[i]);
+    pump();
+    CHECK(nwatchers == subscribers / 2, "closed subscribers are dropped");
+
+    unlink(socket_path);
+    rmdir(dir);
+    printf("%s\n", failed ? "FAILED" : "PASS");
+    return failed;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times parsing an rc file against loading it from a compiled cache,
+ * the two ways init can get its services and actions at boot. Every
+ * run happens in a fresh child, like the one init does at boot.
+ *
+ *   init_rc_cache_bench [-n runs] [-s services] [-a actions] [-r rc]
+ *
+ * Without -r a synthetic rc with the given number of services and
+ * actions is generated, half of it in an imported file.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "init_cache.h"
+#include "init_parser.h"
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void write_services(FILE *f, unsigned first, unsigned count)
+{
+    unsigned i;
+
+    for (i = first; i < first + count; i++) {
+        fprintf(f, "service svc%u /system/bin/svc%u --arg %u\n", i, i, i);
+        fprintf(f, "    class %s\n", (i & 1) ? "main" : "core");
+        fprintf(f, "    user system\n");
+        fprintf(f, "    group system inet net_admin\n");
+        fprintf(f, "    socket svc%u stream 0660 root system\n", i);
+        fprintf(f, "    setenv SVC_ID %u\n", i);
+        fprintf(f, "    onrestart restart svc%u\n\n", (i + 1) % (first + count));
+    }
+}
+
+static void write_actions(FILE *f, unsigned first, unsigned count)
+{
+    unsigned i;
+
+    for (i = first; i < first + count; i++) {
+        if (i % 4)
+            fprintf(f, "on property:vendor.bench.prop%u=1\n", i);
+        else
+            fprintf(f, "on boot\n");
+        fprintf(f, "    mkdir /data/bench%u 0771 system system\n", i);
+        fprintf(f, "    write /proc/sys/bench/%u %u\n", i, i);
+        fprintf(f, "    chmod 0660 /dev/bench%u\n", i);
+        fprintf(f, "    start svc%u\n\n", i);
+    }
+}
+
+static int write_rc(const char *dir, unsigned services, unsigned actions)
+{
+    char fn[PATH_MAX];
+    FILE *f;
+
+    snprintf(fn, sizeof(fn), "%s/init.rc", dir);
+    f = fopen(fn, "w");
+    if (!f)
+        return -1;
+    fprintf(f, "import %s/init.imported.rc\n\n", dir);
+    write_services(f, 0, services / 2);
+    write_actions(f, 0, actions / 2);
+    if (fclose(f))
+        return -1;
+
+    snprintf(fn, sizeof(fn), "%s/init.imported.rc", dir);
+    f = fopen(fn, "w");
+    if (!f)
+        return -1;
+    write_services(f, services / 2, services - services / 2);
+    write_actions(f, actions / 2, actions - actions / 2);
+    return fclose(f);
+}
+
+/* runs one parse or load in a child and returns how long it took */
+static long long run_child(const char *cache, const char *rc)
+{
+    long long t = -1;
+    int fds[2], status, null;
+    pid_t pid;
+
+    if (pipe(fds))
+        return -1;
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        /* the parser announces every section on stdout */
+        null = open("/dev/null", O_WRONLY);
+        if (null >= 0)
+            dup2(null, 1);
+        t = now_ns();
+        if (cache ? init_cache_load(cache, rc) : init_parse_config_file(rc))
+            t = -1;
+        else
+            t = now_ns() - t;
+        write(fds[1], &t, sizeof(t));
+        _exit(0);
+    }
+    close(fds[1]);
+    if (read(fds[0], &t, sizeof(t)) != sizeof(t))
+        t = -1;
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    return t;
+}
+
+static int compare_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *) a, y = *(const long long *) b;
+
+    return (x > y) - (x < y);
+}
+
+static int report(const char *what, const char *cache, const char *rc,
+                  unsigned runs, long long *median)
+{
+    long long *t = malloc(sizeof(*t) * runs);
+    unsigned i;
+
+    if (!t)
+        return -1;
+    for (i = 0; i < runs; i++) {
+        t[i] = run_child(cache, rc);
+        if (t[i] < 0) {
+            fprintf(stderr, "%s of '%s' failed\n", what, rc);
+            free(t);
+            return -1;
+        }
+    }
+    qsort(t, runs, sizeof(*t), compare_ll);
+    *median = t[runs / 2];
+    printf("%-6s min %8lld us  median %8lld us  max %8lld us\n", what,
+           t[0] / 1000, t[runs / 2] / 1000, t[runs - 1] / 1000);
+    free(t);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned runs = 20, services = 200, actions = 800;
+    char dir[] = "/tmp/rc_cache_bench.XXXXXX";
+    char rc_buf[PATH_MAX], cache[PATH_MAX];
+    const char *rc = NULL;
+    long long parse, load;
+    int opt, ret = 1;
+
+    while ((opt = getopt(argc, argv, "n:s:a:r:")) != -1) {
+        switch (opt) {
+        case 'n': runs = atoi(optarg); break;
+        case 's': services = atoi(optarg); break;
+        case 'a': actions = atoi(optarg); break;
+        case 'r': rc = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-n runs] [-s services] [-a actions] "
+                    "[-r rc]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!runs)
+        runs = 1;
+
+    if (!mkdtemp(dir)) {
+        perror(dir);
+        return 1;
+    }
+    if (!rc) {
+        if (write_rc(dir, services, actions)) {
+            perror(dir);
+            goto out;
+        }
+        snprintf(rc_buf, sizeof(rc_buf), "%s/init.rc", dir);
+        rc = rc_buf;
+    }
+    snprintf(cache, sizeof(cache), "%s/init.rc.cache", dir);
+
+    /* compile in a child too, it leaves the parsed lists behind */
+    if (!fork()) {
+        int null = open("/dev/null", O_WRONLY);
+
+        if (null >= 0)
+            dup2(null, 1);
+        _exit(init_cache_compile(cache, rc));
+    }
+    wait(&opt);
+    if (!WIFEXITED(opt) || WEXITSTATUS(opt)) {
+        fprintf(stderr, "could not compile '%s'\n", rc);
+        goto out;
+    }
+
+    printf("%s, %u runs\n", rc, runs);
+    if (report("parse", NULL, rc, runs, &parse) ||
+        report("load", cache, rc, runs, &load))
+        goto out;
+    if (load)
+        printf("load is %.1fx faster\n", (double) parse / load);
+    ret = 0;
+
+out:
+    snprintf(rc_buf, sizeof(rc_buf), "rm -rf '%s'", dir);
+    system(rc_buf);
+    return ret;
+}
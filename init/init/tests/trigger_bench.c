@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a property set trace against an rc file and times
+ * queue_property_triggers() against a linear scan of action_list, the
+ * way property_changed() used to dispatch. Both must queue the same
+ * actions in the same order for every set.
+ *
+ *   init_trigger_bench [-a actions] [-n names] [-s sets] [-r rc] [-t trace]
+ *
+ * Without -r a synthetic rc with the given number of actions over the
+ * given number of property names is generated; without -t the trace
+ * is synthetic too. A trace is one "name=value" per line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <cutils/list.h>
+#include <sys/system_properties.h>
+
+#include "init.h"
+#include "init_parser.h"
+
+struct prop_set {
+    char *name;
+    char *value;
+};
+
+static struct prop_set *trace;
+static unsigned trace_len;
+
+static unsigned rand_state = 1;
+
+static unsigned next_rand(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return (rand_state >> 16) & 0x7fff;
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int write_rc(const char *fn, unsigned actions, unsigned names)
+{
+    FILE *f = fopen(fn, "w");
+    unsigned i;
+
+    if (!f)
+        return -1;
+    for (i = 0; i < actions; i++) {
+        unsigned name = i % names;
+
+        if (i % 16 == 0)
+            fprintf(f, "on boot\n");
+        else if (i % 8 == 0)
+            fprintf(f, "on property:vendor.test.prop%u=*\n", name);
+        else
+            fprintf(f, "on property:vendor.test.prop%u=%u\n", name, (i / names) % 4);
+        fprintf(f, "    write /dev/null %u\n\n", i);
+    }
+    return fclose(f);
+}
+
+static void add_set(const char *name, const char *value)
+{
+    trace = realloc(trace, sizeof(*trace) * (trace_len + 1));
+    if (!trace) {
+        perror("realloc");
+        exit(1);
+    }
+    trace[trace_len].name = strdup(name);
+    trace[trace_len].value = strdup(value);
+    trace_len++;
+}
+
+static int read_trace(const char *fn)
+{
+    char line[PROP_NAME_MAX + PROP_VALUE_MAX + 8];
+    FILE *f = fopen(fn, "r");
+    char *eq;
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = 0;
+        eq = strchr(line, '=');
+        if (line[0] == '#' || !eq)
+            continue;
+        *eq = 0;
+        add_set(line, eq + 1);
+    }
+    fclose(f);
+    return 0;
+}
+
+static void make_trace(unsigned sets, unsigned names)
+{
+    char name[PROP_NAME_MAX], value[PROP_VALUE_MAX];
+    unsigned i;
+
+    /* half of the names have no triggers at all */
+    for (i = 0; i < sets; i++) {
+        snprintf(name, sizeof(name), "vendor.test.prop%u", next_rand() % (names * 2));
+        snprintf(value, sizeof(value), "%u", next_rand() % 6);
+        add_set(name, value);
+    }
+}
+
+/* property_changed() before the trigger index */
+static const char *linear_name, *linear_value;
+
+static void linear_match(struct action *act)
+{
+    const char *test;
+    int name_length;
+
+    if (strncmp(act->name, "property:", strlen("property:")))
+        return;
+    test = act->name + strlen("property:");
+    name_length = strlen(linear_name);
+    if (!strncmp(linear_name, test, name_length) &&
+            test[name_length] == '=' &&
+            (!strcmp(test + name_length + 1, linear_value) ||
+             !strcmp(test + name_length + 1, "*"))) {
+        action_add_queue_tail(act);
+    }
+}
+
+static void queue_linear(const char *name, const char *value)
+{
+    linear_name = name;
+    linear_value = value;
+    action_for_each(linear_match);
+}
+
+static unsigned drain(struct action **out, unsigned max)
+{
+    struct action *act;
+    unsigned n = 0;
+
+    while ((act = action_remove_queue_head())) {
+        if (n < max)
+            out[n] = act;
+        n++;
+    }
+    return n;
+}
+
+#define MAX_QUEUED 64
+
+static int check(void)
+{
+    struct action *a[MAX_QUEUED], *b[MAX_QUEUED];
+    unsigned i, na, nb;
+
+    for (i = 0; i < trace_len; i++) {
+        queue_linear(trace[i].name, trace[i].value);
+        na = drain(a, MAX_QUEUED);
+        queue_property_triggers(trace[i].name, trace[i].value);
+        nb = drain(b, MAX_QUEUED);
+        if (na != nb || memcmp(a, b, sizeof(a[0]) * (na < MAX_QUEUED ? na : MAX_QUEUED))) {
+            fprintf(stderr, "mismatch at %s=%s: %u linear, %u indexed\n",
+                    trace[i].name, trace[i].value, na, nb);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static long long replay(void (*queue)(const char *, const char *), unsigned *queued)
+{
+    struct action *a[MAX_QUEUED];
+    long long start = now_ns();
+    unsigned i;
+
+    *queued = 0;
+    for (i = 0; i < trace_len; i++) {
+        queue(trace[i].name, trace[i].value);
+        *queued += drain(a, MAX_QUEUED);
+    }
+    return now_ns() - start;
+}
+
+/* the parser announces every section on stdout */
+static int parse_quietly(const char *fn)
+{
+    int saved, null, ret;
+
+    fflush(stdout);
+    saved = dup(1);
+    null = open("/dev/null", O_WRONLY);
+    if (saved >= 0 && null >= 0)
+        dup2(null, 1);
+    ret = init_parse_config_file(fn);
+    fflush(stdout);
+    if (saved >= 0) {
+        dup2(saved, 1);
+        close(saved);
+    }
+    if (null >= 0)
+        close(null);
+    return ret;
+}
+
+static unsigned total_actions, property_actions;
+
+static void count_action(struct action *act)
+{
+    total_actions++;
+    if (!strncmp(act->name, "property:", strlen("property:")))
+        property_actions++;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned actions = 2000, names = 500, sets = 20000, queued;
+    const char *rc = NULL, *trace_fn = NULL;
+    char tmp[] = "/tmp/trigger_bench.XXXXXX";
+    long long linear, indexed;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "a:n:s:r:t:")) != -1) {
+        switch (opt) {
+        case 'a': actions = atoi(optarg); break;
+        case 'n': names = atoi(optarg); break;
+        case 's': sets = atoi(optarg); break;
+        case 'r': rc = optarg; break;
+        case 't': trace_fn = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-a actions] [-n names] [-s sets] "
+                    "[-r rc] [-t trace]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!names)
+        names = 1;
+
+    if (!rc) {
+        fd = mkstemp(tmp);
+        if (fd < 0 || write_rc(tmp, actions, names)) {
+            perror(tmp);
+            return 1;
+        }
+        close(fd);
+        rc = tmp;
+    }
+    if (parse_quietly(rc)) {
+        fprintf(stderr, "could not read '%s'\n", rc);
+        return 1;
+    }
+    if (rc == tmp)
+        unlink(tmp);
+
+    if (trace_fn) {
+        if (read_trace(trace_fn)) {
+            perror(trace_fn);
+            return 1;
+        }
+    } else {
+        make_trace(sets, names);
+    }
+
+    action_for_each(count_action);
+    if (check())
+        return 1;
+
+    linear = replay(queue_linear, &queued);
+    indexed = replay(queue_property_triggers, &queued);
+
+    printf("%u actions, %u property triggers, %u sets, %u actions queued\n",
+           total_actions, property_actions, trace_len, queued);
+    printf("linear:  %8.2f ms %8lld ns/set\n", linear / 1e6,
+           trace_len ? linear / trace_len : 0);
+    printf("indexed: %8.2f ms %8lld ns/set\n", indexed / 1e6,
+           trace_len ? indexed / trace_len : 0);
+    return 0;
+}
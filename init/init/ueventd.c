@@ -43,6 +43,10 @@ static void import_kernel_nv(char *name, int in_qemu)
             {
                 strlcpy(hardware, value, sizeof(hardware));
             }
+            else if (!strcmp(name,"androidboot.coldboot_threads"))
+            {
+                device_set_coldboot_threads(atoi(value));
+            }
         }
     }
 }
@@ -15,6 +15,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <string.h>
@@ -66,6 +67,7 @@ int ueventd_parse_config_file(const char *fn)
 
     parse_config(fn, data);
     DUMP();
+    free(data);
     return 0;
 }
 